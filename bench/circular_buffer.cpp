@@ -0,0 +1,66 @@
+#include <benchmark/benchmark.h>
+#include <vector>
+
+#include "circular_buffer.h"
+
+namespace {
+
+const auto sizes = benchmark::CreateRange(16, 64 << 10, 4);
+
+std::vector<uintptr_t> items(size_t n)
+{
+    std::vector<uintptr_t> v(n);
+    for (size_t i = 0; i < n; ++i) {
+        v[i] = i + 1;
+    }
+    return v;
+}
+
+/* fill and drain the whole buffer, the used list pattern of a pool released
+ * in LRU order */
+void BM_CbufPushPop(benchmark::State& state)
+{
+    const size_t n = (size_t)state.range(0);
+    auto cbuf = cbuf_alloc(n);
+    const auto v = items(n);
+
+    for (auto _ : state) {
+        for (auto item : v) {
+            cbuf_push_back(cbuf, (void*)item);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            benchmark::DoNotOptimize(cbuf_pop_front(cbuf));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)n);
+
+    cbuf_free(cbuf);
+}
+
+/* remove an item from the middle of a full buffer and put it back at the
+ * end, an out of order release from a full pool */
+void BM_CbufRemove(benchmark::State& state)
+{
+    const size_t n = (size_t)state.range(0);
+    auto cbuf = cbuf_alloc(n);
+    for (auto item : items(n)) {
+        cbuf_push_back(cbuf, (void*)item);
+    }
+
+    /* the item in the middle changes every time */
+    size_t i = 0;
+    for (auto _ : state) {
+        void* item = (void*)(uintptr_t)(i % n + 1);
+        cbuf_remove(cbuf, item);
+        cbuf_push_back(cbuf, item);
+        i += n / 2 + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    cbuf_free(cbuf);
+}
+
+BENCHMARK(BM_CbufPushPop)->ArgsProduct({ sizes });
+BENCHMARK(BM_CbufRemove)->ArgsProduct({ sizes });
+
+} // namespace
@@ -0,0 +1,51 @@
+#include <benchmark/benchmark.h>
+#include <cstring>
+
+#include "netbuf.h"
+
+namespace {
+
+const uint32_t arenas[] = {
+    0,
+    NETBUF_F_MMAP,
+    NETBUF_F_MMAP | NETBUF_F_POPULATE,
+    NETBUF_F_HUGEPAGES | NETBUF_F_POPULATE,
+};
+
+const char* const arena_names[] = { "malloc", "mmap", "populate", "hugepages+populate" };
+
+/* the first pass of an RX path over a freshly initialized pool: request
+ * every buffer and fill its payload. page faults not paid at init land here */
+void BM_FirstTouch(benchmark::State& state)
+{
+    const uint32_t flags = arenas[state.range(0)] | NETBUF_F_SPLIT_META;
+    const size_t n = (size_t)state.range(1);
+    const size_t size = 1536;
+    state.SetLabel(arena_names[state.range(0)]);
+
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = n;
+    cfg.buffer_size = size;
+    cfg.flags = flags;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        net_buffer_cb_t cb[1];
+        NetBufferInitEx(cb, &cfg);
+        state.ResumeTiming();
+
+        while (auto buffer = NetBufferRequest(cb)) {
+            memset(NetBufferData(cb, buffer), 0x55, size);
+        }
+        benchmark::ClobberMemory();
+
+        state.PauseTiming();
+        NetBufferDeinit(cb);
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)(n * size));
+}
+
+BENCHMARK(BM_FirstTouch)->ArgsProduct({ { 0, 1, 2, 3 }, { 1024, 16384 } })->Unit(benchmark::kMicrosecond);
+
+} // namespace
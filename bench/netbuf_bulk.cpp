@@ -0,0 +1,49 @@
+#include <benchmark/benchmark.h>
+
+#include "netbuf.h"
+
+namespace {
+
+/* an RX loop: grab a batch of buffers, then release them in LRU order */
+void BM_RequestReleaseLoop(benchmark::State& state)
+{
+    const size_t batch = (size_t)state.range(0);
+    net_buffer_cb_t cb[1];
+    NetBufferInit(cb, 1024, 64);
+
+    net_buffer_t* bufs[256];
+    for (auto _ : state) {
+        for (size_t i = 0; i < batch; ++i) {
+            bufs[i] = NetBufferRequest(cb);
+        }
+        for (size_t i = 0; i < batch; ++i) {
+            NetBufferRelease(cb, bufs[i]);
+        }
+        benchmark::DoNotOptimize(bufs);
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)batch);
+
+    NetBufferDeinit(cb);
+}
+
+void BM_RequestReleaseBulk(benchmark::State& state)
+{
+    const size_t batch = (size_t)state.range(0);
+    net_buffer_cb_t cb[1];
+    NetBufferInit(cb, 1024, 64);
+
+    net_buffer_t* bufs[256];
+    for (auto _ : state) {
+        NetBufferRequestBulk(cb, bufs, batch);
+        NetBufferReleaseBulk(cb, bufs, batch);
+        benchmark::DoNotOptimize(bufs);
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)batch);
+
+    NetBufferDeinit(cb);
+}
+
+BENCHMARK(BM_RequestReleaseLoop)->RangeMultiplier(4)->Range(4, 256);
+BENCHMARK(BM_RequestReleaseBulk)->RangeMultiplier(4)->Range(4, 256);
+
+} // namespace
@@ -0,0 +1,123 @@
+#include <benchmark/benchmark.h>
+#include <mutex>
+#include <thread>
+
+#include "netbuf.h"
+
+namespace {
+
+/* shared between the threads of a run, (re)initialized by Setup() */
+net_buffer_cb_t pool[1];
+std::mutex pool_lock;
+
+const size_t num_buffers = 1024;
+const size_t buffer_size = 64;
+
+void SetupConcurrent(const benchmark::State&)
+{
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = num_buffers;
+    cfg.buffer_size = buffer_size;
+    cfg.flags = NETBUF_F_CONCURRENT;
+    (void)NetBufferInitEx(pool, &cfg);
+}
+
+/* threads interleave their releases, so use the mode with O(1) out of
+ * order release for a fair baseline */
+void SetupLocked(const benchmark::State&)
+{
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = num_buffers;
+    cfg.buffer_size = buffer_size;
+    cfg.flags = NETBUF_F_LINKED_USED_LIST;
+    (void)NetBufferInitEx(pool, &cfg);
+}
+
+void Teardown(const benchmark::State&)
+{
+    (void)NetBufferDeinit(pool);
+}
+
+/* each thread holds a small window of buffers, like a worker would */
+void BM_ConcurrentRequestRelease(benchmark::State& state)
+{
+    net_buffer_t* held[4];
+    for (auto _ : state) {
+        for (auto& b : held) {
+            b = NetBufferRequest(pool);
+        }
+        for (auto b : held) {
+            if (b) {
+                NetBufferRelease(pool, b);
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 4);
+}
+
+/* same pattern, each thread going through its own magazine */
+void BM_MagazineRequestRelease(benchmark::State& state)
+{
+    net_buffer_magazine_t mag[1];
+    const net_buffer_magazine_config_t cfg = { 16, 8, 16, 8 };
+    (void)NetBufferMagazineInit(mag, pool, &cfg);
+
+    net_buffer_t* held[4];
+    for (auto _ : state) {
+        for (auto& b : held) {
+            b = NetBufferMagazineRequest(mag);
+        }
+        for (auto b : held) {
+            if (b) {
+                NetBufferMagazineRelease(mag, b);
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 4);
+    const double hits = (double)mag->stats.request_local;
+    const double total = hits + (double)mag->stats.request_global;
+    state.counters["local_hit_ratio"] = benchmark::Counter(total ? hits / total : 0, benchmark::Counter::kAvgThreads);
+
+    (void)NetBufferMagazineDeinit(mag);
+}
+
+/* the baseline: the plain pool serialized behind a mutex */
+void BM_LockedRequestRelease(benchmark::State& state)
+{
+    net_buffer_t* held[4];
+    for (auto _ : state) {
+        for (auto& b : held) {
+            std::lock_guard<std::mutex> guard(pool_lock);
+            b = NetBufferRequest(pool);
+        }
+        for (auto b : held) {
+            if (b) {
+                std::lock_guard<std::mutex> guard(pool_lock);
+                NetBufferRelease(pool, b);
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 4);
+}
+
+const int max_threads = std::max(8, (int)std::thread::hardware_concurrency());
+
+BENCHMARK(BM_ConcurrentRequestRelease)
+    ->Setup(SetupConcurrent)
+    ->Teardown(Teardown)
+    ->ThreadRange(1, max_threads)
+    ->UseRealTime();
+
+BENCHMARK(BM_MagazineRequestRelease)
+    ->Setup(SetupConcurrent)
+    ->Teardown(Teardown)
+    ->ThreadRange(1, max_threads)
+    ->UseRealTime();
+
+BENCHMARK(BM_LockedRequestRelease)
+    ->Setup(SetupLocked)
+    ->Teardown(Teardown)
+    ->ThreadRange(1, max_threads)
+    ->UseRealTime();
+
+} // namespace
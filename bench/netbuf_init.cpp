@@ -0,0 +1,29 @@
+#include <benchmark/benchmark.h>
+
+#include "netbuf.h"
+
+namespace {
+
+/* service startup: init and deinit a pool of `n` buffers */
+void BM_Init(benchmark::State& state)
+{
+    const uint32_t flags = (uint32_t)state.range(0);
+    const size_t n = (size_t)state.range(1);
+    state.SetLabel(flags & NETBUF_F_LAZY_INIT ? "lazy" : "eager");
+
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = n;
+    cfg.buffer_size = 256;
+    cfg.flags = flags;
+
+    for (auto _ : state) {
+        net_buffer_cb_t cb[1];
+        NetBufferInitEx(cb, &cfg);
+        benchmark::DoNotOptimize(cb);
+        NetBufferDeinit(cb);
+    }
+}
+
+BENCHMARK(BM_Init)->ArgsProduct({ { 0, NETBUF_F_LAZY_INIT }, { 1 << 10, 1 << 16, 1 << 20 } })->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,95 @@
+#include <benchmark/benchmark.h>
+
+#include "netbuf.h"
+
+namespace {
+
+const uint32_t layouts[] = {
+    0,
+    NETBUF_F_CACHE_ALIGNED,
+    NETBUF_F_SPLIT_META,
+};
+
+void SetLabel(benchmark::State& state, uint32_t flags)
+{
+    state.SetLabel(flags & NETBUF_F_SPLIT_META ? "split" : flags & NETBUF_F_CACHE_ALIGNED ? "aligned" : "packed");
+}
+
+net_buffer_t* header_at(net_buffer_cb_t* cb, size_t i)
+{
+    return (net_buffer_t*)((uint8_t*)cb->buffers + i * cb->elem_size);
+}
+
+/* walk the metadata of every buffer, as a dispatcher looking for frames of a
+ * given interface would */
+void BM_MetadataScan(benchmark::State& state)
+{
+    const uint32_t flags = layouts[state.range(0)];
+    const size_t n = (size_t)state.range(1);
+    SetLabel(state, flags);
+
+    net_buffer_cb_t cb[1];
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = n;
+    cfg.buffer_size = 256;
+    cfg.flags = flags;
+    NetBufferInitEx(cb, &cfg);
+
+    while (auto buffer = NetBufferRequest(cb)) {
+        buffer->if_id = (int8_t)(buffer->id & 3);
+        buffer->user_data_length = 8;
+    }
+
+    for (auto _ : state) {
+        size_t bytes = 0;
+        for (size_t i = 0; i < n; ++i) {
+            const net_buffer_t* buffer = header_at(cb, i);
+            if (buffer->if_id == 1) {
+                bytes += buffer->user_data_length;
+            }
+        }
+        benchmark::DoNotOptimize(bytes);
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)n);
+
+    NetBufferDeinit(cb);
+}
+
+/* two threads updating the headers of neighbouring buffers */
+net_buffer_cb_t shared[1];
+
+void SetupShared(const benchmark::State& state)
+{
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 64;
+    cfg.buffer_size = 8;
+    cfg.flags = layouts[state.range(0)];
+    NetBufferInitEx(shared, &cfg);
+}
+
+void TeardownShared(const benchmark::State&)
+{
+    NetBufferDeinit(shared);
+}
+
+void BM_NeighbourWrites(benchmark::State& state)
+{
+    SetLabel(state, layouts[state.range(0)]);
+
+    for (auto _ : state) {
+        for (size_t i = (size_t)state.thread_index(); i < 64; i += 2) {
+            header_at(shared, i)->id++;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 32);
+}
+
+BENCHMARK(BM_MetadataScan)->ArgsProduct({ { 0, 1, 2 }, { 1024, 65536 } });
+BENCHMARK(BM_NeighbourWrites)
+    ->Setup(SetupShared)
+    ->Teardown(TeardownShared)
+    ->DenseRange(0, 2)
+    ->Threads(2)
+    ->UseRealTime();
+
+} // namespace
@@ -0,0 +1,99 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+#include "netbuf.h"
+
+namespace {
+
+enum Order { FIFO, LIFO, RANDOM };
+
+const char* const order_names[] = { "fifo", "lifo", "random" };
+
+const auto pool_sizes = benchmark::CreateRange(16, 64 << 10, 4);
+
+/* a full pool where every iteration releases one held buffer, picked by the
+ * release order, and requests a replacement. the cost of a release depends on
+ * where the buffer sits in the used list */
+void BM_RequestRelease(benchmark::State& state)
+{
+    const auto order = (Order)state.range(0);
+    const size_t n = (size_t)state.range(1);
+    const uint32_t flags = (uint32_t)state.range(2);
+    state.SetLabel(std::string(order_names[order]) + (flags & NETBUF_F_LINKED_USED_LIST ? "/linked" : "/cbuf"));
+
+    net_buffer_cb_t cb[1];
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = n;
+    cfg.buffer_size = 64;
+    cfg.flags = flags;
+    NetBufferInitEx(cb, &cfg);
+
+    /* held in request order, oldest first */
+    std::vector<net_buffer_t*> held(n);
+    for (auto& buffer : held) {
+        buffer = NetBufferRequest(cb);
+    }
+
+    std::vector<size_t> picks(4096);
+    std::mt19937 rng(42);
+    for (auto& pick : picks) {
+        pick = std::uniform_int_distribution<size_t>(0, n - 1)(rng);
+    }
+
+    size_t head = 0;
+    size_t round = 0;
+    for (auto _ : state) {
+        size_t slot;
+        switch (order) {
+        case FIFO:
+            slot = head;
+            head = head + 1 == n ? 0 : head + 1;
+            break;
+        case LIFO:
+            slot = 0;
+            break;
+        default:
+            slot = picks[round++ & (picks.size() - 1)];
+            break;
+        }
+
+        NetBufferRelease(cb, held[slot]);
+        held[slot] = NetBufferRequest(cb);
+        benchmark::DoNotOptimize(held[slot]);
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    NetBufferDeinit(cb);
+}
+
+void BM_WriteChecked(benchmark::State& state)
+{
+    const size_t len = (size_t)state.range(0);
+    const size_t n = (size_t)state.range(1);
+
+    net_buffer_cb_t cb[1];
+    NetBufferInit(cb, n, len);
+
+    std::vector<net_buffer_t*> held(n);
+    for (auto& buffer : held) {
+        buffer = NetBufferRequest(cb);
+    }
+    std::vector<uint8_t> data(len, 0x55);
+
+    /* cycle through the pool, so large pools write to cold buffers */
+    size_t i = 0;
+    for (auto _ : state) {
+        NetBufferWriteChecked(cb, held[i], data.data(), len);
+        benchmark::ClobberMemory();
+        i = i + 1 == n ? 0 : i + 1;
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)len);
+
+    NetBufferDeinit(cb);
+}
+
+BENCHMARK(BM_RequestRelease)->ArgsProduct({ { FIFO, LIFO, RANDOM }, pool_sizes, { 0, NETBUF_F_LINKED_USED_LIST } });
+BENCHMARK(BM_WriteChecked)->ArgsProduct({ { 8, 64, 256, 1500 }, pool_sizes });
+
+} // namespace
@@ -0,0 +1,84 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+#include "netbuf_simd.h"
+
+namespace {
+
+const auto sizes = benchmark::CreateRange(16, 64 << 10, 4);
+const std::vector<int64_t> levels = { NETBUF_SIMD_SCALAR, NETBUF_SIMD_SSE2, NETBUF_SIMD_AVX2, NETBUF_SIMD_AVX512 };
+
+/* the level picked for the CPU, restored for the other benchmarks */
+const netbuf_simd_level best = netbuf_simd_get_level();
+
+const char* const names[] = { "scalar", "sse2", "avx2", "avx512" };
+
+/* false, and the benchmark is skipped, if the CPU lacks the level */
+bool SetLevel(benchmark::State& state)
+{
+    const auto level = (netbuf_simd_level)state.range(0);
+    if (netbuf_simd_set_level(level) != 0) {
+        state.SkipWithError("not supported by this CPU");
+        return false;
+    }
+    state.SetLabel(names[level]);
+    return true;
+}
+
+std::vector<void*> pointers(size_t n)
+{
+    std::vector<void*> v(n);
+    for (size_t i = 0; i < n; ++i) {
+        v[i] = (void*)(uintptr_t)(i + 1);
+    }
+    return v;
+}
+
+/* look for an item that isn't there, the whole array is scanned */
+void BM_PtrFind(benchmark::State& state)
+{
+    if (!SetLevel(state)) {
+        return;
+    }
+    const size_t n = (size_t)state.range(1);
+    const auto v = pointers(n);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(netbuf_ptr_find(v.data(), n, nullptr));
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)n);
+
+    netbuf_simd_set_level(best);
+}
+
+/* compact an array with a quarter of its entries NULL, as stack_sort does */
+void BM_PtrCompact(benchmark::State& state)
+{
+    if (!SetLevel(state)) {
+        return;
+    }
+    const size_t n = (size_t)state.range(1);
+    auto holes = pointers(n);
+    std::mt19937 rng(42);
+    for (size_t i = 0; i < n / 4; ++i) {
+        holes[std::uniform_int_distribution<size_t>(0, n - 1)(rng)] = nullptr;
+    }
+    std::vector<void*> v(n);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::copy(holes.begin(), holes.end(), v.begin());
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(netbuf_ptr_compact(v.data(), n));
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)n);
+
+    netbuf_simd_set_level(best);
+}
+
+BENCHMARK(BM_PtrFind)->ArgsProduct({ levels, sizes });
+BENCHMARK(BM_PtrCompact)->ArgsProduct({ levels, sizes });
+
+} // namespace
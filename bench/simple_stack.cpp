@@ -0,0 +1,60 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+#include "simple_stack.h"
+
+namespace {
+
+const auto sizes = benchmark::CreateRange(16, 64 << 10, 4);
+
+void BM_StackPushPop(benchmark::State& state)
+{
+    const size_t n = (size_t)state.range(0);
+    auto stack = stack_alloc(n);
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < n; ++i) {
+            stack_push(stack, (void*)(uintptr_t)(i + 1));
+        }
+        for (size_t i = 0; i < n; ++i) {
+            benchmark::DoNotOptimize(stack_pop(stack));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)n);
+
+    stack_free(stack);
+}
+
+/* compact a full stack with a quarter of its entries removed */
+void BM_StackSort(benchmark::State& state)
+{
+    const size_t n = (size_t)state.range(0);
+    auto stack = stack_alloc(n);
+    for (size_t i = 0; i < n; ++i) {
+        stack_push(stack, (void*)(uintptr_t)(i + 1));
+    }
+
+    std::mt19937 rng(42);
+    for (size_t i = 0; i < n / 4; ++i) {
+        stack_remove(stack, stack->entry[std::uniform_int_distribution<size_t>(0, n - 1)(rng)]);
+    }
+    const std::vector<void*> holes(stack->entry, stack->entry + n);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::copy(holes.begin(), holes.end(), stack->entry);
+        stack->is_sorted = 0;
+        state.ResumeTiming();
+
+        stack_sort(stack);
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)n);
+
+    stack_free(stack);
+}
+
+BENCHMARK(BM_StackPushPop)->ArgsProduct({ sizes });
+BENCHMARK(BM_StackSort)->ArgsProduct({ sizes });
+
+} // namespace
@@ -16,9 +16,15 @@ struct circular_buffer {
     void* entry[]; /* the buffer */
 };
 
+#define CBUF_TOTAL_SIZE(nElems) (sizeof(struct circular_buffer) + (nElems) * sizeof(void*))
+
 /* allocates storage for and initializes the data structure */
 struct circular_buffer* cbuf_alloc(size_t nElems);
 
+/* initializes the data structure in caller-provided storage of at least
+ * CBUF_TOTAL_SIZE(nElems) bytes */
+void cbuf_init(struct circular_buffer* self, size_t nElems);
+
 /* deallocates storage for this data structure */
 void cbuf_free(struct circular_buffer* self);
 
@@ -50,6 +56,18 @@ void* cbuf_peek_front(const struct circular_buffer* self);
 /* returns the item at the back of the buffer, but does not remove it */
 void* cbuf_peek_back(const struct circular_buffer* self);
 
+/* inserts `n` items at the end, in order, with at most two block copies */
+void cbuf_push_back_bulk(struct circular_buffer* self, void* const* items, size_t n);
+
+/* removes `n` items from the start. copies them to `out` unless it's NULL */
+void cbuf_pop_front_bulk(struct circular_buffer* self, void** out, size_t n);
+
+/* removes the `n` most recently inserted items */
+void cbuf_pop_back_bulk(struct circular_buffer* self, size_t n);
+
+/* number of leading items of the buffer that are equal to items[0..n) */
+size_t cbuf_match_front(const struct circular_buffer* self, void* const* items, size_t n);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
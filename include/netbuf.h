@@ -21,9 +21,81 @@ extern "C" {
 #define NETBUF_FREE(x) free(x)
 #endif
 
+/* fill buffers with 0xAA before their first use, to make reads of
+ * uninitialized payload stand out. 0 skips the fill */
+#ifndef NETBUF_DEBUG_FILL
+#define NETBUF_DEBUG_FILL 1
+#endif
+
+/* huge page size tried by NETBUF_F_HUGEPAGES */
+#ifndef NETBUF_HUGEPAGE_SIZE
+#define NETBUF_HUGEPAGE_SIZE ((size_t)2 << 20)
+#endif
+
+/* number of priority lanes of a NETBUF_F_PRIORITY pool, at most 32 */
+#ifndef NETBUF_PRIORITY_LANES
+#define NETBUF_PRIORITY_LANES 8
+#endif
+
+/* clock read by NETBUF_F_TIMESTAMP, must be monotonic. NetBufferNow reads
+ * CLOCK_MONOTONIC_COARSE in nanoseconds, a TSC read (__rdtsc) is cheaper
+ * still if the TSC is invariant. ages are in the same unit */
+#ifndef NETBUF_TIMESTAMP
+#define NETBUF_TIMESTAMP() NetBufferNow()
+#endif
+
+/* count requests, releases and failures inline, see NetBufferGetStats. 0
+ * compiles every update out. changes the layout of net_buffer_cb_t, so the
+ * library and its users must agree on it */
+#ifndef NETBUF_STATS
+#define NETBUF_STATS 0
+#endif
+
+/* counter sets per pool with NETBUF_STATS. each thread updates its own set,
+ * threads beyond that share them */
+#ifndef NETBUF_STATS_SHARDS
+#define NETBUF_STATS_SHARDS 8
+#endif
+
+/* buckets of the occupancy histogram */
+#ifndef NETBUF_STATS_BUCKETS
+#define NETBUF_STATS_BUCKETS 8
+#endif
+
+/* record how long buffers of NETBUF_F_TIMESTAMP pools stay requested, see
+ * NetBufferGetHoldHist. 0 compiles the recording out */
+#ifndef NETBUF_HOLD_HIST
+#define NETBUF_HOLD_HIST 0
+#endif
+
+/* interfaces (if_type, if_id pairs) with their own hold time histogram, in
+ * order of first release. later ones are only counted globally */
+#ifndef NETBUF_HOLD_IFACES
+#define NETBUF_HOLD_IFACES 8
+#endif
+
+/* log request, release, write and failed request events in a ring per
+ * thread, see NetBufferTraceDump. 0 compiles the logging out */
+#ifndef NETBUF_TRACE
+#define NETBUF_TRACE 0
+#endif
+
+/* events kept per thread with NETBUF_TRACE, a power of two. older ones are
+ * overwritten */
+#ifndef NETBUF_TRACE_ENTRIES
+#define NETBUF_TRACE_ENTRIES 4096
+#endif
+
+/* alignment used by NETBUF_F_CACHE_ALIGNED */
+#ifndef NETBUF_CACHE_LINE_SIZE
+#define NETBUF_CACHE_LINE_SIZE 64
+#endif
+
 typedef struct netbuffer {
     int8_t if_type;
     int8_t if_id;
+    uint8_t state; /* NETBUF_STATE_*, owned by the pool */
+    uint8_t size_class; /* index in net_buffer_cb_t::classes, owned by the pool */
     uint32_t id;
     union {
         struct
@@ -35,42 +107,788 @@ typedef struct netbuffer {
         } can_data;
     } if_data;
 
+    /* index of the next buffer of a scatter-gather chain, NETBUF_NO_INDEX if
+     * this is the last one */
+    uint32_t chain_next;
+
+    /* references held on the buffer, only maintained with NETBUF_F_REFCOUNT */
+    uint32_t refcount;
+
+    /* index of the buffer whose payload this clone shares, NETBUF_NO_INDEX if
+     * the buffer owns its payload */
+    uint32_t payload_owner;
+
+    /* start of the data in the payload area, past the headroom. moved by
+     * NetBufferPush/NetBufferPull */
+    uint32_t data_offset;
+
+    /* lane of the buffer in a NETBUF_F_PRIORITY pool, 0 is the highest
+     * priority. set with NetBufferSetPriority */
+    uint8_t priority;
+
+    /* interface slot the buffer was requested for with NetBufferRequestIface,
+     * NETBUF_NO_IFACE if none. owned by the pool */
+    uint8_t iface;
+
     size_t user_data_length;
+
+    /* NETBUF_TIMESTAMP() when the buffer was requested, only with
+     * NETBUF_F_TIMESTAMP */
+    uint64_t timestamp;
+
+    /* intrusive used list links, as buffer indices. only maintained when the
+     * pool is initialized with NETBUF_F_LINKED_USED_LIST. in NETBUF_F_CONCURRENT
+     * mode `next` links the lock-free free list instead */
+    uint32_t prev;
+    uint32_t next;
+
     uint8_t user_data[];
 } net_buffer_t;
 
+/* marks the end of an index-linked list */
+#define NETBUF_NO_INDEX UINT32_MAX
+
+/* net_buffer_t::iface of a buffer requested without an interface */
+#define NETBUF_NO_IFACE UINT8_MAX
+
+/* values of net_buffer_t::state */
+enum {
+    NETBUF_STATE_FREE = 0,
+    NETBUF_STATE_USED = 1,
+    NETBUF_STATE_CHAINED = 2, /* used, owned by the head of a chain */
+};
+
+/* pool mode flags, see net_buffer_config_t */
+enum {
+    /* track used buffers in a doubly linked list threaded through the buffer
+     * headers instead of a circular buffer. releasing a buffer from any
+     * position becomes O(1), at the cost of 8 bytes per header */
+    NETBUF_F_LINKED_USED_LIST = 1u << 0,
+
+    /* make NetBufferRequest/NetBufferRelease/NetBufferGetUsedCount safe to call
+     * from any number of threads. the free list becomes a lock-free stack of
+     * tagged indices and the used list is reduced to an atomic counter, so
+     * NetBufferGetLRU always returns NULL. can't be combined with
+     * NETBUF_F_LINKED_USED_LIST */
+    NETBUF_F_CONCURRENT = 1u << 1,
+
+    /* in a pool with size classes, let NetBufferRequestSized hand out a buffer
+     * of a larger class when the best fitting one is exhausted */
+    NETBUF_F_CLASS_FALLBACK = 1u << 2,
+
+    /* round every buffer up to whole cache lines and start every payload on a
+     * cache line, so two buffers never share a line */
+    NETBUF_F_CACHE_ALIGNED = 1u << 3,
+
+    /* keep the headers in a dense array and the payloads in a separate slab, so
+     * scanning metadata never pulls payload lines into the cache. `user_data`
+     * is not usable in this mode, use NetBufferData. can't be combined with
+     * size classes */
+    NETBUF_F_SPLIT_META = 1u << 4,
+
+    /* count references on every buffer, so it can be shared with
+     * NetBufferRetain/NetBufferClone. NetBufferRelease drops one reference and
+     * the buffer only goes back to the pool with the last one. atomic in
+     * NETBUF_F_CONCURRENT mode */
+    NETBUF_F_REFCOUNT = 1u << 5,
+
+    /* map the slab with mmap instead of NETBUF_MALLOC. the slab is not filled
+     * with a debug pattern, so no page is touched before the headers are set
+     * up. implied by the arena options below */
+    NETBUF_F_MMAP = 1u << 6,
+
+    /* back the slab with huge pages: MAP_HUGETLB if huge pages are reserved,
+     * else transparent huge pages through madvise(MADV_HUGEPAGE), else
+     * regular pages */
+    NETBUF_F_HUGEPAGES = 1u << 7,
+
+    /* fault every page of the slab in at init (MAP_POPULATE) */
+    NETBUF_F_POPULATE = 1u << 8,
+
+    /* lock the slab in memory (mlock), init fails if that's not allowed */
+    NETBUF_F_MLOCK = 1u << 9,
+
+    /* make init O(1): buffers that were never used are handed out by a bump
+     * pointer and only set up then, the free list only holds released ones.
+     * memory of buffers never requested is never touched, so large slabs stay
+     * uncommitted until needed. can't be combined with size classes */
+    NETBUF_F_LAZY_INIT = 1u << 10,
+
+    /* keep used buffers in NETBUF_PRIORITY_LANES FIFO lanes instead of a single
+     * list, so NetBufferGetLRU returns the oldest buffer of the highest
+     * priority lane that isn't empty, in O(1). new buffers go to the lowest
+     * priority lane. implies NETBUF_F_LINKED_USED_LIST */
+    NETBUF_F_PRIORITY = 1u << 11,
+
+    /* stamp every buffer with NETBUF_TIMESTAMP() when it's requested, so stale
+     * ones can be found with NetBufferReclaimOlderThan */
+    NETBUF_F_TIMESTAMP = 1u << 12,
+};
+
+/* one size class of a multi-class pool */
+typedef struct net_buffer_class_config {
+    size_t buffer_size;
+    size_t num_buffers;
+} net_buffer_class_config_t;
+
+/* an interface of a partitioned pool, see net_buffer_config_t */
+typedef struct net_buffer_iface_config {
+    int8_t if_type;
+    int8_t if_id;
+    size_t min; /* buffers reserved for the interface, out of reach of the others */
+    size_t max; /* most buffers the interface may hold at once, 0 for no limit */
+} net_buffer_iface_config_t;
+
+typedef struct net_buffer_config {
+    size_t num_buffers;
+    size_t buffer_size;
+    uint32_t flags;
+
+    /* when set, the pool is made of these size classes, sorted by increasing
+     * buffer_size, and num_buffers/buffer_size above are ignored. at most 255
+     * classes, can't be combined with NETBUF_F_CONCURRENT */
+    const net_buffer_class_config_t* classes;
+    size_t num_classes;
+
+    /* bytes reserved in front of every payload, on top of buffer_size, so
+     * headers can be prepended with NetBufferPush without moving the data */
+    size_t headroom;
+
+    /* when set, the pool is partitioned between these interfaces: each one
+     * gets its `min` buffers reserved and its own used list, the buffers left
+     * over are shared by every interface and by requests without one. at most
+     * NETBUF_NO_IFACE interfaces, the `min`s must fit in num_buffers. implies
+     * NETBUF_F_LINKED_USED_LIST, can't be combined with size classes,
+     * NETBUF_F_CONCURRENT or NETBUF_F_PRIORITY */
+    const net_buffer_iface_config_t* ifaces;
+    size_t num_ifaces;
+} net_buffer_config_t;
+
+/* a size class of a multi-class pool, with its own free list */
+struct net_buffer_class {
+    size_t buffer_capacity;
+    size_t num_buffers;
+    size_t elem_size;
+    uint32_t first_index; /* pool-wide index of the first buffer of the class */
+    struct netbuffer* buffers; /* first buffer of the class in the pool slab */
+    struct simple_stack* free_list;
+    struct {
+        size_t used; /* buffers currently requested */
+        size_t high_water; /* max value `used` ever had */
+        size_t exhausted; /* requests that found the best fitting class empty */
+    } stats;
+};
+
+/* index-linked list of buffers, ordered from least to most recently inserted */
+struct netbuf_list {
+    uint32_t head;
+    uint32_t tail;
+    size_t count;
+};
+
+/* an interface of a partitioned pool, with its own used list */
+struct net_buffer_iface {
+    int8_t if_type;
+    int8_t if_id;
+    size_t min;
+    size_t max;
+    size_t used; /* buffers currently requested for the interface */
+    struct netbuf_list used_links;
+};
+
 /* forward decl. */
 struct simple_stack;
 struct circular_buffer;
 
+/* log-bucketed histogram of timestamp deltas. values below 4 have a bucket
+ * each, above that every power of two is split in 4 buckets, so a bucket is
+ * at most 25% wider than its lower bound */
+#define NETBUF_HIST_SUB_BITS 2
+#define NETBUF_HIST_BUCKETS ((64 - NETBUF_HIST_SUB_BITS + 1) << NETBUF_HIST_SUB_BITS)
+
+typedef struct net_buffer_hist {
+    uint64_t count[NETBUF_HIST_BUCKETS];
+} net_buffer_hist_t;
+
+/* hold time histograms of a pool, see NetBufferGetHoldHist */
+struct net_buffer_hold {
+    net_buffer_hist_t all;
+    uint32_t key[NETBUF_HOLD_IFACES]; /* interface of each slot below, 0 if free */
+    net_buffer_hist_t iface[NETBUF_HOLD_IFACES];
+};
+
+/* values of net_buffer_trace_entry_t::event */
+enum {
+    NETBUF_TRACE_REQUEST = 1,
+    NETBUF_TRACE_RELEASE = 2,
+    NETBUF_TRACE_WRITE = 3,
+    NETBUF_TRACE_FAIL = 4, /* a request that found the pool empty */
+};
+
+/* one event of the trace, as written to the file by NetBufferTraceDump */
+typedef struct net_buffer_trace_entry {
+    uint64_t timestamp; /* NETBUF_TIMESTAMP() */
+    uint64_t caller; /* return address into the code that called the pool */
+    uint64_t pool; /* address of the net_buffer_cb_t */
+    uint32_t index; /* buffer index, NETBUF_NO_INDEX for NETBUF_TRACE_FAIL */
+    uint32_t tid; /* kernel thread id */
+    uint32_t event; /* NETBUF_TRACE_* */
+    uint32_t len; /* bytes written for NETBUF_TRACE_WRITE, else 0 */
+} net_buffer_trace_entry_t;
+
+/* start of a trace file, followed by `count` entries of `entry_size` bytes */
+#define NETBUF_TRACE_MAGIC 0x5254424Eu /* "NBTR" */
+#define NETBUF_TRACE_VERSION 1
+
+typedef struct net_buffer_trace_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t count;
+} net_buffer_trace_header_t;
+
+/* pool counters, see NetBufferGetStats */
+typedef struct net_buffer_stats {
+    size_t high_water; /* max number of buffers used at once */
+    uint64_t requests; /* buffers handed out */
+    uint64_t releases; /* buffers given back */
+    uint64_t failures; /* requests (bulk or not) cut short by an empty pool or class */
+    uint64_t slow_releases; /* releases that had to search the used list */
+
+    /* requests by the occupancy they left the pool at: bucket i counts the
+     * ones that left between i/NETBUF_STATS_BUCKETS and
+     * (i+1)/NETBUF_STATS_BUCKETS of the buffers in use */
+    uint64_t occupancy[NETBUF_STATS_BUCKETS];
+} net_buffer_stats_t;
+
+/* one thread's counters, on their own cache lines */
+struct net_buffer_stats_shard {
+    uint64_t requests;
+    uint64_t releases;
+    uint64_t failures;
+    uint64_t slow_releases;
+    uint64_t occupancy[NETBUF_STATS_BUCKETS];
+} __attribute__((aligned(NETBUF_CACHE_LINE_SIZE)));
+
 typedef struct net_buffer_cb {
     size_t num_buffers;
     size_t buffer_capacity;
+    size_t elem_size; /* distance between two consecutive headers, 0 with size classes */
+    uint32_t flags;
     struct {
-        uint8_t high_water;
+        size_t high_water; /* kept by NetBufferUpdateCounters, and by every request with NETBUF_STATS */
+#if NETBUF_STATS
+        struct net_buffer_stats_shard shard[NETBUF_STATS_SHARDS];
+#endif
     } stats;
-    struct simple_stack* free_list;
-    struct circular_buffer* used_list;
+    struct simple_stack* free_list; /* NULL in NETBUF_F_CONCURRENT mode, the largest class' with size classes */
+    size_t lazy_next; /* index of the first buffer never handed out, see NETBUF_F_LAZY_INIT */
+    struct circular_buffer* used_list; /* NULL in NETBUF_F_LINKED_USED_LIST and NETBUF_F_CONCURRENT mode */
+    struct netbuf_list used_links; /* only used in NETBUF_F_LINKED_USED_LIST mode, only the count with NETBUF_F_PRIORITY or interfaces */
+    uint64_t* used_map; /* bit i is set while buffer i is in the used list. NULL in NETBUF_F_CONCURRENT mode */
+    struct {
+        struct netbuf_list lanes[NETBUF_PRIORITY_LANES];
+        uint32_t mask; /* bit i is set when lane i is not empty */
+    } prio; /* only used in NETBUF_F_PRIORITY mode */
+    struct {
+        struct net_buffer_iface* list; /* NULL unless the pool is partitioned */
+        size_t count;
+        struct netbuf_list untagged; /* used buffers requested without an interface */
+        size_t shared_free; /* buffers beyond the reservations that nobody holds */
+    } ifaces;
+    struct {
+        /* top of the free list: ABA tag in the upper 32 bits, buffer index in
+         * the lower 32 bits. only accessed through atomic builtins */
+        uint64_t free_head;
+        size_t used_count;
+    } mt; /* only used in NETBUF_F_CONCURRENT mode */
+    struct {
+        uint8_t lock; /* serializes magazine refills/flushes on a plain pool */
+        size_t held; /* buffers taken out of a plain pool by magazines */
+    } depot;
+    size_t num_classes; /* 0 unless the pool was initialized with size classes */
+    struct net_buffer_class* classes;
     struct netbuffer* buffers;
+    uint8_t* payload; /* payload slab, only in NETBUF_F_SPLIT_META mode */
+    size_t payload_stride;
+    size_t headroom; /* initial data_offset of every buffer */
+    void* slab; /* the allocation backing buffers and payload */
+    uint8_t is_static; /* storage is owned by the caller, see NetBufferInitStatic */
+    struct net_buffer_hold* hold; /* NULL unless built with NETBUF_HOLD_HIST and NETBUF_F_TIMESTAMP is set */
+    struct {
+        size_t size; /* length of the mapping, 0 if the slab was not mapped */
+        uint8_t hugetlb; /* the mapping is backed by MAP_HUGETLB pages */
+    } arena; /* only used with NETBUF_F_MMAP */
 } net_buffer_cb_t;
 
+/* payload area of a clone, see NetBufferHead */
+uint8_t* NetBufferSharedHead(const net_buffer_cb_t* cb, const net_buffer_t* buffer);
+
+/* start of the payload area of `buffer`, headroom included. same as
+ * buffer->user_data unless the pool was initialized with NETBUF_F_SPLIT_META
+ * or the buffer is a clone */
+static inline uint8_t* NetBufferHead(const net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    if (buffer->payload_owner != NETBUF_NO_INDEX) {
+        return NetBufferSharedHead(cb, buffer);
+    }
+    if (cb->payload) {
+        return cb->payload + (size_t)(buffer - cb->buffers) * cb->payload_stride;
+    }
+    return buffer->user_data;
+}
+
+/* start of the data of `buffer`, `user_data_length` bytes long */
+static inline uint8_t* NetBufferData(const net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    return NetBufferHead(cb, buffer) + buffer->data_offset;
+}
+
+/* buffer whose slot `p` points into, such as a pointer returned by
+ * NetBufferData. NULL if `p` is outside the pool. O(1) unless the pool has
+ * size classes */
+net_buffer_t* NetBufferFromData(const net_buffer_cb_t* cb, const void* p);
+
 int NetBufferInit(net_buffer_cb_t* cb, size_t nElems, size_t bufSize);
+int NetBufferInitEx(net_buffer_cb_t* cb, const net_buffer_config_t* cfg);
 int NetBufferDeinit(net_buffer_cb_t* cb);
 
+/* upper bound of the fixed part of the free and used list structures */
+#define NETBUF_LIST_OVERHEAD (4 * sizeof(size_t))
+
+/* bytes of the bitmap of used buffers of a pool of `n` buffers */
+#define NETBUF_USED_MAP_SIZE(n) (((size_t)(n) + 63) / 64 * sizeof(uint64_t))
+
+/* distance between two headers of a NetBufferInitStatic pool */
+#define NETBUF_ELEM_SIZE(size) \
+    ((sizeof(net_buffer_t) + (size) + __alignof__(net_buffer_t) - 1) & ~(__alignof__(net_buffer_t) - 1))
+
+/* bytes of memory NetBufferInitStatic needs for `n` buffers of `size` bytes,
+ * wherever the memory is aligned. a constant expression */
+#define NETBUF_POOL_STORAGE_SIZE(n, size)                              \
+    (__alignof__(net_buffer_t) - 1                                     \
+        + (size_t)(n) * NETBUF_ELEM_SIZE(size)                         \
+        + 2 * (NETBUF_LIST_OVERHEAD + (size_t)(n) * sizeof(void*))     \
+        + NETBUF_USED_MAP_SIZE(n))
+
+/* Initializes a pool without allocating: the buffers, the free list, the used
+ * list and its bitmap are laid out back to back in `mem`, which must stay valid until
+ * NetBufferDeinit and hold NETBUF_POOL_STORAGE_SIZE(nElems, bufSize) bytes.
+ * the pool works as one initialized with NetBufferInit */
+int NetBufferInitStatic(net_buffer_cb_t* cb, void* mem, size_t memSize, size_t nElems, size_t bufSize);
+
+/* Defines a pool `name` with its storage at file scope, and a
+ * `name##_init()` function that initializes it with no heap access:
+ *
+ *     NETBUF_POOL_DEFINE(rx_pool, 64, 128);
+ *     ...
+ *     rx_pool_init();
+ *     net_buffer_t* b = NetBufferRequest(rx_pool);
+ */
+#define NETBUF_POOL_DEFINE(name, n, size)                                                 \
+    static uint8_t name##_storage[NETBUF_POOL_STORAGE_SIZE(n, size)];                      \
+    static net_buffer_cb_t name[1];                                                        \
+    static inline int name##_init(void)                                                    \
+    {                                                                                      \
+        return NetBufferInitStatic(name, name##_storage, sizeof(name##_storage), n, size); \
+    }
+
 net_buffer_t* NetBufferRequest(net_buffer_cb_t* cb);
 net_buffer_t* NetBufferRequestUnchecked(net_buffer_cb_t* cb);
 int NetBufferRelease(net_buffer_cb_t* cb, net_buffer_t* buffer);
 
+/* Takes one more reference on a used buffer, to be dropped with
+ * NetBufferRelease. requires NETBUF_F_REFCOUNT */
+int NetBufferRetain(net_buffer_cb_t* cb, net_buffer_t* buffer);
+
+/* Requests a new buffer that shares the payload of `buffer` instead of copying
+ * it. the clone has its own header, copied from `buffer`, and holds a
+ * reference on the payload owner until it's released. the clone takes a pool
+ * slot, from the smallest size class if there are several. buffers with a
+ * chain can't be cloned. requires NETBUF_F_REFCOUNT */
+net_buffer_t* NetBufferClone(net_buffer_cb_t* cb, net_buffer_t* buffer);
+
+/* Requests a buffer that can hold at least `len` bytes, from the smallest size
+ * class that fits. falls back to larger classes only with NETBUF_F_CLASS_FALLBACK.
+ * on a single size pool this is NetBufferRequest if `len` fits.
+ * NetBufferRequest on a multi-class pool requests from the largest class */
+net_buffer_t* NetBufferRequestSized(net_buffer_cb_t* cb, size_t len);
+
+/* room from the start of the data to the end of the payload area of
+ * `buffer`, which depends on its size class. that's the size it was requested
+ * with as long as the data starts right after the headroom */
+size_t NetBufferGetCapacity(const net_buffer_cb_t* cb, const net_buffer_t* buffer);
+
+/* alignment the data of every buffer has when it's requested, a power of two
+ * fixed by the pool layout and headroom */
+size_t NetBufferGetDataAlignment(const net_buffer_cb_t* cb);
+
+/* number of buffers currently requested from size class `cls` */
+int NetBufferGetClassUsedCount(const net_buffer_cb_t* cb, size_t cls);
+
+/* Partitioned pools: a buffer requested for an interface comes out of the
+ * interface's reservation first, then out of the shared buffers as long as
+ * the interface is under its `max`. a buffer requested without an interface
+ * only ever comes out of the shared buffers. both checks are O(1).
+ * NetBufferRequestUnchecked skips them, don't use it on a partitioned pool */
+
+/* slot of interface (if_type, if_id) in the pool's net_buffer_config_t::ifaces,
+ * -1 if it has none. look it up once, the slot doesn't change */
+int NetBufferFindIface(const net_buffer_cb_t* cb, int8_t if_type, int8_t if_id);
+
+/* Requests a buffer for interface slot `iface`, with if_type and if_id set.
+ * NULL if the interface is at its `max`, or its reservation is used up and
+ * the shared buffers too */
+net_buffer_t* NetBufferRequestIface(net_buffer_cb_t* cb, size_t iface);
+
+/* number of buffers currently requested for interface slot `iface` */
+int NetBufferGetIfaceUsedCount(const net_buffer_cb_t* cb, size_t iface);
+
+/* least recently requested buffer of interface slot `iface`, NULL if none */
+net_buffer_t* NetBufferGetIfaceLRU(net_buffer_cb_t* cb, size_t iface);
+
+/* Requests up to `n` buffers at once, in request order. returns how many were
+ * stored in `out`, fewer than `n` if the pool runs out, or -1 on error */
+int NetBufferRequestBulk(net_buffer_cb_t* cb, net_buffer_t** out, size_t n);
+
+/* Releases `n` buffers at once. a leading run of buffers in LRU order is
+ * released with a single used list update. returns how many buffers were
+ * released, invalid ones are skipped, or -1 on error */
+int NetBufferReleaseBulk(net_buffer_cb_t* cb, net_buffer_t* const* buffers, size_t n);
+
 /* Write `len` bytes of `data` to the buffer and set the `user_data_length` field
  * Performs validation over `len`, but does not check if `cb` or `buffer` are valid */
 int NetBufferWriteChecked(net_buffer_cb_t* cb, net_buffer_t* buffer, const void* data, size_t len);
 
+/* Data offsets: the data of a buffer is a window of `user_data_length` bytes
+ * starting `data_offset` bytes into its payload area. these move the window
+ * instead of the bytes, so adding or stripping a protocol header is O(1).
+ * none of them check that `cb` or `buffer` are valid */
+
+/* grows the data by `len` bytes at the front, into the headroom. returns the
+ * new start of the data, or NULL if the headroom is too small */
+uint8_t* NetBufferPush(const net_buffer_cb_t* cb, net_buffer_t* buffer, size_t len);
+
+/* strips `len` bytes from the front of the data. returns the new start of the
+ * data, or NULL if the data is shorter than `len` */
+uint8_t* NetBufferPull(const net_buffer_cb_t* cb, net_buffer_t* buffer, size_t len);
+
+/* grows the data by `len` bytes at the back. returns the start of the added
+ * bytes, or NULL if the tailroom is too small */
+uint8_t* NetBufferPut(const net_buffer_cb_t* cb, net_buffer_t* buffer, size_t len);
+
+/* cuts the data down to `len` bytes, if it's longer */
+void NetBufferTrim(net_buffer_t* buffer, size_t len);
+
+/* bytes free in front of and after the data */
+size_t NetBufferHeadroom(const net_buffer_t* buffer);
+size_t NetBufferTailroom(const net_buffer_cb_t* cb, const net_buffer_t* buffer);
+
 int NetBufferGetUsedCount(net_buffer_cb_t* self);
 
+/* least recently requested buffer. a partitioned pool has no single order,
+ * this is the oldest buffer of the first used list that isn't empty: the one
+ * of requests without an interface, then each interface in slot order */
 net_buffer_t* NetBufferGetLRU(net_buffer_cb_t* self);
 
+/* 1 if `buffer` is a buffer of `cb` that is currently requested, 0 if it's
+ * free or doesn't belong to the pool. O(1), and safe to call on any pointer
+ * (NULL included). a buffer cached in a magazine is free until the magazine
+ * hands it out, and from then on the magazine's: 0 unless the pool is
+ * NETBUF_F_CONCURRENT */
+int NetBufferIsUsed(const net_buffer_cb_t* cb, const net_buffer_t* buffer);
+
+/* called on each used buffer by NetBufferForEachUsed. a non zero return stops
+ * the walk. it may release `buffer` but no other buffer of the pool */
+typedef int (*net_buffer_visit_fn)(net_buffer_cb_t* cb, net_buffer_t* buffer, void* ctx);
+
+/* calls `fn` on every buffer in the used list, in buffer index order. the walk
+ * reads the bitmap of used buffers and skips 64 free ones per word, so a
+ * sparse pool is cheap to walk. doesn't work in NETBUF_F_CONCURRENT mode.
+ * returns how many buffers were visited, or -1 on error */
+int NetBufferForEachUsed(net_buffer_cb_t* cb, net_buffer_visit_fn fn, void* ctx);
+
+/* default NETBUF_TIMESTAMP clock, CLOCK_MONOTONIC_COARSE in nanoseconds */
+uint64_t NetBufferNow(void);
+
+/* called on each buffer NetBufferReclaimOlderThan is about to release. it must
+ * not release the buffer itself */
+typedef void (*net_buffer_reclaim_fn)(net_buffer_cb_t* cb, net_buffer_t* buffer, void* ctx);
+
+/* Releases the used buffers requested more than `age` ago, in timestamp units,
+ * calling `fn` (if not NULL) on each first. the used list is in request order,
+ * so the walk starts at the LRU end and stops at the first buffer that is
+ * still fresh, or still shared with a clone. with NETBUF_F_PRIORITY every lane
+ * is walked, a buffer moved with NetBufferSetPriority may be reclaimed late.
+ * requires NETBUF_F_TIMESTAMP and doesn't work in NETBUF_F_CONCURRENT mode.
+ * returns how many buffers were released, or -1 on error */
+int NetBufferReclaimOlderThan(net_buffer_cb_t* cb, uint64_t age, net_buffer_reclaim_fn fn, void* ctx);
+
+/* Hold time histograms: with NETBUF_HOLD_HIST, every release of a buffer of a
+ * NETBUF_F_TIMESTAMP pool records how long it was requested, in timestamp
+ * units, globally and for its interface. buffers released through a
+ * magazine are not recorded */
+
+/* histogram of every buffer, NULL unless recording */
+const net_buffer_hist_t* NetBufferGetHoldHist(const net_buffer_cb_t* cb);
+
+/* histogram of the buffers of one interface, NULL if none was released yet
+ * or every slot was already taken */
+const net_buffer_hist_t* NetBufferGetIfHoldHist(const net_buffer_cb_t* cb, int8_t if_type, int8_t if_id);
+
+/* clears every histogram and frees the interface slots */
+void NetBufferResetHoldHist(net_buffer_cb_t* cb);
+
+/* number of values recorded */
+uint64_t NetBufferHistCount(const net_buffer_hist_t* hist);
+
+/* upper bound of the bucket holding the `q` quantile (0.5, 0.99, 0.999...),
+ * 0 if the histogram is empty */
+uint64_t NetBufferHistPercentile(const net_buffer_hist_t* hist, double q);
+
+/* Event trace: with NETBUF_TRACE, NetBufferRequest(Unchecked|Sized|Bulk),
+ * NetBufferRelease(Bulk), NetBufferClone and NetBufferWriteChecked log an
+ * event in a ring owned by the calling thread, so logging takes no lock.
+ * released chained buffers are logged through their head only, buffers served
+ * by a magazine are not logged. the rings of exited threads are kept until a
+ * new thread reuses them. the first event of a thread allocates its ring with
+ * NETBUF_MALLOC */
+
+/* Writes every ring to `path`: a net_buffer_trace_header_t, then the events
+ * of each ring oldest first. rings still being written may show torn events.
+ * decode with tools/netbuf_trace.c. returns the number of events written, or
+ * -1 on error or without NETBUF_TRACE */
+int NetBufferTraceDump(const char* path);
+
+/* forgets the events of every ring. rings still being written may keep some */
+void NetBufferTraceReset(void);
+
+/* Moves a used buffer to lane `prio` of a NETBUF_F_PRIORITY pool, as its most
+ * recent entry. returns -1 if the pool has no lanes or `prio` is out of range */
+int NetBufferSetPriority(net_buffer_cb_t* cb, net_buffer_t* buffer, uint8_t prio);
+
+/* lane of a CAN frame: the top bits of its identifier, 11 bits wide, or 29
+ * bits if it doesn't fit in 11. a lower identifier wins arbitration on the bus
+ * and gets a higher priority lane */
+static inline uint8_t NetBufferCanPriority(uint32_t id)
+{
+    const unsigned bits = id > 0x7FF ? 29 : 11;
+    return (uint8_t)(((uint64_t)(id & ((1u << bits) - 1)) * NETBUF_PRIORITY_LANES) >> bits);
+}
+
+/* records the current used count in the high water mark. only needed without
+ * NETBUF_STATS, which keeps it up to date on every request */
 int NetBufferUpdateCounters(net_buffer_cb_t* self);
 
+/* Copies the pool counters to `out`. counters only move forward and releases
+ * are read before requests, so a snapshot taken while other threads use the
+ * pool never shows more buffers released than requested. without NETBUF_STATS
+ * only high_water is set, the rest reads 0 */
+int NetBufferGetStats(const net_buffer_cb_t* cb, net_buffer_stats_t* out);
+
+/* Scatter-gather chains: a payload larger than one buffer is spread over
+ * several buffers linked through `chain_next`. the head is a regular buffer,
+ * the others are owned by the chain and can't be released on their own.
+ * releasing the head with NetBufferRelease/NetBufferReleaseBulk returns the
+ * whole chain to the pool. chained buffers count as used */
+
+struct iovec;
+
+/* Writes `len` bytes of `data` starting at the head buffer, requesting and
+ * chaining more buffers as needed. replaces any previous content and chain.
+ * returns `len`, or -1 if the pool ran out, in which case the head is left
+ * without a chain */
+int NetBufferWriteChain(net_buffer_cb_t* cb, net_buffer_t* head, const void* data, size_t len);
+
+/* Copies up to `len` bytes of the chain, starting `offset` bytes in, to `out`.
+ * returns how many bytes were copied */
+size_t NetBufferReadChain(net_buffer_cb_t* cb, net_buffer_t* head, size_t offset, void* out, size_t len);
+
+/* total payload length of the chain */
+size_t NetBufferChainLength(const net_buffer_cb_t* cb, const net_buffer_t* head);
+
+/* next buffer of the chain, NULL after the last one */
+net_buffer_t* NetBufferChainNext(const net_buffer_cb_t* cb, const net_buffer_t* buffer);
+
+/* Describes the payload of the chain in `iov`, one entry per buffer, ready for
+ * writev/sendmsg. returns the number of entries used, or -1 if more than
+ * `iovcnt` are needed */
+int NetBufferChainToIovec(net_buffer_cb_t* cb, net_buffer_t* head, struct iovec* iov, size_t iovcnt);
+
+/* Batched socket I/O straight into and out of pool buffers, for connected
+ * datagram sockets. at most NETBUF_IO_BATCH buffers are handled per call */
+
+#ifndef NETBUF_IO_BATCH
+#define NETBUF_IO_BATCH 64
+#endif
+
+/* max number of buffers in a chain sent by NetBufferSendBatch */
+#ifndef NETBUF_IO_MAX_IOV
+#define NETBUF_IO_MAX_IOV 8
+#endif
+
+/* Requests up to `n` buffers and fills them with one recvmmsg call on `fd`,
+ * one datagram per buffer, setting `user_data_length`. buffers left empty go
+ * back to the pool. `flags` are passed to recvmmsg (MSG_DONTWAIT...). returns
+ * how many buffers were stored in `out`, 0 if the pool is empty, or -1 if
+ * nothing was received, with errno set by recvmmsg */
+int NetBufferRecvBatch(net_buffer_cb_t* cb, int fd, net_buffer_t** out, size_t n, int flags);
+
+/* Sends `n` buffers with one sendmmsg call on `fd`, one datagram per buffer
+ * or chain. the buffers are not released. a chain longer than
+ * NETBUF_IO_MAX_IOV ends the batch, and fails it with EMSGSIZE if it comes
+ * first. returns how many were sent (0 when `n` is 0), or -1 with errno set */
+int NetBufferSendBatch(net_buffer_cb_t* cb, int fd, net_buffer_t* const* buffers, size_t n, int flags);
+
+/* Per-thread magazine: a small private stack of free buffers in front of a
+ * pool. requests and releases are served from the magazine and only touch the
+ * pool when it runs empty (refill) or fills up (flush), moving several buffers
+ * at once. the magazine itself is not thread-safe, give one to each thread.
+ *
+ * buffers served through a magazine are not entered in the pool's used list,
+ * so NetBufferGetLRU won't see them. buffers cached in a magazine can't be
+ * handed out to other threads, so NetBufferGetUsedCount counts them as used.
+ * on a plain (non NETBUF_F_CONCURRENT) pool refills and flushes take a spin
+ * lock, and the pool must not be used directly while magazines are active.
+ * pools with size classes are not supported. buffers requested from a plain
+ * pool directly must be released with NetBufferRelease, the magazine rejects
+ * them. on a plain pool, NetBufferWriteChain, NetBufferClone and
+ * NetBufferRetain refuse magazine buffers, on a NETBUF_F_CONCURRENT pool a
+ * magazine buffer with a chain or other references must be released with
+ * NetBufferRelease */
+
+typedef struct net_buffer_magazine_config {
+    size_t size; /* max number of cached buffers */
+    size_t refill; /* buffers taken from the pool when the magazine is empty, default size / 2 */
+    size_t flush_high; /* a release that finds this many cached buffers flushes... default size */
+    size_t flush_low; /* ...down to this many, default size / 2 */
+} net_buffer_magazine_config_t;
+
+typedef struct net_buffer_magazine {
+    net_buffer_cb_t* pool;
+    net_buffer_magazine_config_t cfg;
+    size_t count;
+    struct {
+        size_t request_local; /* requests served from the magazine */
+        size_t request_global; /* requests that had to refill from the pool */
+        size_t request_failed; /* requests that found the pool empty too */
+        size_t release_local; /* releases kept in the magazine */
+        size_t release_global; /* releases that flushed to the pool */
+    } stats;
+    net_buffer_t** entry;
+} net_buffer_magazine_t;
+
+int NetBufferMagazineInit(net_buffer_magazine_t* mag, net_buffer_cb_t* pool, const net_buffer_magazine_config_t* cfg);
+
+/* returns every cached buffer to the pool and frees the magazine storage */
+int NetBufferMagazineDeinit(net_buffer_magazine_t* mag);
+
+net_buffer_t* NetBufferMagazineRequest(net_buffer_magazine_t* mag);
+int NetBufferMagazineRelease(net_buffer_magazine_t* mag, net_buffer_t* buffer);
+
+/* returns every cached buffer to the pool */
+int NetBufferMagazineFlush(net_buffer_magazine_t* mag);
+
+/* io_uring receive path (Linux 5.19+): the pool buffers are handed to the
+ * kernel as a provided buffer ring, so a read picks a free pool buffer itself
+ * when data arrives instead of holding one while it waits. completed reads are
+ * entered in the used list as if the buffer had been requested, released
+ * buffers go back to the ring on the next submit. the payload area is also
+ * registered as a fixed buffer, if the memlock limit allows it, for writes.
+ *
+ * buffers lent to the kernel count as used. as with magazines the pool must not
+ * be used from another thread at the same time unless it's NETBUF_F_CONCURRENT,
+ * and pools with size classes, interface partitions or more than 65536
+ * buffers are not supported. works on any fd read/write work on: sockets, pipes, files */
+
+/* buffer group id of the provided buffer ring */
+#ifndef NETBUF_URING_BGID
+#define NETBUF_URING_BGID 0
+#endif
+
+/* values of net_buffer_uring_event_t::op */
+enum {
+    NETBUF_URING_READ = 1,
+    NETBUF_URING_WRITE = 2,
+};
+
+typedef struct net_buffer_uring_event {
+    net_buffer_t* buffer; /* buffer read into or written from, NULL if a read got no data */
+    int res; /* bytes transferred, or -errno */
+    uint8_t op; /* NETBUF_URING_* */
+} net_buffer_uring_event_t;
+
+/* forward decl. */
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+typedef struct net_buffer_uring {
+    net_buffer_cb_t* pool;
+    int fd; /* the io_uring instance */
+    struct {
+        unsigned* head;
+        unsigned* tail;
+        unsigned* array;
+        unsigned mask;
+        unsigned entries;
+        unsigned pending; /* queued entries the kernel hasn't seen yet */
+        struct io_uring_sqe* sqes;
+    } sq;
+    struct {
+        unsigned* head;
+        unsigned* tail;
+        unsigned mask;
+        struct io_uring_cqe* cqes;
+    } cq;
+    struct {
+        struct io_uring_buf_ring* ring;
+        unsigned entries;
+        uint16_t tail;
+        size_t lent; /* buffers in the ring */
+    } pbuf;
+    uint8_t* lent; /* per pool buffer, 1 while it's in the provided ring */
+    uint8_t fixed; /* the payload area is registered as fixed buffer 0 */
+    struct {
+        void* addr;
+        size_t size;
+    } maps[4]; /* sq ring, cq ring, sqes, provided buffer ring */
+    struct {
+        size_t reads; /* reads completed into a pool buffer */
+        size_t writes; /* writes completed */
+        size_t nobufs; /* reads that found the provided ring empty */
+    } stats;
+} net_buffer_uring_t;
+
+/* sets up an io_uring instance with `entries` submission slots and a provided
+ * buffer ring of as many buffers, rounded up to a power of two. fails with
+ * errno set by the kernel if io_uring is not available */
+int NetBufferUringInit(net_buffer_uring_t* ur, net_buffer_cb_t* pool, unsigned entries);
+
+/* tears the instance down, cancelling the operations in flight, and returns
+ * the buffers still in the provided ring to the pool. buffers of reaped reads
+ * stay in the used list */
+int NetBufferUringDeinit(net_buffer_uring_t* ur);
+
+/* queues a read on `fd` into a pool buffer picked by the kernel. returns -1 if
+ * the submission queue is full */
+int NetBufferUringRead(net_buffer_uring_t* ur, int fd);
+
+/* queues a write of the data of `buffer` to `fd`. the buffer stays owned by
+ * the caller and must not be released before the write completes. chains are
+ * not supported. returns -1 if the submission queue is full */
+int NetBufferUringWrite(net_buffer_uring_t* ur, int fd, net_buffer_t* buffer);
+
+/* tops the provided ring up from the pool, submits the queued operations and
+ * waits until at least `wait` completions are ready. returns how many
+ * operations were submitted, or -1 with errno set */
+int NetBufferUringSubmit(net_buffer_uring_t* ur, unsigned wait);
+
+/* stores up to `n` completions in `out`, without waiting. buffers of completed
+ * reads are in the used list, with `user_data_length` set. returns how many
+ * were stored */
+int NetBufferUringReap(net_buffer_uring_t* ur, net_buffer_uring_event_t* out, size_t n);
+
 #ifdef __cplusplus
 }
 #endif
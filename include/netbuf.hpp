@@ -0,0 +1,232 @@
+#ifndef NETBUF_HPP_
+#define NETBUF_HPP_
+
+/* C++ wrapper of a plain pool, header only: the storage lives inside the
+ * Pool object (see NetBufferInitStatic) and buffers are handed out as
+ * move-only handles that release them when they go out of scope.
+ *
+ *     netbuf::Pool<64, 128> rx;
+ *     if (auto buffer = rx.request()) {
+ *         buffer.write(frame, len);
+ *         ...
+ *     } // released here
+ *
+ * nothing is virtual and every member is inline, what is left after
+ * inlining are the calls to the C API a hand written version would make.
+ * PoolResource below is the exception, std::pmr dispatches through virtual
+ * calls */
+
+#include "netbuf.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+
+namespace netbuf {
+
+/* owns a requested buffer, or nothing */
+class Handle {
+public:
+    Handle() noexcept = default;
+
+    /* takes over a buffer requested with the C API */
+    Handle(net_buffer_cb_t* cb, net_buffer_t* buffer) noexcept
+        : cb_(cb)
+        , buffer_(buffer)
+    {
+    }
+
+    Handle(Handle&& other) noexcept
+        : cb_(other.cb_)
+        , buffer_(std::exchange(other.buffer_, nullptr))
+    {
+    }
+
+    Handle& operator=(Handle&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            cb_ = other.cb_;
+            buffer_ = std::exchange(other.buffer_, nullptr);
+        }
+        return *this;
+    }
+
+    Handle(const Handle&) = delete;
+    Handle& operator=(const Handle&) = delete;
+
+    ~Handle() { reset(); }
+
+    /* gives the buffer back to the pool now */
+    void reset() noexcept
+    {
+        if (buffer_) {
+            (void)NetBufferRelease(cb_, buffer_);
+            buffer_ = nullptr;
+        }
+    }
+
+    /* stops owning the buffer without releasing it, the caller has to */
+    [[nodiscard]] net_buffer_t* release() noexcept { return std::exchange(buffer_, nullptr); }
+
+    net_buffer_t* get() const noexcept { return buffer_; }
+    net_buffer_cb_t* pool() const noexcept { return cb_; }
+    net_buffer_t* operator->() const noexcept { return buffer_; }
+    net_buffer_t& operator*() const noexcept { return *buffer_; }
+    explicit operator bool() const noexcept { return buffer_ != nullptr; }
+
+    /* the data window, see NetBufferData */
+    uint8_t* data() const noexcept { return NetBufferData(cb_, buffer_); }
+    size_t size() const noexcept { return buffer_->user_data_length; }
+    size_t capacity() const noexcept { return NetBufferGetCapacity(cb_, buffer_); }
+
+    /* replaces the data, -1 if it doesn't fit. see NetBufferWriteChecked */
+    int write(const void* data, size_t len) noexcept { return NetBufferWriteChecked(cb_, buffer_, data, len); }
+
+private:
+    net_buffer_cb_t* cb_ = nullptr;
+    net_buffer_t* buffer_ = nullptr;
+};
+
+/* `N` buffers of `BufSize` bytes, without any heap access. the handles point
+ * into the pool, so it can't be copied or moved and must outlive them */
+template <size_t N, size_t BufSize>
+class Pool {
+    static_assert(N > 0 && N < NETBUF_NO_INDEX, "buffer indices must fit in 32 bits");
+    static_assert(BufSize > 0, "buffers can't be empty");
+
+public:
+    static constexpr size_t num_buffers = N;
+    static constexpr size_t buffer_size = BufSize;
+    static constexpr size_t storage_size = NETBUF_POOL_STORAGE_SIZE(N, BufSize);
+
+    Pool() noexcept
+    {
+        const int ret = NetBufferInitStatic(cb_, storage_, sizeof(storage_), N, BufSize);
+        NETBUF_ASSERT(ret == 0);
+        (void)ret;
+    }
+
+    ~Pool() { (void)NetBufferDeinit(cb_); }
+
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+
+    /* an empty handle if the pool ran out */
+    Handle request() noexcept { return Handle(cb_, NetBufferRequest(cb_)); }
+
+    /* requests a buffer holding a copy of `value`. whether it fits is checked
+     * at compile time */
+    template <typename T>
+    Handle request_with(const T& value) noexcept
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "the payload is copied bytewise");
+        static_assert(sizeof(T) <= BufSize, "the payload doesn't fit in a buffer");
+
+        Handle buffer = request();
+        if (buffer) {
+            std::memcpy(buffer.data(), &value, sizeof(T));
+            buffer->user_data_length = sizeof(T);
+        }
+        return buffer;
+    }
+
+    size_t used() noexcept { return (size_t)NetBufferGetUsedCount(cb_); }
+    size_t available() noexcept { return N - used(); }
+
+    /* the underlying pool, for the rest of the C API */
+    net_buffer_cb_t* native() noexcept { return cb_; }
+
+private:
+    net_buffer_cb_t cb_[1];
+    alignas(net_buffer_t) uint8_t storage_[storage_size];
+};
+
+/* std::pmr::memory_resource that serves each block out of a buffer of `cb`,
+ * for small containers on the packet path:
+ *
+ *     netbuf::PoolResource scratch(pool.native());
+ *     std::pmr::vector<signal> signals(&scratch);
+ *
+ * blocks larger than a buffer or more aligned than its data, and blocks asked
+ * for while the pool is empty, come from `upstream`. stats() shows how often.
+ * thread safe if the pool is NETBUF_F_CONCURRENT. the pool must outlive the
+ * blocks */
+class PoolResource : public std::pmr::memory_resource {
+public:
+    struct Stats {
+        size_t pooled; /* blocks served by the pool */
+        size_t oversize; /* blocks too large for a buffer */
+        size_t overaligned; /* blocks more aligned than the data of a buffer */
+        size_t exhausted; /* blocks that found the pool empty */
+    };
+
+    explicit PoolResource(net_buffer_cb_t* cb, std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) noexcept
+        : cb_(cb)
+        , upstream_(upstream)
+        , align_(NetBufferGetDataAlignment(cb))
+    {
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    Stats stats() const noexcept
+    {
+        return { pooled_.load(std::memory_order_relaxed), oversize_.load(std::memory_order_relaxed),
+            overaligned_.load(std::memory_order_relaxed), exhausted_.load(std::memory_order_relaxed) };
+    }
+
+    net_buffer_cb_t* pool() const noexcept { return cb_; }
+    std::pmr::memory_resource* upstream() const noexcept { return upstream_; }
+
+protected:
+    void* do_allocate(size_t bytes, size_t align) override
+    {
+        if (bytes > cb_->buffer_capacity) {
+            oversize_.fetch_add(1, std::memory_order_relaxed);
+            return upstream_->allocate(bytes, align);
+        }
+        if (align > align_) {
+            overaligned_.fetch_add(1, std::memory_order_relaxed);
+            return upstream_->allocate(bytes, align);
+        }
+
+        net_buffer_t* buffer = NetBufferRequestSized(cb_, bytes);
+        if (!buffer) {
+            exhausted_.fetch_add(1, std::memory_order_relaxed);
+            return upstream_->allocate(bytes, align);
+        }
+
+        pooled_.fetch_add(1, std::memory_order_relaxed);
+        return NetBufferData(cb_, buffer);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t align) override
+    {
+        if (net_buffer_t* buffer = NetBufferFromData(cb_, p)) {
+            (void)NetBufferRelease(cb_, buffer);
+            return;
+        }
+        upstream_->deallocate(p, bytes, align);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+private:
+    net_buffer_cb_t* cb_;
+    std::pmr::memory_resource* upstream_;
+    size_t align_; /* of the data of every buffer */
+    std::atomic<size_t> pooled_ = 0;
+    std::atomic<size_t> oversize_ = 0;
+    std::atomic<size_t> overaligned_ = 0;
+    std::atomic<size_t> exhausted_ = 0;
+};
+
+} // namespace netbuf
+
+#endif /* NETBUF_HPP_ */
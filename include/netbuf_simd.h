@@ -0,0 +1,37 @@
+#ifndef NETBUF_SIMD_H_
+#define NETBUF_SIMD_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stddef.h>
+
+/* pointer array kernels behind the containers. the first call picks the
+ * widest instruction set the CPU has, every level gives the same results */
+
+enum netbuf_simd_level {
+    NETBUF_SIMD_SCALAR,
+    NETBUF_SIMD_SSE2,
+    NETBUF_SIMD_AVX2,
+    NETBUF_SIMD_AVX512,
+};
+
+/* index of the first `item` in v[0..n), n if it isn't there */
+size_t netbuf_ptr_find(void* const* v, size_t n, const void* item);
+
+/* moves the non NULL entries of v[0..n) to the front, keeping their order,
+ * and sets the rest to NULL. returns how many entries are left */
+size_t netbuf_ptr_compact(void** v, size_t n);
+
+/* the level in use */
+enum netbuf_simd_level netbuf_simd_get_level(void);
+
+/* switches to `level`, for tests and benchmarks. -1 if the CPU can't run it */
+int netbuf_simd_set_level(enum netbuf_simd_level level);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* NETBUF_SIMD_H_ */
@@ -6,6 +6,7 @@ extern "C" {
 #endif
 
 #include "netbuf.h"
+#include "netbuf_simd.h"
 #include <assert.h>
 #include <string.h>
 #include <stdint.h>
@@ -48,6 +49,22 @@ static inline struct simple_stack* stack_alloc(size_t capacity)
     return q;
 }
 
+// allocate the stack without clearing the entries, so the memory behind them is only
+// touched as the stack grows. only push/pop and their bulk variants may be used on it
+static inline struct simple_stack* stack_alloc_uninit(size_t capacity)
+{
+    struct simple_stack* q = (struct simple_stack*)NETBUF_MALLOC(SIMPLE_STACK_TOTAL_SIZE(capacity));
+    if (q == NULL) {
+        return NULL;
+    }
+
+    q->is_sorted = 1;
+    q->tail_idx = 0;
+    q->capacity = capacity;
+
+    return q;
+}
+
 // initialize the members of the stack. useful if the stack is not dynamically allocated!
 static inline void stack_init(struct simple_stack* self, uint32_t capacity)
 {
@@ -87,57 +104,53 @@ static inline void stack_push(struct simple_stack* self, void* entry)
     self->entry[self->tail_idx++] = entry;
 }
 
-// returns 0 if item removed succesfully, -1 otherwise
-// if an entry is present multiple times, only the entry that was inserted first is removed
-static inline int stack_remove(struct simple_stack* self, void* entry)
+// pushes `n` entries with a single block copy, in order
+static inline void stack_push_bulk(struct simple_stack* self, void* const* entries, size_t n)
 {
-    size_t ub = self->is_sorted ? (size_t)self->tail_idx : self->capacity;
-    for (size_t i = 0; i < ub; ++i) {
-        if (self->entry[i] == entry) {
-            self->entry[i] = NULL;
-            self->is_sorted = 0;
-            return 0;
-        }
-    }
+    NETBUF_ASSERT(self->tail_idx + n <= self->capacity);
 
-    return -1;
+    memcpy(&self->entry[self->tail_idx], entries, n * sizeof(void*));
+    self->tail_idx += n;
 }
 
-static inline int stack_contains(struct simple_stack* self, void* entry)
+// pops the top `n` entries with a single block copy. `out` receives them in
+// the order they were pushed
+static inline void stack_pop_bulk(struct simple_stack* self, void** out, size_t n)
 {
-    size_t ub = self->is_sorted ? (size_t)self->tail_idx : self->capacity;
-    for (size_t i = 0; i < ub; ++i) {
-        if (self->entry[i] == entry) {
-            return 1;
-        }
-    }
+    NETBUF_ASSERT(n <= self->tail_idx);
+    self->tail_idx -= n;
 
-    return 0;
+    memcpy(out, &self->entry[self->tail_idx], n * sizeof(void*));
+
+    // mark entries as null
+    memset(&self->entry[self->tail_idx], 0, n * sizeof(void*));
 }
 
-// stable sort, push nulls to the back
-static inline int _cmp_higher_first(const void* lhs, const void* rhs)
+// returns 0 if item removed succesfully, -1 otherwise
+// if an entry is present multiple times, only the entry that was inserted first is removed
+static inline int stack_remove(struct simple_stack* self, void* entry)
 {
-    void* _lhs = *(void**)lhs;
-    void* _rhs = *(void**)rhs;
+    size_t ub = self->is_sorted ? (size_t)self->tail_idx : self->capacity;
+    size_t i = netbuf_ptr_find(self->entry, ub, entry);
+    if (i == ub) {
+        return -1;
+    }
 
-    if(_lhs == NULL) return +1;
-    if(_rhs == NULL) return -1;
+    self->entry[i] = NULL;
+    self->is_sorted = 0;
     return 0;
+}
 
-    /* return (uint8_t*)_rhs - (uint8_t*)_lhs ; */
+static inline int stack_contains(struct simple_stack* self, void* entry)
+{
+    size_t ub = self->is_sorted ? (size_t)self->tail_idx : self->capacity;
+    return netbuf_ptr_find(self->entry, ub, entry) < ub;
 }
 
+// push nulls to the back, keeping the order of the other entries. a single pass
 static inline void stack_sort(struct simple_stack* self)
 {
-    qsort(self->entry, self->capacity, sizeof(void*), _cmp_higher_first);
-    for(size_t i = 0; i < self->capacity; ++i) {
-        if (self->entry[i] == NULL) {
-            self->tail_idx = i;
-            break;
-        }
-    }
-
+    self->tail_idx = netbuf_ptr_compact(self->entry, self->capacity);
     self->is_sorted = 1;
 }
 
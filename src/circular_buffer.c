@@ -1,22 +1,26 @@
 #include "circular_buffer.h"
+#include "netbuf_simd.h"
 #include <string.h>
 
 struct circular_buffer* cbuf_alloc(size_t nElems)
 {
-    size_t totalSize = nElems * sizeof(void*) + sizeof(struct circular_buffer);
-    struct circular_buffer* cb = NETBUF_MALLOC(totalSize);
+    struct circular_buffer* cb = NETBUF_MALLOC(CBUF_TOTAL_SIZE(nElems));
 
     if (!cb) {
         return NULL;
     }
 
-    cb->count = 0;
-    cb->capacity = nElems;
-    cb->head = cb->tail = 0;
-
+    cbuf_init(cb, nElems);
     return cb;
 }
 
+void cbuf_init(struct circular_buffer* self, size_t nElems)
+{
+    self->count = 0;
+    self->capacity = nElems;
+    self->head = self->tail = 0;
+}
+
 void cbuf_free(struct circular_buffer* self)
 {
     free(self);
@@ -87,27 +91,19 @@ int cbuf_count(const struct circular_buffer* self)
 
 int cbuf_contains(const struct circular_buffer* self, const void* item)
 {
-    size_t found = 0;
-    ssize_t idx = self->head;
-    while (idx != self->head - 1) {
-
-        /* check for a match */
-        if (self->entry[idx] == item) {
-            found = 1;
-            break;
-        }
-
-        /* advance the iterator */
-        idx = idx + 1;
-        if ((size_t)idx >= self->capacity) {
-            idx -= (ssize_t)self->capacity;
-        }
+    /* only the live items, the slots outside [head, tail) hold stale values.
+     * they are at most two runs: up to the end of the array, then from 0 */
+    const size_t head = (size_t)self->head;
+    const size_t first = self->count < self->capacity - head ? self->count : self->capacity - head;
+
+    size_t idx = netbuf_ptr_find(&self->entry[head], first, item);
+    if (idx < first) {
+        return (int)(head + idx);
     }
 
-    if (!found) {
-        return -1;
-    }
-    return (int)idx;
+    const size_t second = self->count - first;
+    idx = netbuf_ptr_find(self->entry, second, item);
+    return idx < second ? (int)idx : -1;
 }
 
 int cbuf_remove(struct circular_buffer* self, void* item)
@@ -131,23 +127,37 @@ int cbuf_remove(struct circular_buffer* self, void* item)
         delta_tail += (ssize_t)self->capacity;
     }
 
+    const ssize_t cap = (ssize_t)self->capacity;
+    void** e = self->entry;
+
     if (delta_head < delta_tail) {
-        void* src = &self->entry[self->head];
-        void* dst = &self->entry[self->head + 1];
-        memmove(dst, src, sizeof(void*) * (size_t)delta_head);
+        /* shift [head, idx) one slot forward */
+        if (self->head <= idx) {
+            memmove(&e[self->head + 1], &e[self->head], sizeof(void*) * (size_t)delta_head);
+        } else {
+            memmove(&e[1], &e[0], sizeof(void*) * (size_t)idx);
+            e[0] = e[cap - 1];
+            memmove(&e[self->head + 1], &e[self->head], sizeof(void*) * (size_t)(cap - 1 - self->head));
+        }
 
         self->head += 1;
-        if ((size_t)self->head > self->capacity) {
-            self->head -= (ssize_t)self->capacity;
+        if (self->head >= cap) {
+            self->head -= cap;
         }
     } else {
-        void* src = &self->entry[idx + 1];
-        void* dst = &self->entry[idx];
-        memmove(dst, src, sizeof(void*) * (size_t)delta_tail);
+        /* shift (idx, tail) one slot backward */
+        if (idx + delta_tail < cap) {
+            memmove(&e[idx], &e[idx + 1], sizeof(void*) * (size_t)delta_tail);
+        } else {
+            const ssize_t before_wrap = cap - 1 - idx;
+            memmove(&e[idx], &e[idx + 1], sizeof(void*) * (size_t)before_wrap);
+            e[cap - 1] = e[0];
+            memmove(&e[0], &e[1], sizeof(void*) * (size_t)(delta_tail - before_wrap - 1));
+        }
 
         self->tail -= 1;
         if (self->tail < 0) {
-            self->tail += (ssize_t)self->capacity;
+            self->tail += cap;
         }
     }
 
@@ -169,5 +179,71 @@ void* cbuf_peek_back(const struct circular_buffer* self)
     if (!cbuf_count(self)) {
         return NULL;
     }
-    return self->entry[self->tail - 1];
+    return self->entry[self->tail ? self->tail - 1 : (ssize_t)self->capacity - 1];
+}
+
+void cbuf_push_back_bulk(struct circular_buffer* self, void* const* items, size_t n)
+{
+    NETBUF_ASSERT(self->count + n <= self->capacity);
+
+    /* at most two block copies: up to the end of the storage, then from the start */
+    const size_t first = n < self->capacity - (size_t)self->tail ? n : self->capacity - (size_t)self->tail;
+    memcpy(&self->entry[self->tail], items, first * sizeof(void*));
+    memcpy(&self->entry[0], items + first, (n - first) * sizeof(void*));
+
+    self->tail += (ssize_t)n;
+    if ((size_t)self->tail >= self->capacity) {
+        self->tail -= (ssize_t)self->capacity;
+    }
+
+    self->count += n;
+}
+
+void cbuf_pop_front_bulk(struct circular_buffer* self, void** out, size_t n)
+{
+    NETBUF_ASSERT(n <= self->count);
+
+    if (out) {
+        const size_t first = n < self->capacity - (size_t)self->head ? n : self->capacity - (size_t)self->head;
+        memcpy(out, &self->entry[self->head], first * sizeof(void*));
+        memcpy(out + first, &self->entry[0], (n - first) * sizeof(void*));
+    }
+
+    self->head += (ssize_t)n;
+    if ((size_t)self->head >= self->capacity) {
+        self->head -= (ssize_t)self->capacity;
+    }
+
+    self->count -= n;
+}
+
+void cbuf_pop_back_bulk(struct circular_buffer* self, size_t n)
+{
+    NETBUF_ASSERT(n <= self->count);
+
+    self->tail -= (ssize_t)n;
+    if (self->tail < 0) {
+        self->tail += (ssize_t)self->capacity;
+    }
+
+    self->count -= n;
+}
+
+size_t cbuf_match_front(const struct circular_buffer* self, void* const* items, size_t n)
+{
+    const size_t ub = n < self->count ? n : self->count;
+
+    ssize_t idx = self->head;
+    for (size_t i = 0; i < ub; ++i) {
+        if (self->entry[idx] != items[i]) {
+            return i;
+        }
+
+        idx = idx + 1;
+        if ((size_t)idx >= self->capacity) {
+            idx -= (ssize_t)self->capacity;
+        }
+    }
+
+    return ub;
 }
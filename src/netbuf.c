@@ -1,123 +1,1573 @@
 #include "netbuf.h"
 #include "circular_buffer.h"
 #include "simple_stack.h"
+#include "netbuf_internal.h"
 #include <assert.h>
+#include <time.h>
+
+/* appends `buffer` at the most recently used end of `list` */
+static inline void list_push_back(net_buffer_cb_t* cb, struct netbuf_list* list, net_buffer_t* buffer)
+{
+    const uint32_t idx = buffer_index(cb, buffer);
+
+    buffer->prev = list->tail;
+    buffer->next = NETBUF_NO_INDEX;
+
+    if (list->tail != NETBUF_NO_INDEX) {
+        buffer_at(cb, list->tail)->next = idx;
+    } else {
+        list->head = idx;
+    }
+
+    list->tail = idx;
+    list->count += 1;
+}
+
+/* unlinks `buffer` from `list`, wherever it is */
+static inline void list_remove(net_buffer_cb_t* cb, struct netbuf_list* list, net_buffer_t* buffer)
+{
+    if (buffer->prev != NETBUF_NO_INDEX) {
+        buffer_at(cb, buffer->prev)->next = buffer->next;
+    } else {
+        list->head = buffer->next;
+    }
+
+    if (buffer->next != NETBUF_NO_INDEX) {
+        buffer_at(cb, buffer->next)->prev = buffer->prev;
+    } else {
+        list->tail = buffer->prev;
+    }
+
+    buffer->prev = buffer->next = NETBUF_NO_INDEX;
+    list->count -= 1;
+}
+
+_Static_assert(NETBUF_PRIORITY_LANES >= 1 && NETBUF_PRIORITY_LANES <= 32, "lanes must fit in the lane mask");
+
+/* list a used buffer is linked in: the single used list, the buffer's lane
+ * in NETBUF_F_PRIORITY mode, or its interface's in a partitioned pool */
+static inline struct netbuf_list* used_list_of(net_buffer_cb_t* cb, const net_buffer_t* buffer)
+{
+    if (cb->flags & NETBUF_F_PRIORITY) {
+        return &cb->prio.lanes[buffer->priority];
+    }
+    if (cb->ifaces.list) {
+        return buffer->iface != NETBUF_NO_IFACE ? &cb->ifaces.list[buffer->iface].used_links : &cb->ifaces.untagged;
+    }
+    return &cb->used_links;
+}
+
+/* links a used buffer at the end of its list, NETBUF_F_LINKED_USED_LIST mode */
+static inline void used_link(net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    if (cb->flags & NETBUF_F_PRIORITY) {
+        list_push_back(cb, &cb->prio.lanes[buffer->priority], buffer);
+        cb->prio.mask |= 1u << buffer->priority;
+        cb->used_links.count += 1;
+        return;
+    }
+    if (cb->ifaces.list) {
+        /* past its reservation an interface holds a shared buffer */
+        if (buffer->iface == NETBUF_NO_IFACE) {
+            cb->ifaces.shared_free -= 1;
+        } else if (cb->ifaces.list[buffer->iface].used++ >= cb->ifaces.list[buffer->iface].min) {
+            cb->ifaces.shared_free -= 1;
+        }
+        list_push_back(cb, used_list_of(cb, buffer), buffer);
+        cb->used_links.count += 1;
+        return;
+    }
+    list_push_back(cb, &cb->used_links, buffer);
+}
+
+static inline void used_unlink(net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    if (cb->flags & NETBUF_F_PRIORITY) {
+        struct netbuf_list* lane = &cb->prio.lanes[buffer->priority];
+        list_remove(cb, lane, buffer);
+        if (lane->head == NETBUF_NO_INDEX) {
+            cb->prio.mask &= ~(1u << buffer->priority);
+        }
+        cb->used_links.count -= 1;
+        return;
+    }
+    if (cb->ifaces.list) {
+        list_remove(cb, used_list_of(cb, buffer), buffer);
+        if (buffer->iface == NETBUF_NO_IFACE) {
+            cb->ifaces.shared_free += 1;
+        } else if (--cb->ifaces.list[buffer->iface].used >= cb->ifaces.list[buffer->iface].min) {
+            cb->ifaces.shared_free += 1;
+        }
+        buffer->iface = NETBUF_NO_IFACE;
+        cb->used_links.count -= 1;
+        return;
+    }
+    list_remove(cb, &cb->used_links, buffer);
+}
+
+/* marks a buffer taken off a free list as used and appends it to the used
+ * list, without counting the request */
+static inline void link_used(net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    buffer->state = NETBUF_STATE_USED;
+    reset_header(cb, buffer);
+    used_map_set(cb, buffer_index(cb, buffer));
+
+    if (cb->flags & NETBUF_F_LINKED_USED_LIST) {
+        used_link(cb, buffer);
+    } else {
+        cbuf_push_back(cb->used_list, buffer);
+    }
+
+    if (cb->classes) {
+        struct net_buffer_class* cls = &cb->classes[buffer->size_class];
+        cls->stats.used += 1;
+        if (cls->stats.used > cls->stats.high_water) {
+            cls->stats.high_water = cls->stats.used;
+        }
+    }
+}
+
+static inline void enter_used(net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    link_used(cb, buffer);
+    stats_request(cb, 1, (size_t)NetBufferGetUsedCount(cb));
+}
+
+/* pops a buffer from `free_list`, or takes one never used before */
+static inline net_buffer_t* free_pop(net_buffer_cb_t* cb, struct simple_stack* free_list)
+{
+    net_buffer_t* buffer;
+    if (stack_count(free_list) || !lazy_take(cb, &buffer, 1)) {
+        buffer = stack_pop(free_list);
+    }
+    return buffer;
+}
+
+/* pops a buffer from `free_list` and enters it in the used list */
+static inline net_buffer_t* request_from(net_buffer_cb_t* cb, struct simple_stack* free_list)
+{
+    net_buffer_t* buffer = free_pop(cb, free_list);
+    enter_used(cb, buffer);
+    return buffer;
+}
+
+void depot_claim(net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    if (cb->flags & NETBUF_F_CONCURRENT) {
+        /* already counted by depot_take */
+        buffer->state = NETBUF_STATE_USED;
+        reset_header(cb, buffer);
+        return;
+    }
+
+    netbuf_lock(&cb->depot.lock);
+    cb->depot.held -= 1;
+    netbuf_unlock(&cb->depot.lock);
+
+    enter_used(cb, buffer);
+}
+
+/* gives a buffer that left the used list back to the free list it came from */
+static inline void free_push(net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    hold_record(cb, buffer, HOLD_NOW(cb));
+    buffer->state = NETBUF_STATE_FREE;
+    used_map_clear(cb, buffer_index(cb, buffer));
+
+    if (cb->classes) {
+        struct net_buffer_class* cls = &cb->classes[buffer->size_class];
+        cls->stats.used -= 1;
+        stack_push(cls->free_list, buffer);
+        STATS_RELEASE(cb, 1);
+        return;
+    }
+
+    stack_push(cb->free_list, buffer);
+    STATS_RELEASE(cb, 1);
+}
+
+static net_buffer_t* mt_request(net_buffer_cb_t* cb)
+{
+    net_buffer_t* buffer = mt_free_pop(cb);
+    if (!buffer && !lazy_take(cb, &buffer, 1)) {
+        STATS_ADD(cb, failures, 1);
+        return NULL;
+    }
+
+    __atomic_store_n(&buffer->state, NETBUF_STATE_USED, __ATOMIC_RELAXED);
+    reset_header(cb, buffer);
+    const size_t used = __atomic_add_fetch(&cb->mt.used_count, 1, __ATOMIC_RELAXED);
+    stats_request(cb, 1, used);
+    return buffer;
+}
+
+static int mt_release(net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    if (!is_pool_buffer(cb, buffer)) {
+        return -1;
+    }
+
+    /* only one of several racing releases of the same buffer wins */
+    if (!mark_free(buffer)) {
+        return -1;
+    }
+
+    __atomic_fetch_sub(&cb->mt.used_count, 1, __ATOMIC_RELAXED);
+    hold_record(cb, buffer, HOLD_NOW(cb));
+    mt_free_push(cb, buffer);
+    STATS_RELEASE(cb, 1);
+    return 0;
+}
 
 int NetBufferInit(net_buffer_cb_t* cb, size_t nElems, size_t bufSize)
 {
-    if (!cb || !nElems || !bufSize) {
+    const net_buffer_config_t cfg = {
+        .num_buffers = nElems,
+        .buffer_size = bufSize,
+        .flags = 0,
+    };
+
+    return NetBufferInitEx(cb, &cfg);
+}
+
+#define ROUND_UP(x, align) (((x) + (align) - 1) & ~((size_t)(align) - 1))
+
+/* distance between two headers for a payload of `bufSize`. every header
+ * stays naturally aligned whatever the payload size */
+static size_t elem_size_for(size_t bufSize, uint32_t flags)
+{
+    if (flags & NETBUF_F_SPLIT_META) {
+        return sizeof(net_buffer_t);
+    }
+    if (flags & NETBUF_F_CACHE_ALIGNED) {
+        return ROUND_UP(sizeof(net_buffer_t), NETBUF_CACHE_LINE_SIZE) + ROUND_UP(bufSize, NETBUF_CACHE_LINE_SIZE);
+    }
+    return ROUND_UP(sizeof(net_buffer_t) + bufSize, _Alignof(net_buffer_t));
+}
+
+/* offset of the first header in the slab. with cache aligned inline payloads
+ * the header sits right before a cache line boundary */
+static size_t header_offset_for(uint32_t flags)
+{
+    if ((flags & NETBUF_F_CACHE_ALIGNED) && !(flags & NETBUF_F_SPLIT_META)) {
+        return ROUND_UP(sizeof(net_buffer_t), NETBUF_CACHE_LINE_SIZE) - sizeof(net_buffer_t);
+    }
+    return 0;
+}
+
+/* lays the size classes out back to back in the pool slab */
+static int init_classes(net_buffer_cb_t* cb, const net_buffer_config_t* cfg, size_t* totalBufferSize)
+{
+    if (cfg->num_classes > UINT8_MAX + 1) {
+        return -1;
+    }
+
+    cb->classes = NETBUF_MALLOC(cfg->num_classes * sizeof(struct net_buffer_class));
+    if (!cb->classes) {
+        return -1;
+    }
+    memset(cb->classes, 0, cfg->num_classes * sizeof(struct net_buffer_class));
+    cb->num_classes = cfg->num_classes;
+
+    size_t offset = 0;
+    size_t first = 0;
+    for (size_t i = 0; i < cfg->num_classes; ++i) {
+        const net_buffer_class_config_t* c = &cfg->classes[i];
+        if (!c->num_buffers || !c->buffer_size) {
+            return -1;
+        }
+        if (i && c->buffer_size <= cfg->classes[i - 1].buffer_size) {
+            return -1;
+        }
+
+        struct net_buffer_class* cls = &cb->classes[i];
+        cls->buffer_capacity = c->buffer_size;
+        cls->num_buffers = c->num_buffers;
+        cls->elem_size = elem_size_for(c->buffer_size + cfg->headroom, cfg->flags);
+        cls->first_index = (uint32_t)first;
+        cls->free_list = stack_alloc(c->num_buffers);
+        if (!cls->free_list) {
+            return -1;
+        }
+
+        offset += cls->num_buffers * cls->elem_size;
+        first += cls->num_buffers;
+    }
+
+    cb->num_buffers = first;
+    cb->buffer_capacity = cfg->classes[cfg->num_classes - 1].buffer_size;
+    cb->elem_size = 0;
+    *totalBufferSize = offset;
+    return 0;
+}
+
+/* sets up the header of the buffer at index `i` as a free buffer */
+static net_buffer_t* init_header(net_buffer_cb_t* cb, size_t i)
+{
+    net_buffer_t* buffer;
+
+    if (cb->classes) {
+        size_t c = 0;
+        while (i >= cb->classes[c].first_index + cb->classes[c].num_buffers) {
+            c++;
+        }
+        const struct net_buffer_class* cls = &cb->classes[c];
+        buffer = (net_buffer_t*)((uint8_t*)cls->buffers + (i - cls->first_index) * cls->elem_size);
+        buffer->size_class = (uint8_t)c;
+    } else {
+        buffer = buffer_at(cb, (uint32_t)i);
+        buffer->size_class = 0;
+    }
+
+    buffer->state = NETBUF_STATE_FREE;
+    buffer->prev = buffer->next = NETBUF_NO_INDEX;
+    buffer->chain_next = NETBUF_NO_INDEX;
+    buffer->refcount = 0;
+    buffer->payload_owner = NETBUF_NO_INDEX;
+    buffer->data_offset = (uint32_t)cb->headroom;
+    buffer->priority = NETBUF_PRIORITY_LANES - 1;
+    buffer->iface = NETBUF_NO_IFACE;
+    buffer->user_data_length = 0;
+    return buffer;
+}
+
+/* checks the interfaces of a partitioned pool */
+static int init_ifaces_check(const net_buffer_config_t* cfg)
+{
+    if (!cfg->num_ifaces || cfg->num_ifaces > NETBUF_NO_IFACE || cfg->classes
+        || (cfg->flags & (NETBUF_F_CONCURRENT | NETBUF_F_PRIORITY))) {
+        return -1;
+    }
+
+    size_t reserved = 0;
+    for (size_t i = 0; i < cfg->num_ifaces; ++i) {
+        const net_buffer_iface_config_t* ifc = &cfg->ifaces[i];
+        if (ifc->max && ifc->max < ifc->min) {
+            return -1;
+        }
+        for (size_t j = 0; j < i; ++j) {
+            if (cfg->ifaces[j].if_type == ifc->if_type && cfg->ifaces[j].if_id == ifc->if_id) {
+                return -1;
+            }
+        }
+        reserved += ifc->min;
+        if (reserved > cfg->num_buffers) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int init_ifaces(net_buffer_cb_t* cb, const net_buffer_config_t* cfg)
+{
+    cb->ifaces.list = NETBUF_MALLOC(cfg->num_ifaces * sizeof(*cb->ifaces.list));
+    if (!cb->ifaces.list) {
+        return -1;
+    }
+    cb->ifaces.count = cfg->num_ifaces;
+    cb->ifaces.untagged.head = cb->ifaces.untagged.tail = NETBUF_NO_INDEX;
+    cb->ifaces.untagged.count = 0;
+    cb->ifaces.shared_free = cb->num_buffers;
+
+    for (size_t i = 0; i < cfg->num_ifaces; ++i) {
+        struct net_buffer_iface* ifc = &cb->ifaces.list[i];
+        ifc->if_type = cfg->ifaces[i].if_type;
+        ifc->if_id = cfg->ifaces[i].if_id;
+        ifc->min = cfg->ifaces[i].min;
+        ifc->max = cfg->ifaces[i].max;
+        ifc->used = 0;
+        ifc->used_links.head = ifc->used_links.tail = NETBUF_NO_INDEX;
+        ifc->used_links.count = 0;
+        cb->ifaces.shared_free -= ifc->min;
+    }
+    return 0;
+}
+
+/* puts every buffer of a freshly laid out pool on its free list. in
+ * NETBUF_F_LAZY_INIT mode the free list starts empty and lazy_take hands
+ * the buffers out instead */
+static void init_buffers(net_buffer_cb_t* cb)
+{
+    const size_t nElems = cb->num_buffers;
+
+    cb->lazy_next = 0;
+    cb->mt.used_count = 0;
+
+    if (cb->flags & NETBUF_F_LAZY_INIT) {
+        cb->mt.free_head = NETBUF_NO_INDEX;
+        return;
+    }
+
+    for (size_t i = 0; i < nElems; ++i) {
+        net_buffer_t* buffer = init_header(cb, i);
+
+        if (cb->flags & NETBUF_F_CONCURRENT) {
+            buffer->next = (i + 1 < nElems) ? (uint32_t)(i + 1) : NETBUF_NO_INDEX;
+        } else if (cb->classes) {
+            stack_push(cb->classes[buffer->size_class].free_list, buffer);
+        } else {
+            stack_push(cb->free_list, buffer);
+        }
+    }
+
+    cb->lazy_next = nElems;
+    cb->mt.free_head = 0;
+}
+
+size_t lazy_take(net_buffer_cb_t* cb, net_buffer_t** out, size_t n)
+{
+    size_t next = __atomic_load_n(&cb->lazy_next, __ATOMIC_RELAXED);
+    size_t count;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    do {
+        if (next >= cb->num_buffers) {
+            return 0;
+        }
+        count = cb->num_buffers - next < n ? cb->num_buffers - next : n;
+    } while (!__atomic_compare_exchange_n(&cb->lazy_next, &next, next + count, 1,
+        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    /* the bitmap words starting in the taken range are seen for the first time */
+    if (cb->used_map) {
+        for (size_t w = (next + 63) / 64; w * 64 < next + count; ++w) {
+            cb->used_map[w] = 0;
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = init_header(cb, next + i);
+#if NETBUF_DEBUG_FILL
+        memset(NetBufferHead(cb, out[i]), 0xAA, cb->buffer_capacity + cb->headroom);
+#endif
+    }
+    return count;
+}
+
+int NetBufferInitEx(net_buffer_cb_t* cb, const net_buffer_config_t* cfg)
+{
+    if (!cb || !cfg) {
+        return -1;
+    }
+
+    if (!cfg->classes && (!cfg->num_buffers || !cfg->buffer_size)) {
+        return -1;
+    }
+
+    if (cfg->classes && (!cfg->num_classes || (cfg->flags & (NETBUF_F_CONCURRENT | NETBUF_F_SPLIT_META | NETBUF_F_LAZY_INIT)))) {
+        return -1;
+    }
+
+    /* the linked used list is not thread-safe */
+    if ((cfg->flags & NETBUF_F_CONCURRENT) && (cfg->flags & (NETBUF_F_LINKED_USED_LIST | NETBUF_F_PRIORITY))) {
+        return -1;
+    }
+
+    /* data offsets are 32 bits wide */
+    if (cfg->headroom > UINT32_MAX / 2) {
+        return -1;
+    }
+
+    if (cfg->ifaces && init_ifaces_check(cfg) != 0) {
+        return -1;
+    }
+
+    memset(cb, 0, sizeof(*cb));
+    cb->flags = cfg->flags;
+    if ((cb->flags & NETBUF_F_PRIORITY) || cfg->ifaces) {
+        cb->flags |= NETBUF_F_LINKED_USED_LIST;
+    }
+    cb->headroom = cfg->headroom;
+    cb->used_links.head = cb->used_links.tail = NETBUF_NO_INDEX;
+    for (size_t i = 0; i < NETBUF_PRIORITY_LANES; ++i) {
+        cb->prio.lanes[i].head = cb->prio.lanes[i].tail = NETBUF_NO_INDEX;
+    }
+
+    size_t totalBufferSize;
+    if (cfg->classes) {
+        if (init_classes(cb, cfg, &totalBufferSize) != 0) {
+            goto cleanup;
+        }
+    } else {
+        cb->num_buffers = cfg->num_buffers;
+        cb->buffer_capacity = cfg->buffer_size;
+        cb->elem_size = elem_size_for(cfg->buffer_size + cfg->headroom, cfg->flags);
+        totalBufferSize = cb->num_buffers * cb->elem_size;
+    }
+
+    const size_t align = (cb->flags & NETBUF_F_CACHE_ALIGNED) ? NETBUF_CACHE_LINE_SIZE : _Alignof(net_buffer_t);
+    size_t payloadOffset = 0;
+    if (cb->flags & NETBUF_F_SPLIT_META) {
+        cb->payload_stride = ROUND_UP(cfg->buffer_size + cfg->headroom, align);
+        payloadOffset = ROUND_UP(totalBufferSize, align);
+        totalBufferSize = payloadOffset + cb->num_buffers * cb->payload_stride;
+    }
+
+    const size_t nElems = cb->num_buffers;
+
+    /* indices must fit in the header links, with room for NETBUF_NO_INDEX */
+    if (nElems >= NETBUF_NO_INDEX) {
+        goto cleanup;
+    }
+
+    /* room to align the start of the slab by hand */
+    if (cb->flags & NETBUF_F_ARENA) {
+        cb->slab = arena_map(cb, totalBufferSize + align - 1);
+    } else {
+        cb->slab = NETBUF_MALLOC(totalBufferSize + align - 1);
+    }
+    if (!cb->slab) {
+        goto cleanup;
+    }
+
+    uint8_t* base = (uint8_t*)ROUND_UP((uintptr_t)cb->slab, align);
+    const size_t headerOffset = header_offset_for(cb->flags);
+    cb->buffers = (net_buffer_t*)(base + headerOffset);
+    if (cb->flags & NETBUF_F_SPLIT_META) {
+        cb->payload = base + payloadOffset;
+    }
+
+    if (cb->classes) {
+        /* NetBufferRequest serves from the largest class */
+        cb->free_list = cb->classes[cb->num_classes - 1].free_list;
+    } else if (!(cb->flags & NETBUF_F_CONCURRENT)) {
+        cb->free_list = (cb->flags & NETBUF_F_LAZY_INIT) ? stack_alloc_uninit(nElems) : stack_alloc(nElems);
+        if (!cb->free_list) {
+            goto cleanup;
+        }
+    }
+
+    if (!(cb->flags & (NETBUF_F_LINKED_USED_LIST | NETBUF_F_CONCURRENT))) {
+        cb->used_list = cbuf_alloc(nElems);
+        if (!cb->used_list) {
+            goto cleanup;
+        }
+    }
+
+    if (!(cb->flags & NETBUF_F_CONCURRENT)) {
+        cb->used_map = NETBUF_MALLOC(NETBUF_USED_MAP_SIZE(nElems));
+        if (!cb->used_map) {
+            goto cleanup;
+        }
+        /* lazy pools clear each word when lazy_take reaches it */
+        if (!(cb->flags & NETBUF_F_LAZY_INIT)) {
+            memset(cb->used_map, 0, NETBUF_USED_MAP_SIZE(nElems));
+        }
+    }
+
+    // Initialize the memory to facilitate debugging. a mapped slab is left
+    // untouched, its pages are faulted in as the caller asked for, and lazy
+    // pools fill every buffer on its first use
+    if (NETBUF_DEBUG_FILL && !cb->arena.size && !(cb->flags & NETBUF_F_LAZY_INIT)) {
+        memset(base, 0xAA, totalBufferSize);
+    }
+
+    uint8_t* classBase = base + headerOffset;
+    for (size_t c = 0; c < cb->num_classes; ++c) {
+        struct net_buffer_class* cls = &cb->classes[c];
+        cls->buffers = (net_buffer_t*)classBase;
+        classBase += cls->num_buffers * cls->elem_size;
+    }
+
+    if (cfg->ifaces && init_ifaces(cb, cfg) != 0) {
+        goto cleanup;
+    }
+
+#if NETBUF_HOLD_HIST
+    if (cb->flags & NETBUF_F_TIMESTAMP) {
+        cb->hold = NETBUF_MALLOC(sizeof(*cb->hold));
+        if (!cb->hold) {
+            goto cleanup;
+        }
+        memset(cb->hold, 0, sizeof(*cb->hold));
+    }
+#endif
+
+    init_buffers(cb);
+
+    return 0;
+cleanup:
+    (void)NetBufferDeinit(cb);
+    return -1;
+}
+
+_Static_assert(sizeof(struct simple_stack) <= NETBUF_LIST_OVERHEAD, "NETBUF_LIST_OVERHEAD is too small");
+_Static_assert(sizeof(struct circular_buffer) <= NETBUF_LIST_OVERHEAD, "NETBUF_LIST_OVERHEAD is too small");
+
+int NetBufferInitStatic(net_buffer_cb_t* cb, void* mem, size_t memSize, size_t nElems, size_t bufSize)
+{
+    if (!cb || !mem || !nElems || !bufSize || nElems >= NETBUF_NO_INDEX) {
+        return -1;
+    }
+
+    const size_t align = _Alignof(net_buffer_t);
+    const size_t elemSize = elem_size_for(bufSize, 0);
+
+    /* buffers first, then the free list, the used list and its bitmap */
+    uint8_t* base = (uint8_t*)ROUND_UP((uintptr_t)mem, align);
+    const size_t totalBufferSize = nElems * elemSize;
+    const size_t stackOffset = totalBufferSize;
+    const size_t cbufOffset = stackOffset + ROUND_UP(SIMPLE_STACK_TOTAL_SIZE(nElems), align);
+    const size_t mapOffset = cbufOffset + ROUND_UP(CBUF_TOTAL_SIZE(nElems), _Alignof(uint64_t));
+    const size_t end = mapOffset + NETBUF_USED_MAP_SIZE(nElems);
+
+    if ((size_t)(base - (uint8_t*)mem) + end > memSize) {
+        return -1;
+    }
+
+    memset(cb, 0, sizeof(*cb));
+    cb->is_static = 1;
+    cb->num_buffers = nElems;
+    cb->buffer_capacity = bufSize;
+    cb->elem_size = elemSize;
+    cb->used_links.head = cb->used_links.tail = NETBUF_NO_INDEX;
+    cb->buffers = (net_buffer_t*)base;
+
+    cb->free_list = (struct simple_stack*)(base + stackOffset);
+    stack_init(cb->free_list, (uint32_t)nElems);
+    cb->used_list = (struct circular_buffer*)(base + cbufOffset);
+    cbuf_init(cb->used_list, nElems);
+    cb->used_map = (uint64_t*)(base + mapOffset);
+    memset(cb->used_map, 0, NETBUF_USED_MAP_SIZE(nElems));
+
+    // Initialize the memory to facilitate debugging
+    if (NETBUF_DEBUG_FILL) {
+        memset(base, 0xAA, totalBufferSize);
+    }
+
+    init_buffers(cb);
+    return 0;
+}
+
+int NetBufferDeinit(net_buffer_cb_t* cb)
+{
+    if (!cb) {
+        return -1;
+    }
+
+    cb->buffers = NULL;
+    cb->payload = NULL;
+
+    if (cb->hold) {
+        NETBUF_FREE(cb->hold);
+        cb->hold = NULL;
+    }
+
+    if (cb->ifaces.list) {
+        NETBUF_FREE(cb->ifaces.list);
+        cb->ifaces.list = NULL;
+        cb->ifaces.count = 0;
+    }
+
+    /* nothing was allocated */
+    if (cb->is_static) {
+        cb->free_list = NULL;
+        cb->used_list = NULL;
+        cb->used_map = NULL;
+        cb->is_static = 0;
+        return 0;
+    }
+
+    if (cb->classes) {
+        for (size_t i = 0; i < cb->num_classes; ++i) {
+            if (cb->classes[i].free_list) {
+                NETBUF_FREE(cb->classes[i].free_list);
+            }
+        }
+        NETBUF_FREE(cb->classes);
+        cb->classes = NULL;
+        cb->num_classes = 0;
+
+        /* an alias of the largest class' free list */
+        cb->free_list = NULL;
+    }
+
+    if (cb->arena.size) {
+        arena_unmap(cb);
+    }
+
+    // clang-format off
+    if (cb->slab)      { NETBUF_FREE(cb->slab),      cb->slab      = 0; }
+    if (cb->free_list) { NETBUF_FREE(cb->free_list), cb->free_list = 0; }
+    if (cb->used_list) { NETBUF_FREE(cb->used_list), cb->used_list = 0; }
+    if (cb->used_map)  { NETBUF_FREE(cb->used_map),  cb->used_map  = 0; }
+    // clang-format on
+    return 0;
+}
+
+static net_buffer_t* request_sized(net_buffer_cb_t* cb, size_t len);
+
+static net_buffer_t* request(net_buffer_cb_t* cb)
+{
+    if (cb->flags & NETBUF_F_CONCURRENT) {
+        return mt_request(cb);
+    }
+
+    if (cb->classes) {
+        return request_sized(cb, cb->buffer_capacity);
+    }
+
+    /* the reserved buffers are out of reach */
+    if (cb->ifaces.list ? cb->ifaces.shared_free == 0 : stack_count(cb->free_list) == 0 && lazy_remaining(cb) == 0) {
+        STATS_ADD(cb, failures, 1);
+        return NULL;
+    }
+
+    return request_from(cb, cb->free_list);
+}
+
+net_buffer_t* NetBufferRequest(net_buffer_cb_t* cb)
+{
+    if (!cb) {
+        return NULL;
+    }
+
+    net_buffer_t* buffer = request(cb);
+    PROBE2(request, cb, buffer);
+    TRACE(cb, buffer ? NETBUF_TRACE_REQUEST : NETBUF_TRACE_FAIL, buffer, 0);
+    return buffer;
+}
+
+__attribute__((always_inline)) inline net_buffer_t* NetBufferRequestUnchecked(net_buffer_cb_t* cb)
+{
+    net_buffer_t* buffer = cb->flags & NETBUF_F_CONCURRENT ? mt_request(cb) : request_from(cb, cb->free_list);
+    PROBE2(request, cb, buffer);
+    TRACE(cb, buffer ? NETBUF_TRACE_REQUEST : NETBUF_TRACE_FAIL, buffer, 0);
+    return buffer;
+}
+
+static net_buffer_t* request_sized(net_buffer_cb_t* cb, size_t len)
+{
+    if (!cb->classes) {
+        return len <= cb->buffer_capacity ? request(cb) : NULL;
+    }
+
+    /* classes are sorted, the first one that fits is the best fit */
+    size_t i = 0;
+    while (i < cb->num_classes && cb->classes[i].buffer_capacity < len) {
+        i++;
+    }
+    if (i == cb->num_classes) {
+        return NULL;
+    }
+
+    if (stack_count(cb->classes[i].free_list)) {
+        return request_from(cb, cb->classes[i].free_list);
+    }
+    cb->classes[i].stats.exhausted++;
+
+    if (cb->flags & NETBUF_F_CLASS_FALLBACK) {
+        for (i = i + 1; i < cb->num_classes; ++i) {
+            if (stack_count(cb->classes[i].free_list)) {
+                return request_from(cb, cb->classes[i].free_list);
+            }
+        }
+    }
+
+    STATS_ADD(cb, failures, 1);
+    return NULL;
+}
+
+net_buffer_t* NetBufferRequestSized(net_buffer_cb_t* cb, size_t len)
+{
+    if (!cb) {
+        return NULL;
+    }
+
+    net_buffer_t* buffer = request_sized(cb, len);
+    PROBE2(request, cb, buffer);
+    TRACE(cb, buffer ? NETBUF_TRACE_REQUEST : NETBUF_TRACE_FAIL, buffer, 0);
+    return buffer;
+}
+
+static net_buffer_t* request_iface(net_buffer_cb_t* cb, size_t iface)
+{
+    struct net_buffer_iface* ifc = &cb->ifaces.list[iface];
+
+    /* past its reservation, an interface needs a shared buffer and room under
+     * its cap */
+    if (ifc->used >= ifc->min && (cb->ifaces.shared_free == 0 || (ifc->max && ifc->used >= ifc->max))) {
+        STATS_ADD(cb, failures, 1);
+        return NULL;
+    }
+
+    net_buffer_t* buffer = free_pop(cb, cb->free_list);
+    buffer->iface = (uint8_t)iface;
+    enter_used(cb, buffer);
+    buffer->if_type = ifc->if_type;
+    buffer->if_id = ifc->if_id;
+    return buffer;
+}
+
+net_buffer_t* NetBufferRequestIface(net_buffer_cb_t* cb, size_t iface)
+{
+    if (!cb || iface >= cb->ifaces.count) {
+        return NULL;
+    }
+
+    net_buffer_t* buffer = request_iface(cb, iface);
+    PROBE2(request, cb, buffer);
+    TRACE(cb, buffer ? NETBUF_TRACE_REQUEST : NETBUF_TRACE_FAIL, buffer, 0);
+    return buffer;
+}
+
+int NetBufferFindIface(const net_buffer_cb_t* cb, int8_t if_type, int8_t if_id)
+{
+    if (!cb) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < cb->ifaces.count; ++i) {
+        if (cb->ifaces.list[i].if_type == if_type && cb->ifaces.list[i].if_id == if_id) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+int NetBufferGetIfaceUsedCount(const net_buffer_cb_t* cb, size_t iface)
+{
+    if (!cb || iface >= cb->ifaces.count) {
+        return -1;
+    }
+    return (int)cb->ifaces.list[iface].used;
+}
+
+net_buffer_t* NetBufferGetIfaceLRU(net_buffer_cb_t* cb, size_t iface)
+{
+    if (!cb || iface >= cb->ifaces.count || cb->ifaces.list[iface].used_links.head == NETBUF_NO_INDEX) {
+        return NULL;
+    }
+    return buffer_at(cb, cb->ifaces.list[iface].used_links.head);
+}
+
+/* releases a single buffer, ignoring any chain */
+static int release_one(net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    if (cb->flags & NETBUF_F_CONCURRENT) {
+        return mt_release(cb, buffer);
+    }
+
+    /* check if the buffer is on the front, which should be the case for this
+     * whole stupidity of abstraction to work performantly */
+    if (!(cb->flags & NETBUF_F_LINKED_USED_LIST) && buffer == cbuf_peek_front(cb->used_list)) {
+        cbuf_pop_front(cb->used_list);
+        free_push(cb, buffer);
+        return 0;
+    }
+
+    /* double releases and foreign pointers are caught here, without searching
+     * the used list */
+    if (!is_pool_buffer(cb, buffer) || !used_map_test(cb, buffer_index(cb, buffer))) {
+        return -1;
+    }
+
+    if (cb->flags & NETBUF_F_LINKED_USED_LIST) {
+        used_unlink(cb, buffer);
+    } else {
+        const int ret = cbuf_remove(cb->used_list, buffer);
+        NETBUF_ASSERT(ret == 0);
+        (void)ret;
+        STATS_ADD(cb, slow_releases, 1);
+    }
+    free_push(cb, buffer);
+    return 0;
+}
+
+/* releases the rest of a chain, starting at index `idx` */
+static void release_chain(net_buffer_cb_t* cb, uint32_t idx)
+{
+    while (idx != NETBUF_NO_INDEX) {
+        net_buffer_t* buffer = buffer_at(cb, idx);
+        idx = buffer->chain_next;
+
+        buffer->chain_next = NETBUF_NO_INDEX;
+        __atomic_store_n(&buffer->state, NETBUF_STATE_USED, __ATOMIC_RELAXED);
+        (void)release_one(cb, buffer);
+    }
+}
+
+/* drops a reference on a buffer of a NETBUF_F_REFCOUNT pool. the last one
+ * releases the buffer with its chain and drops the reference it held on the
+ * payload owner */
+static int release_ref(net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    if (!is_pool_buffer(cb, buffer) || __atomic_load_n(&buffer->state, __ATOMIC_RELAXED) != NETBUF_STATE_USED) {
+        return -1;
+    }
+
+    if (__atomic_sub_fetch(&buffer->refcount, 1, __ATOMIC_ACQ_REL) > 0) {
+        return 0;
+    }
+
+    const uint32_t owner = buffer->payload_owner;
+    const uint32_t chain = buffer->chain_next;
+
+    const int ret = release_one(cb, buffer);
+    if (ret == 0) {
+        release_chain(cb, chain);
+        if (owner != NETBUF_NO_INDEX) {
+            (void)release_ref(cb, buffer_at(cb, owner));
+        }
+    }
+    return ret;
+}
+
+static int release(net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    /* `buffer` may be stale or foreign, nothing is read from it before it's
+     * known to be a used buffer of the pool */
+    if (!is_pool_buffer(cb, buffer) || (cb->used_map && !used_map_test(cb, buffer_index(cb, buffer)))) {
         return -1;
     }
 
-    const size_t elemSize = (sizeof(net_buffer_t) + bufSize);
-    const size_t totalBufferSize = nElems * elemSize;
+    if (cb->flags & NETBUF_F_REFCOUNT) {
+        return release_ref(cb, buffer);
+    }
 
-    cb->free_list = stack_alloc(nElems);
-    cb->used_list = cbuf_alloc(nElems);
-    cb->buffers = NETBUF_MALLOC(totalBufferSize);
+    /* read before the buffer can be handed out again */
+    const uint32_t chain = __atomic_load_n(&buffer->chain_next, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&buffer->state, __ATOMIC_RELAXED) == NETBUF_STATE_CHAINED) {
+        return -1;
+    }
 
-    // clang-format off
-    if (!cb->buffers)   { goto cleanup; }
-    if (!cb->free_list) { goto cleanup; }
-    if (!cb->used_list) { goto cleanup; }
-    // clang-format on
+    const int ret = release_one(cb, buffer);
+    if (ret == 0 && chain != NETBUF_NO_INDEX) {
+        release_chain(cb, chain);
+    }
+    return ret;
+}
 
-    // Initialize the memory to facilitate debugging
-    memset(cb->buffers, 0xAA, totalBufferSize);
+int NetBufferRelease(net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    if (!cb || !buffer) {
+        return -1;
+    }
 
-    cb->num_buffers = nElems;
-    cb->buffer_capacity = bufSize;
+    PROBE2(release, cb, buffer);
+    const int ret = release(cb, buffer);
+    if (ret == 0) {
+        TRACE(cb, NETBUF_TRACE_RELEASE, buffer, 0);
+    }
+    return ret;
+}
 
-    for (size_t i = 0; i < nElems; ++i) {
-        void* buffer = (uint8_t*)cb->buffers + (i * elemSize);
-        stack_push(cb->free_list, buffer);
+size_t take_bulk(net_buffer_cb_t* cb, net_buffer_t** out, size_t n)
+{
+    if (cb->flags & NETBUF_F_CONCURRENT) {
+        size_t count = 0;
+        while (count < n) {
+            const size_t got = mt_free_pop_bulk(cb, out + count, n - count);
+            if (got == 0) {
+                break;
+            }
+            count += got;
+        }
+        count += lazy_take(cb, out + count, n - count);
+
+        for (size_t i = 0; i < count; ++i) {
+            __atomic_store_n(&out[i]->state, NETBUF_STATE_USED, __ATOMIC_RELAXED);
+            reset_header(cb, out[i]);
+        }
+        __atomic_fetch_add(&cb->mt.used_count, count, __ATOMIC_RELAXED);
+        return count;
     }
 
-    return 0;
-cleanup:
-    (void)NetBufferDeinit(cb);
-    return -1;
+    if (cb->classes) {
+        /* from the class NetBufferRequest picks */
+        size_t c = 0;
+        while (cb->classes[c].buffer_capacity < cb->buffer_capacity) {
+            c++;
+        }
+        struct simple_stack* free_list = cb->classes[c].free_list;
+        const size_t avail = stack_count(free_list);
+        const size_t count = n < avail ? n : avail;
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = stack_pop(free_list);
+            link_used(cb, out[i]);
+        }
+        return count;
+    }
+
+    /* the reserved buffers are out of reach */
+    const size_t want = cb->ifaces.list && n > cb->ifaces.shared_free ? cb->ifaces.shared_free : n;
+    const size_t avail = stack_count(cb->free_list);
+    size_t count = want < avail ? want : avail;
+
+    stack_pop_bulk(cb->free_list, (void**)out, count);
+    count += lazy_take(cb, out + count, want - count);
+    for (size_t i = 0; i < count; ++i) {
+        out[i]->state = NETBUF_STATE_USED;
+        reset_header(cb, out[i]);
+        used_map_set(cb, buffer_index(cb, out[i]));
+    }
+
+    if (cb->flags & NETBUF_F_LINKED_USED_LIST) {
+        for (size_t i = 0; i < count; ++i) {
+            used_link(cb, out[i]);
+        }
+    } else {
+        cbuf_push_back_bulk(cb->used_list, (void* const*)out, count);
+    }
+
+    return count;
 }
 
-int NetBufferDeinit(net_buffer_cb_t* cb)
+void untake_bulk(net_buffer_cb_t* cb, net_buffer_t* const* buffers, size_t n)
 {
-    if (!cb) {
+    if (cb->flags & NETBUF_F_CONCURRENT) {
+        for (size_t i = 0; i < n; ++i) {
+            __atomic_store_n(&buffers[i]->state, NETBUF_STATE_FREE, __ATOMIC_RELAXED);
+        }
+        mt_free_push_bulk(cb, buffers, n);
+        __atomic_fetch_sub(&cb->mt.used_count, n, __ATOMIC_RELAXED);
+        return;
+    }
+
+    /* the newest entries of the used list */
+    if (cb->flags & NETBUF_F_LINKED_USED_LIST) {
+        for (size_t i = n; i-- > 0;) {
+            used_unlink(cb, buffers[i]);
+        }
+    } else {
+        NETBUF_ASSERT(n == 0 || cbuf_peek_back(cb->used_list) == buffers[n - 1]);
+        cbuf_pop_back_bulk(cb->used_list, n);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        buffers[i]->state = NETBUF_STATE_FREE;
+        used_map_clear(cb, buffer_index(cb, buffers[i]));
+    }
+
+    if (cb->classes) {
+        for (size_t i = 0; i < n; ++i) {
+            struct net_buffer_class* cls = &cb->classes[buffers[i]->size_class];
+            cls->stats.used -= 1;
+            stack_push(cls->free_list, buffers[i]);
+        }
+    } else {
+        stack_push_bulk(cb->free_list, (void* const*)buffers, n);
+    }
+}
+
+static size_t request_bulk(net_buffer_cb_t* cb, net_buffer_t** out, size_t n)
+{
+    if (cb->classes) {
+        size_t count = 0;
+        while (count < n && (out[count] = request(cb)) != NULL) {
+            count++;
+        }
+        return count;
+    }
+
+    const size_t count = take_bulk(cb, out, n);
+    stats_request(cb, count, (size_t)NetBufferGetUsedCount(cb));
+    if (count < n) {
+        STATS_ADD(cb, failures, 1);
+    }
+    return count;
+}
+
+int NetBufferRequestBulk(net_buffer_cb_t* cb, net_buffer_t** out, size_t n)
+{
+    if (!cb || !out) {
         return -1;
     }
 
-    // clang-format off
-    if (cb->buffers)   { NETBUF_FREE(cb->buffers),   cb->buffers   = 0; }
-    if (cb->free_list) { NETBUF_FREE(cb->free_list), cb->free_list = 0; }
-    if (cb->used_list) { NETBUF_FREE(cb->used_list), cb->used_list = 0; }
-    // clang-format on
+    const size_t count = request_bulk(cb, out, n);
+#if NETBUF_TRACE
+    for (size_t i = 0; i < count; ++i) {
+        TRACE(cb, NETBUF_TRACE_REQUEST, out[i], 0);
+    }
+    if (count < n) {
+        TRACE(cb, NETBUF_TRACE_FAIL, (net_buffer_t*)NULL, 0);
+    }
+#endif
+    return (int)count;
+}
+
+int NetBufferReleaseBulk(net_buffer_cb_t* cb, net_buffer_t* const* buffers, size_t n)
+{
+    if (!cb || !buffers) {
+        return -1;
+    }
+
+    size_t released = 0;
+
+    /* shared buffers are released one reference at a time below */
+    const int plain = !(cb->flags & NETBUF_F_REFCOUNT);
+
+    if ((cb->flags & NETBUF_F_CONCURRENT) && plain) {
+        /* validate in chunks, then give each chunk back with a single CAS */
+        net_buffer_t* chunk[64];
+        uint32_t chains[64];
+        size_t i = 0;
+        while (i < n) {
+            const uint64_t now = HOLD_NOW(cb);
+            size_t k = 0;
+            for (; i < n && k < sizeof(chunk) / sizeof(chunk[0]); ++i) {
+                net_buffer_t* buffer = buffers[i];
+                if (!buffer || !is_pool_buffer(cb, buffer)) {
+                    continue;
+                }
+                if (!mark_free(buffer)) {
+                    continue;
+                }
+                hold_record(cb, buffer, now);
+                TRACE(cb, NETBUF_TRACE_RELEASE, buffer, 0);
+                chains[k] = buffer->chain_next;
+                chunk[k++] = buffer;
+            }
+
+            __atomic_fetch_sub(&cb->mt.used_count, k, __ATOMIC_RELAXED);
+            mt_free_push_bulk(cb, chunk, k);
+            STATS_RELEASE(cb, k);
+            released += k;
+
+            for (size_t j = 0; j < k; ++j) {
+                release_chain(cb, chains[j]);
+            }
+        }
+        return (int)released;
+    }
+
+    /* buffers of several classes go back to several free lists */
+    if (!(cb->flags & (NETBUF_F_LINKED_USED_LIST | NETBUF_F_CONCURRENT)) && !cb->classes) {
+        /* a run of releases in LRU order is a single head advance. chains are
+         * left to the per-buffer path */
+        size_t run = cbuf_match_front(cb->used_list, (void* const*)buffers, n);
+        for (size_t i = 0; i < run; ++i) {
+            const net_buffer_t* buffer = buffers[i];
+            if (buffer->state != NETBUF_STATE_USED || buffer->chain_next != NETBUF_NO_INDEX
+                || (!plain && (buffer->refcount > 1 || buffer->payload_owner != NETBUF_NO_INDEX))) {
+                run = i;
+                break;
+            }
+        }
+        cbuf_pop_front_bulk(cb->used_list, NULL, run);
+        const uint64_t now = HOLD_NOW(cb);
+        for (size_t i = 0; i < run; ++i) {
+            hold_record(cb, buffers[i], now);
+            TRACE(cb, NETBUF_TRACE_RELEASE, buffers[i], 0);
+            buffers[i]->state = NETBUF_STATE_FREE;
+            used_map_clear(cb, buffer_index(cb, buffers[i]));
+        }
+        stack_push_bulk(cb->free_list, (void* const*)buffers, run);
+        STATS_RELEASE(cb, run);
+        released = run;
+        buffers += run;
+        n -= run;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        if (buffers[i] && release(cb, buffers[i]) == 0) {
+            TRACE(cb, NETBUF_TRACE_RELEASE, buffers[i], 0);
+            released++;
+        }
+    }
+
+    return (int)released;
+}
+
+int NetBufferRetain(net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    if (!cb || !buffer || !(cb->flags & NETBUF_F_REFCOUNT)
+        || __atomic_load_n(&buffer->state, __ATOMIC_RELAXED) != NETBUF_STATE_USED) {
+        return -1;
+    }
+
+    /* nothing could drop the extra reference */
+    if (magazine_held(cb, buffer)) {
+        return -1;
+    }
+
+    __atomic_fetch_add(&buffer->refcount, 1, __ATOMIC_RELAXED);
     return 0;
 }
 
-net_buffer_t* NetBufferRequest(net_buffer_cb_t* cb)
+net_buffer_t* NetBufferClone(net_buffer_cb_t* cb, net_buffer_t* buffer)
 {
-    if (!cb || stack_count(cb->free_list) == 0) {
+    if (!cb || !buffer || !(cb->flags & NETBUF_F_REFCOUNT)
+        || __atomic_load_n(&buffer->state, __ATOMIC_RELAXED) != NETBUF_STATE_USED
+        || buffer->chain_next != NETBUF_NO_INDEX) {
+        return NULL;
+    }
+
+    /* the last release of the payload would have to go back to the magazine */
+    if (magazine_held(cb, buffer)) {
+        return NULL;
+    }
+
+    /* a clone of a clone shares the original payload */
+    const uint32_t owner = buffer->payload_owner != NETBUF_NO_INDEX ? buffer->payload_owner : buffer_index(cb, buffer);
+
+    /* the clone's own payload goes unused, take the smallest slot there is */
+    net_buffer_t* clone = request_sized(cb, 0);
+    TRACE(cb, clone ? NETBUF_TRACE_REQUEST : NETBUF_TRACE_FAIL, clone, 0);
+    if (!clone) {
         return NULL;
     }
 
-    return NetBufferRequestUnchecked(cb);
+    __atomic_fetch_add(&buffer_at(cb, owner)->refcount, 1, __ATOMIC_RELAXED);
+
+    clone->if_type = buffer->if_type;
+    clone->if_id = buffer->if_id;
+    clone->id = buffer->id;
+    clone->if_data = buffer->if_data;
+    clone->user_data_length = buffer->user_data_length;
+    clone->payload_owner = owner;
+    clone->data_offset = buffer->data_offset;
+    if (cb->flags & NETBUF_F_PRIORITY) {
+        (void)NetBufferSetPriority(cb, clone, buffer->priority);
+    }
+
+    return clone;
 }
 
-__attribute__((always_inline)) inline net_buffer_t* NetBufferRequestUnchecked(net_buffer_cb_t* cb)
+uint8_t* NetBufferSharedHead(const net_buffer_cb_t* cb, const net_buffer_t* buffer)
 {
-    void* buffer = stack_pop(cb->free_list);
-    cbuf_push_back(cb->used_list, buffer);
-    return (net_buffer_t*)buffer;
+    return NetBufferHead(cb, buffer_at(cb, buffer->payload_owner));
 }
 
-int NetBufferRelease(net_buffer_cb_t* cb, net_buffer_t* buffer)
+net_buffer_t* NetBufferFromData(const net_buffer_cb_t* cb, const void* p)
 {
-    if (!cb || !buffer) {
-        return -1;
+    if (!cb || !p || !cb->buffers) {
+        return NULL;
     }
 
-    /* check if the buffer is on the front, which should be the case for this
-     * whole stupidity of abstraction to work performantly */
-    if (buffer == cbuf_peek_front(cb->used_list)) {
-        cbuf_pop_front(cb->used_list);
-        stack_push(cb->free_list, buffer);
-        return 0;
-    } else {
-        int ret = cbuf_remove(cb->used_list, buffer);
-        if (ret == 0) {
-            stack_push(cb->free_list, buffer);
+    const uint8_t* q = (const uint8_t*)p;
+
+    if (cb->payload) {
+        if (q < cb->payload || q >= cb->payload + cb->num_buffers * cb->payload_stride) {
+            return NULL;
         }
-        return ret;
+        return buffer_at(cb, (uint32_t)((size_t)(q - cb->payload) / cb->payload_stride));
     }
 
-    return 0;
+    if (cb->classes) {
+        for (size_t i = 0; i < cb->num_classes; ++i) {
+            const struct net_buffer_class* cls = &cb->classes[i];
+            uint8_t* base = (uint8_t*)cls->buffers;
+            if (q >= base && q < base + cls->num_buffers * cls->elem_size) {
+                return (net_buffer_t*)(base + (size_t)(q - base) / cls->elem_size * cls->elem_size);
+            }
+        }
+        return NULL;
+    }
+
+    const uint8_t* base = (const uint8_t*)cb->buffers;
+    if (q < base || q >= base + cb->num_buffers * cb->elem_size) {
+        return NULL;
+    }
+    return buffer_at(cb, (uint32_t)((size_t)(q - base) / cb->elem_size));
+}
+
+size_t NetBufferGetCapacity(const net_buffer_cb_t* cb, const net_buffer_t* buffer)
+{
+    /* a clone has the size class of the payload it shares, but its own window */
+    const net_buffer_t* owner = buffer;
+    if (buffer->payload_owner != NETBUF_NO_INDEX) {
+        owner = buffer_at(cb, buffer->payload_owner);
+    }
+    const size_t capacity = cb->classes ? cb->classes[owner->size_class].buffer_capacity : cb->buffer_capacity;
+    return capacity + cb->headroom - buffer->data_offset;
+}
+
+size_t NetBufferGetDataAlignment(const net_buffer_cb_t* cb)
+{
+    /* the data of buffer i starts at first + i * stride + headroom, so the
+     * lowest bit set in any of them bounds it */
+    uintptr_t bits = cb->headroom;
+    if (cb->payload) {
+        bits |= (uintptr_t)cb->payload | cb->payload_stride;
+    } else if (cb->classes) {
+        for (size_t i = 0; i < cb->num_classes; ++i) {
+            bits |= (uintptr_t)cb->classes[i].buffers->user_data | cb->classes[i].elem_size;
+        }
+    } else {
+        bits |= (uintptr_t)cb->buffers->user_data | cb->elem_size;
+    }
+    return bits & (~bits + 1);
+}
+
+int NetBufferGetClassUsedCount(const net_buffer_cb_t* cb, size_t cls)
+{
+    if (!cb || cls >= cb->num_classes) {
+        return -1;
+    }
+    return (int)cb->classes[cls].stats.used;
 }
 
 int NetBufferWriteChecked(net_buffer_cb_t* cb, net_buffer_t* buffer, const void* data, size_t len)
 {
-    if (len > cb->buffer_capacity) {
+    if (len > NetBufferGetCapacity(cb, buffer)) {
         return -1;
     }
 
-    memcpy(buffer->user_data, data, len);
+    memcpy(NetBufferData(cb, buffer), data, len);
     buffer->user_data_length = len;
+    TRACE(cb, NETBUF_TRACE_WRITE, buffer, len);
 
     return (int)len;
 }
 
+uint8_t* NetBufferPush(const net_buffer_cb_t* cb, net_buffer_t* buffer, size_t len)
+{
+    if (len > buffer->data_offset) {
+        return NULL;
+    }
+
+    buffer->data_offset -= (uint32_t)len;
+    buffer->user_data_length += len;
+    return NetBufferData(cb, buffer);
+}
+
+uint8_t* NetBufferPull(const net_buffer_cb_t* cb, net_buffer_t* buffer, size_t len)
+{
+    if (len > buffer->user_data_length) {
+        return NULL;
+    }
+
+    buffer->data_offset += (uint32_t)len;
+    buffer->user_data_length -= len;
+    return NetBufferData(cb, buffer);
+}
+
+uint8_t* NetBufferPut(const net_buffer_cb_t* cb, net_buffer_t* buffer, size_t len)
+{
+    if (len > NetBufferTailroom(cb, buffer)) {
+        return NULL;
+    }
+
+    uint8_t* tail = NetBufferData(cb, buffer) + buffer->user_data_length;
+    buffer->user_data_length += len;
+    return tail;
+}
+
+void NetBufferTrim(net_buffer_t* buffer, size_t len)
+{
+    if (len < buffer->user_data_length) {
+        buffer->user_data_length = len;
+    }
+}
+
+size_t NetBufferHeadroom(const net_buffer_t* buffer)
+{
+    return buffer->data_offset;
+}
+
+size_t NetBufferTailroom(const net_buffer_cb_t* cb, const net_buffer_t* buffer)
+{
+    return NetBufferGetCapacity(cb, buffer) - buffer->user_data_length;
+}
+
 int NetBufferUpdateCounters(net_buffer_cb_t* self)
 {
-    const uint8_t used = (size_t)cbuf_count(self->used_list) & 0xFF;
+    const size_t used = (size_t)NetBufferGetUsedCount(self);
     if (used > self->stats.high_water)
         self->stats.high_water = used;
     return 0;
 }
 
+#if NETBUF_STATS
+static unsigned stats_next_slot;
+static __thread unsigned stats_thread_slot;
+
+unsigned stats_slot(void)
+{
+    /* 0 means unassigned */
+    if (!stats_thread_slot) {
+        stats_thread_slot = __atomic_add_fetch(&stats_next_slot, 1, __ATOMIC_RELAXED);
+    }
+    return (stats_thread_slot - 1) % NETBUF_STATS_SHARDS;
+}
+#endif
+
+int NetBufferGetStats(const net_buffer_cb_t* cb, net_buffer_stats_t* out)
+{
+    if (!cb || !out) {
+        return -1;
+    }
+
+    memset(out, 0, sizeof(*out));
+
+#if NETBUF_STATS
+    for (size_t i = 0; i < NETBUF_STATS_SHARDS; ++i) {
+        out->releases += __atomic_load_n(&cb->stats.shard[i].releases, __ATOMIC_ACQUIRE);
+    }
+    for (size_t i = 0; i < NETBUF_STATS_SHARDS; ++i) {
+        const struct net_buffer_stats_shard* shard = &cb->stats.shard[i];
+        out->requests += __atomic_load_n(&shard->requests, __ATOMIC_RELAXED);
+        out->failures += __atomic_load_n(&shard->failures, __ATOMIC_RELAXED);
+        out->slow_releases += __atomic_load_n(&shard->slow_releases, __ATOMIC_RELAXED);
+        for (size_t b = 0; b < NETBUF_STATS_BUCKETS; ++b) {
+            out->occupancy[b] += __atomic_load_n(&shard->occupancy[b], __ATOMIC_RELAXED);
+        }
+    }
+#endif
+
+    out->high_water = __atomic_load_n(&cb->stats.high_water, __ATOMIC_RELAXED);
+    return 0;
+}
+
 int NetBufferGetUsedCount(net_buffer_cb_t* self)
 {
-    return cbuf_count(self->used_list);
+    if (self->flags & NETBUF_F_CONCURRENT) {
+        return (int)__atomic_load_n(&self->mt.used_count, __ATOMIC_RELAXED);
+    }
+    if (self->flags & NETBUF_F_LINKED_USED_LIST) {
+        return (int)(self->used_links.count + self->depot.held);
+    }
+    return cbuf_count(self->used_list) + (int)self->depot.held;
+}
+
+/* oldest buffer of the used list, or of lane `lane` in NETBUF_F_PRIORITY
+ * mode. in a partitioned pool lane 0 holds the buffers requested without an
+ * interface, lane i+1 the ones of interface slot i */
+static net_buffer_t* used_front(net_buffer_cb_t* cb, size_t lane)
+{
+    uint32_t idx;
+    if (cb->flags & NETBUF_F_PRIORITY) {
+        idx = cb->prio.lanes[lane].head;
+    } else if (cb->ifaces.list) {
+        idx = lane ? cb->ifaces.list[lane - 1].used_links.head : cb->ifaces.untagged.head;
+    } else if (cb->flags & NETBUF_F_LINKED_USED_LIST) {
+        idx = cb->used_links.head;
+    } else {
+        return cbuf_peek_front(cb->used_list);
+    }
+    return idx == NETBUF_NO_INDEX ? NULL : buffer_at(cb, idx);
 }
 
 net_buffer_t* NetBufferGetLRU(net_buffer_cb_t* self)
 {
+    /* request order is not tracked across threads */
+    if (self->flags & NETBUF_F_CONCURRENT) {
+        return NULL;
+    }
+
+    if (self->flags & NETBUF_F_PRIORITY) {
+        if (!self->prio.mask) {
+            return NULL;
+        }
+        return buffer_at(self, self->prio.lanes[__builtin_ctz(self->prio.mask)].head);
+    }
+
+    if (self->ifaces.list) {
+        for (size_t i = 0; i <= self->ifaces.count; ++i) {
+            net_buffer_t* buffer = used_front(self, i);
+            if (buffer) {
+                return buffer;
+            }
+        }
+        return NULL;
+    }
+
+    if (self->flags & NETBUF_F_LINKED_USED_LIST) {
+        if (self->used_links.head == NETBUF_NO_INDEX) {
+            return NULL;
+        }
+        return buffer_at(self, self->used_links.head);
+    }
     return cbuf_peek_front(self->used_list);
 }
+
+int NetBufferIsUsed(const net_buffer_cb_t* cb, const net_buffer_t* buffer)
+{
+    if (!cb || !buffer || !is_pool_buffer(cb, buffer)) {
+        return 0;
+    }
+
+    const uint32_t idx = buffer_index(cb, buffer);
+    if (cb->flags & NETBUF_F_CONCURRENT) {
+        /* the header of a buffer never handed out isn't written yet */
+        if (idx >= __atomic_load_n(&cb->lazy_next, __ATOMIC_RELAXED)) {
+            return 0;
+        }
+        return __atomic_load_n(&buffer->state, __ATOMIC_RELAXED) != NETBUF_STATE_FREE;
+    }
+    return used_map_test(cb, idx);
+}
+
+int NetBufferForEachUsed(net_buffer_cb_t* cb, net_buffer_visit_fn fn, void* ctx)
+{
+    if (!cb || !fn || !cb->used_map) {
+        return -1;
+    }
+
+    int count = 0;
+    /* no word past the lazy init watermark has a bit set */
+    const size_t words = NETBUF_USED_MAP_SIZE(cb->lazy_next) / sizeof(uint64_t);
+    for (size_t w = 0; w < words; ++w) {
+        /* a copy, `fn` may release the buffer it's given */
+        uint64_t bits = cb->used_map[w];
+        while (bits) {
+            const uint32_t idx = (uint32_t)(w * 64 + (size_t)__builtin_ctzll(bits));
+            bits &= bits - 1;
+
+            count++;
+            if (fn(cb, buffer_at(cb, idx), ctx) != 0) {
+                return count;
+            }
+        }
+    }
+    return count;
+}
+
+uint64_t NetBufferNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+int NetBufferReclaimOlderThan(net_buffer_cb_t* cb, uint64_t age, net_buffer_reclaim_fn fn, void* ctx)
+{
+    if (!cb || !(cb->flags & NETBUF_F_TIMESTAMP) || (cb->flags & NETBUF_F_CONCURRENT)) {
+        return -1;
+    }
+
+    const uint64_t now = NETBUF_TIMESTAMP();
+    const size_t lanes = (cb->flags & NETBUF_F_PRIORITY) ? NETBUF_PRIORITY_LANES : 1 + cb->ifaces.count;
+    int count = 0;
+
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        net_buffer_t* buffer;
+        while ((buffer = used_front(cb, lane)) && now - buffer->timestamp > age) {
+            /* releasing would only drop a reference and leave it in place */
+            if (buffer->state != NETBUF_STATE_USED || buffer->refcount > 1) {
+                break;
+            }
+
+            if (fn) {
+                fn(cb, buffer, ctx);
+            }
+            if (NetBufferRelease(cb, buffer) != 0) {
+                break;
+            }
+            count++;
+        }
+    }
+
+    return count;
+}
+
+int NetBufferSetPriority(net_buffer_cb_t* cb, net_buffer_t* buffer, uint8_t prio)
+{
+    if (!cb || !buffer || !(cb->flags & NETBUF_F_PRIORITY) || prio >= NETBUF_PRIORITY_LANES) {
+        return -1;
+    }
+
+    if (!NetBufferIsUsed(cb, buffer)) {
+        return -1;
+    }
+
+    used_unlink(cb, buffer);
+    buffer->priority = prio;
+    used_link(cb, buffer);
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "netbuf.h"
+#include "netbuf_internal.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define ROUND_UP(x, align) (((x) + (align) - 1) & ~((size_t)(align) - 1))
+
+/* tries a MAP_HUGETLB mapping, which needs huge pages to be reserved */
+static void* map_hugetlb(size_t size, int populate)
+{
+#ifdef MAP_HUGETLB
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populate, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+#else
+    (void)size;
+    (void)populate;
+    return NULL;
+#endif
+}
+
+void* arena_map(net_buffer_cb_t* cb, size_t size)
+{
+    int populate = 0;
+#ifdef MAP_POPULATE
+    if (cb->flags & NETBUF_F_POPULATE) {
+        populate = MAP_POPULATE;
+    }
+#endif
+
+    void* p = NULL;
+    if (cb->flags & NETBUF_F_HUGEPAGES) {
+        size = ROUND_UP(size, NETBUF_HUGEPAGE_SIZE);
+        p = map_hugetlb(size, populate);
+        cb->arena.hugetlb = p != NULL;
+    }
+
+    if (!p) {
+        /* transparent huge pages are only used if the advice comes before
+         * the pages are faulted in, so then populate by hand afterwards */
+        const int thp = (cb->flags & NETBUF_F_HUGEPAGES) != 0;
+
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | (thp ? 0 : populate), -1, 0);
+        if (p == MAP_FAILED) {
+            return NULL;
+        }
+
+        if (thp) {
+#ifdef MADV_HUGEPAGE
+            /* only a hint, the pool works the same without it */
+            (void)madvise(p, size, MADV_HUGEPAGE);
+#endif
+            if (populate) {
+                const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+                for (size_t off = 0; off < size; off += page) {
+                    ((volatile uint8_t*)p)[off] = 0;
+                }
+            }
+        }
+    }
+
+    if ((cb->flags & NETBUF_F_MLOCK) && mlock(p, size) != 0) {
+        munmap(p, size);
+        cb->arena.hugetlb = 0;
+        return NULL;
+    }
+
+    cb->arena.size = size;
+    return p;
+}
+
+void arena_unmap(net_buffer_cb_t* cb)
+{
+    if (cb->flags & NETBUF_F_MLOCK) {
+        (void)munlock(cb->slab, cb->arena.size);
+    }
+    munmap(cb->slab, cb->arena.size);
+    cb->slab = NULL;
+    cb->arena.size = 0;
+    cb->arena.hugetlb = 0;
+}
@@ -0,0 +1,127 @@
+#include "netbuf.h"
+#include "netbuf_internal.h"
+
+#include <string.h>
+#include <sys/uio.h>
+
+net_buffer_t* NetBufferChainNext(const net_buffer_cb_t* cb, const net_buffer_t* buffer)
+{
+    if (!cb || !buffer || buffer->chain_next == NETBUF_NO_INDEX) {
+        return NULL;
+    }
+    return buffer_at(cb, buffer->chain_next);
+}
+
+/* gives the chain hanging from `head` back to the pool */
+static void drop_tail(net_buffer_cb_t* cb, net_buffer_t* head)
+{
+    net_buffer_t* buffer = NetBufferChainNext(cb, head);
+    head->chain_next = NETBUF_NO_INDEX;
+
+    while (buffer) {
+        net_buffer_t* next = NetBufferChainNext(cb, buffer);
+        buffer->chain_next = NETBUF_NO_INDEX;
+        buffer->state = NETBUF_STATE_USED;
+        NetBufferRelease(cb, buffer);
+        buffer = next;
+    }
+}
+
+int NetBufferWriteChain(net_buffer_cb_t* cb, net_buffer_t* head, const void* data, size_t len)
+{
+    if (!cb || !head || head->state != NETBUF_STATE_USED) {
+        return -1;
+    }
+
+    /* other holders of the payload would see it change */
+    if (head->refcount > 1 || head->payload_owner != NETBUF_NO_INDEX) {
+        return -1;
+    }
+
+    /* neither release would take the chain back */
+    if (len > NetBufferGetCapacity(cb, head) && magazine_held(cb, head)) {
+        return -1;
+    }
+
+    drop_tail(cb, head);
+
+    const uint8_t* src = data;
+    size_t remaining = len;
+    net_buffer_t* buffer = head;
+
+    for (;;) {
+        const size_t capacity = NetBufferGetCapacity(cb, buffer);
+        const size_t chunk = remaining < capacity ? remaining : capacity;
+
+        memcpy(NetBufferData(cb, buffer), src, chunk);
+        buffer->user_data_length = chunk;
+        src += chunk;
+        remaining -= chunk;
+
+        if (remaining == 0) {
+            break;
+        }
+
+        net_buffer_t* next = NetBufferRequest(cb);
+        if (!next) {
+            drop_tail(cb, head);
+            return -1;
+        }
+
+        next->state = NETBUF_STATE_CHAINED;
+        next->if_type = head->if_type;
+        next->if_id = head->if_id;
+        next->id = head->id;
+        buffer->chain_next = buffer_index(cb, next);
+        buffer = next;
+    }
+
+    return (int)len;
+}
+
+size_t NetBufferChainLength(const net_buffer_cb_t* cb, const net_buffer_t* head)
+{
+    size_t len = 0;
+    for (const net_buffer_t* buffer = head; buffer; buffer = NetBufferChainNext(cb, buffer)) {
+        len += buffer->user_data_length;
+    }
+    return len;
+}
+
+size_t NetBufferReadChain(net_buffer_cb_t* cb, net_buffer_t* head, size_t offset, void* out, size_t len)
+{
+    uint8_t* dst = out;
+    size_t copied = 0;
+
+    for (net_buffer_t* buffer = head; buffer && copied < len; buffer = NetBufferChainNext(cb, buffer)) {
+        if (offset >= buffer->user_data_length) {
+            offset -= buffer->user_data_length;
+            continue;
+        }
+
+        size_t chunk = buffer->user_data_length - offset;
+        if (chunk > len - copied) {
+            chunk = len - copied;
+        }
+
+        memcpy(dst + copied, NetBufferData(cb, buffer) + offset, chunk);
+        copied += chunk;
+        offset = 0;
+    }
+
+    return copied;
+}
+
+int NetBufferChainToIovec(net_buffer_cb_t* cb, net_buffer_t* head, struct iovec* iov, size_t iovcnt)
+{
+    size_t count = 0;
+    for (net_buffer_t* buffer = head; buffer; buffer = NetBufferChainNext(cb, buffer)) {
+        if (count == iovcnt) {
+            return -1;
+        }
+        iov[count].iov_base = NetBufferData(cb, buffer);
+        iov[count].iov_len = buffer->user_data_length;
+        count++;
+    }
+    return (int)count;
+}
@@ -0,0 +1,123 @@
+#include "netbuf.h"
+#include "netbuf_internal.h"
+
+/* interface key of a histogram slot, never 0 */
+static uint32_t iface_key(int8_t if_type, int8_t if_id)
+{
+    return (1u << 16) | ((uint32_t)(uint8_t)if_type << 8) | (uint8_t)if_id;
+}
+
+/* slot of an interface, claiming a free one if `claim` is set */
+static net_buffer_hist_t* find_iface(struct net_buffer_hold* hold, uint32_t key, int claim)
+{
+    for (size_t i = 0; i < NETBUF_HOLD_IFACES; ++i) {
+        uint32_t cur = __atomic_load_n(&hold->key[i], __ATOMIC_ACQUIRE);
+        if (cur == 0 && claim) {
+            /* another thread may claim it first, for this key or another */
+            if (__atomic_compare_exchange_n(&hold->key[i], &cur, key, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return &hold->iface[i];
+            }
+        }
+        if (cur == key) {
+            return &hold->iface[i];
+        }
+        if (cur == 0) {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+#if NETBUF_HOLD_HIST
+net_buffer_hist_t* hold_iface(net_buffer_cb_t* cb, const net_buffer_t* buffer)
+{
+    return find_iface(cb->hold, iface_key(buffer->if_type, buffer->if_id), 1);
+}
+#endif
+
+const net_buffer_hist_t* NetBufferGetHoldHist(const net_buffer_cb_t* cb)
+{
+    if (!cb || !cb->hold) {
+        return NULL;
+    }
+    return &cb->hold->all;
+}
+
+const net_buffer_hist_t* NetBufferGetIfHoldHist(const net_buffer_cb_t* cb, int8_t if_type, int8_t if_id)
+{
+    if (!cb || !cb->hold) {
+        return NULL;
+    }
+    return find_iface(cb->hold, iface_key(if_type, if_id), 0);
+}
+
+void NetBufferResetHoldHist(net_buffer_cb_t* cb)
+{
+    if (!cb || !cb->hold) {
+        return;
+    }
+
+    for (size_t b = 0; b < NETBUF_HIST_BUCKETS; ++b) {
+        __atomic_store_n(&cb->hold->all.count[b], 0, __ATOMIC_RELAXED);
+    }
+    for (size_t i = 0; i < NETBUF_HOLD_IFACES; ++i) {
+        __atomic_store_n(&cb->hold->key[i], 0, __ATOMIC_RELAXED);
+        for (size_t b = 0; b < NETBUF_HIST_BUCKETS; ++b) {
+            __atomic_store_n(&cb->hold->iface[i].count[b], 0, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+uint64_t NetBufferHistCount(const net_buffer_hist_t* hist)
+{
+    if (!hist) {
+        return 0;
+    }
+
+    uint64_t total = 0;
+    for (size_t b = 0; b < NETBUF_HIST_BUCKETS; ++b) {
+        total += __atomic_load_n(&hist->count[b], __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+/* largest value that lands in bucket `b` */
+static uint64_t bucket_max(size_t b)
+{
+    if (b < (1u << NETBUF_HIST_SUB_BITS)) {
+        return b;
+    }
+    const unsigned shift = (unsigned)(b >> NETBUF_HIST_SUB_BITS) - 1;
+    const uint64_t sub = (b & ((1u << NETBUF_HIST_SUB_BITS) - 1)) | (1u << NETBUF_HIST_SUB_BITS);
+    return ((sub + 1) << shift) - 1;
+}
+
+uint64_t NetBufferHistPercentile(const net_buffer_hist_t* hist, double q)
+{
+    if (!hist) {
+        return 0;
+    }
+
+    const uint64_t total = NetBufferHistCount(hist);
+    if (total == 0) {
+        return 0;
+    }
+
+    /* rank of the quantile, 1-based */
+    uint64_t rank = (uint64_t)(q * (double)total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    if (rank > total) {
+        rank = total;
+    }
+
+    uint64_t seen = 0;
+    for (size_t b = 0; b < NETBUF_HIST_BUCKETS; ++b) {
+        seen += __atomic_load_n(&hist->count[b], __ATOMIC_RELAXED);
+        if (seen >= rank) {
+            return bucket_max(b);
+        }
+    }
+    return bucket_max(NETBUF_HIST_BUCKETS - 1);
+}
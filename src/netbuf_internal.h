@@ -0,0 +1,391 @@
+#ifndef NETBUF_INTERNAL_H_
+#define NETBUF_INTERNAL_H_
+
+/* helpers shared by the pool implementation files, not part of the API */
+
+#include "netbuf.h"
+
+static inline net_buffer_t* buffer_at(const net_buffer_cb_t* cb, uint32_t idx)
+{
+    if (cb->classes) {
+        const struct net_buffer_class* cls = cb->classes;
+        while (idx >= cls->first_index + cls->num_buffers) {
+            cls++;
+        }
+        return (net_buffer_t*)((uint8_t*)cls->buffers + (size_t)(idx - cls->first_index) * cls->elem_size);
+    }
+
+    return (net_buffer_t*)((uint8_t*)cb->buffers + (size_t)idx * cb->elem_size);
+}
+
+static inline uint32_t buffer_index(const net_buffer_cb_t* cb, const net_buffer_t* buffer)
+{
+    if (cb->classes) {
+        const struct net_buffer_class* cls = &cb->classes[buffer->size_class];
+        const size_t offset = (size_t)((const uint8_t*)buffer - (const uint8_t*)cls->buffers);
+        return cls->first_index + (uint32_t)(offset / cls->elem_size);
+    }
+
+    return (uint32_t)((size_t)((const uint8_t*)buffer - (const uint8_t*)cb->buffers) / cb->elem_size);
+}
+
+/* checks that `buffer` points at the start of one of the pool buffers,
+ * without reading it */
+static inline int is_pool_buffer(const net_buffer_cb_t* cb, const net_buffer_t* buffer)
+{
+    const uint8_t* p = (const uint8_t*)buffer;
+
+    if (cb->classes) {
+        for (size_t i = 0; i < cb->num_classes; ++i) {
+            const struct net_buffer_class* cls = &cb->classes[i];
+            const uint8_t* base = (const uint8_t*)cls->buffers;
+            if (p >= base && p < base + cls->num_buffers * cls->elem_size) {
+                return (size_t)(p - base) % cls->elem_size == 0;
+            }
+        }
+        return 0;
+    }
+
+    const uint8_t* base = (const uint8_t*)cb->buffers;
+
+    if (p < base || p >= base + cb->num_buffers * cb->elem_size) {
+        return 0;
+    }
+    return (size_t)(p - base) % cb->elem_size == 0;
+}
+
+/* the bitmap of used buffers, by buffer index. it answers whether a pointer
+ * is in the used list without searching the list. in NETBUF_F_LAZY_INIT mode
+ * the words past the buffers handed out so far aren't cleared yet */
+static inline int used_map_test(const net_buffer_cb_t* cb, uint32_t idx)
+{
+    if (idx >= cb->lazy_next) {
+        return 0;
+    }
+    return (int)((cb->used_map[idx / 64] >> (idx % 64)) & 1);
+}
+
+static inline void used_map_set(net_buffer_cb_t* cb, uint32_t idx)
+{
+    cb->used_map[idx / 64] |= (uint64_t)1 << (idx % 64);
+}
+
+static inline void used_map_clear(net_buffer_cb_t* cb, uint32_t idx)
+{
+    cb->used_map[idx / 64] &= ~((uint64_t)1 << (idx % 64));
+}
+
+/* a used buffer of a plain pool that is not in the used list came out of a
+ * magazine, which NetBufferRelease doesn't take back */
+static inline int magazine_held(const net_buffer_cb_t* cb, const net_buffer_t* buffer)
+{
+    return cb->used_map && !used_map_test(cb, buffer_index(cb, buffer));
+}
+
+/* lock-free free list (NETBUF_F_CONCURRENT). a Treiber stack threaded through
+ * `next`, with a tag next to the top index so a pop that raced with a
+ * pop/push of the same buffer fails its CAS instead of corrupting the list */
+#define MT_TAG_ONE ((uint64_t)1 << 32)
+
+static inline net_buffer_t* mt_free_pop(net_buffer_cb_t* cb)
+{
+    uint64_t head = __atomic_load_n(&cb->mt.free_head, __ATOMIC_ACQUIRE);
+    uint64_t new_head;
+    net_buffer_t* buffer;
+
+    do {
+        const uint32_t idx = (uint32_t)head;
+        if (idx == NETBUF_NO_INDEX) {
+            return NULL;
+        }
+
+        /* `next` may be rewritten concurrently if the buffer was popped in the
+         * meantime, but then the tag has changed and the CAS below fails */
+        buffer = buffer_at(cb, idx);
+        const uint32_t next = __atomic_load_n(&buffer->next, __ATOMIC_RELAXED);
+        new_head = ((head & ~(uint64_t)UINT32_MAX) + MT_TAG_ONE) | next;
+    } while (!__atomic_compare_exchange_n(&cb->mt.free_head, &head, new_head, 1,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    return buffer;
+}
+
+static inline void mt_free_push(net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    const uint32_t idx = buffer_index(cb, buffer);
+    uint64_t head = __atomic_load_n(&cb->mt.free_head, __ATOMIC_RELAXED);
+    uint64_t new_head;
+
+    do {
+        __atomic_store_n(&buffer->next, (uint32_t)head, __ATOMIC_RELAXED);
+        new_head = ((head & ~(uint64_t)UINT32_MAX) + MT_TAG_ONE) | idx;
+    } while (!__atomic_compare_exchange_n(&cb->mt.free_head, &head, new_head, 1,
+        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* pops up to `n` buffers with a single CAS, returns how many were taken */
+static inline size_t mt_free_pop_bulk(net_buffer_cb_t* cb, net_buffer_t** out, size_t n)
+{
+    uint64_t head = __atomic_load_n(&cb->mt.free_head, __ATOMIC_ACQUIRE);
+    uint64_t new_head;
+    size_t count;
+
+    do {
+        uint32_t idx = (uint32_t)head;
+        count = 0;
+
+        /* same reasoning as mt_free_pop: if any link read here is stale, the
+         * tag has moved on and the CAS fails. an out of range index can only
+         * come from such a stale read, so stop walking */
+        while (count < n && idx < cb->num_buffers) {
+            net_buffer_t* buffer = buffer_at(cb, idx);
+            out[count++] = buffer;
+            idx = __atomic_load_n(&buffer->next, __ATOMIC_RELAXED);
+        }
+
+        if (count == 0) {
+            return 0;
+        }
+        new_head = ((head & ~(uint64_t)UINT32_MAX) + MT_TAG_ONE) | idx;
+    } while (!__atomic_compare_exchange_n(&cb->mt.free_head, &head, new_head, 1,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    return count;
+}
+
+/* links `n` buffers into a chain and pushes it with a single CAS */
+static inline void mt_free_push_bulk(net_buffer_cb_t* cb, net_buffer_t* const* buffers, size_t n)
+{
+    if (n == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i + 1 < n; ++i) {
+        __atomic_store_n(&buffers[i]->next, buffer_index(cb, buffers[i + 1]), __ATOMIC_RELAXED);
+    }
+
+    const uint32_t first = buffer_index(cb, buffers[0]);
+    net_buffer_t* last = buffers[n - 1];
+    uint64_t head = __atomic_load_n(&cb->mt.free_head, __ATOMIC_RELAXED);
+    uint64_t new_head;
+
+    do {
+        __atomic_store_n(&last->next, (uint32_t)head, __ATOMIC_RELAXED);
+        new_head = ((head & ~(uint64_t)UINT32_MAX) + MT_TAG_ONE) | first;
+    } while (!__atomic_compare_exchange_n(&cb->mt.free_head, &head, new_head, 1,
+        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* hands out up to `n` buffers that were never used, with their headers set
+ * up as free buffers. returns how many were stored in `out`. always 0 unless
+ * the pool is in NETBUF_F_LAZY_INIT mode. thread-safe */
+size_t lazy_take(net_buffer_cb_t* cb, net_buffer_t** out, size_t n);
+
+/* requests up to `n` buffers into `out` like NetBufferRequestBulk, without
+ * counting or tracing them. untake_bulk gives back the last `n` of them, as
+ * long as nothing else was requested in between */
+size_t take_bulk(net_buffer_cb_t* cb, net_buffer_t** out, size_t n);
+void untake_bulk(net_buffer_cb_t* cb, net_buffer_t* const* buffers, size_t n);
+
+/* number of buffers lazy_take can still hand out */
+static inline size_t lazy_remaining(const net_buffer_cb_t* cb)
+{
+    return cb->num_buffers - __atomic_load_n(&cb->lazy_next, __ATOMIC_RELAXED);
+}
+
+/* resets the per-use header fields of a buffer that was just requested */
+static inline void reset_header(const net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    buffer->data_offset = (uint32_t)cb->headroom;
+    buffer->user_data_length = 0;
+    __atomic_store_n(&buffer->chain_next, NETBUF_NO_INDEX, __ATOMIC_RELAXED);
+    __atomic_store_n(&buffer->refcount, 1, __ATOMIC_RELAXED);
+    buffer->payload_owner = NETBUF_NO_INDEX;
+    buffer->priority = NETBUF_PRIORITY_LANES - 1;
+    if (cb->flags & NETBUF_F_TIMESTAMP) {
+        buffer->timestamp = NETBUF_TIMESTAMP();
+    }
+}
+
+/* moves a used buffer to the free state. fails if it's already free, or
+ * owned by a chain, or if another thread won a race to release it */
+static inline int mark_free(net_buffer_t* buffer)
+{
+    uint8_t expected = NETBUF_STATE_USED;
+    return __atomic_compare_exchange_n(&buffer->state, &expected, NETBUF_STATE_FREE, 0,
+        __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+/* the depot lends free buffers to something outside the pool (magazines,
+ * io_uring), counting them as used while they're out. see netbuf_magazine.c */
+
+/* moves up to `n` free buffers from the pool into `out` */
+size_t depot_take(net_buffer_cb_t* cb, net_buffer_t** out, size_t n);
+
+/* gives `n` free buffers back to the pool */
+void depot_put(net_buffer_cb_t* cb, net_buffer_t* const* buffers, size_t n);
+
+/* enters a buffer taken with depot_take in the used list, as if it had been
+ * requested. not thread-safe on a plain pool */
+void depot_claim(net_buffer_cb_t* cb, net_buffer_t* buffer);
+
+/* inline counters, compiled out unless NETBUF_STATS. see NetBufferGetStats */
+#if NETBUF_STATS
+/* set of counters of the calling thread */
+unsigned stats_slot(void);
+
+#define STATS_ADD(cb, field, n) \
+    __atomic_fetch_add(&(cb)->stats.shard[stats_slot()].field, (n), __ATOMIC_RELAXED)
+
+/* releases are published so a snapshot that sees them also sees the requests */
+#define STATS_RELEASE(cb, n) \
+    __atomic_fetch_add(&(cb)->stats.shard[stats_slot()].releases, (n), __ATOMIC_RELEASE)
+
+/* counts `n` buffers handed out, `used` being the used count they left */
+static inline void stats_request(net_buffer_cb_t* cb, size_t n, size_t used)
+{
+    struct net_buffer_stats_shard* shard = &cb->stats.shard[stats_slot()];
+    const size_t bucket = used ? (used - 1) * NETBUF_STATS_BUCKETS / cb->num_buffers : 0;
+
+    __atomic_fetch_add(&shard->requests, n, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shard->occupancy[bucket < NETBUF_STATS_BUCKETS ? bucket : NETBUF_STATS_BUCKETS - 1], n,
+        __ATOMIC_RELAXED);
+
+    size_t high = __atomic_load_n(&cb->stats.high_water, __ATOMIC_RELAXED);
+    while (used > high
+        && !__atomic_compare_exchange_n(&cb->stats.high_water, &high, used, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { }
+}
+#else
+#define STATS_ADD(cb, field, n) ((void)0)
+#define STATS_RELEASE(cb, n) ((void)0)
+#define stats_request(cb, n, used) ((void)sizeof(used))
+#endif
+
+/* hold time histograms, compiled out unless NETBUF_HOLD_HIST. see netbuf_hist.c */
+static inline size_t hist_bucket(uint64_t v)
+{
+    if (v < (1u << NETBUF_HIST_SUB_BITS)) {
+        return (size_t)v;
+    }
+    const unsigned msb = 63 - (unsigned)__builtin_clzll(v);
+    const unsigned shift = msb - NETBUF_HIST_SUB_BITS;
+    return ((size_t)(shift + 1) << NETBUF_HIST_SUB_BITS) | (size_t)((v >> shift) & ((1u << NETBUF_HIST_SUB_BITS) - 1));
+}
+
+#if NETBUF_HOLD_HIST
+/* histogram slot of the buffer's interface, NULL if they're all taken */
+net_buffer_hist_t* hold_iface(net_buffer_cb_t* cb, const net_buffer_t* buffer);
+
+/* records the hold time of a buffer that is being released */
+static inline void hold_record(net_buffer_cb_t* cb, const net_buffer_t* buffer, uint64_t now)
+{
+    if (!cb->hold) {
+        return;
+    }
+
+    const size_t bucket = hist_bucket(now - buffer->timestamp);
+    net_buffer_hist_t* iface = hold_iface(cb, buffer);
+
+    if (cb->flags & NETBUF_F_CONCURRENT) {
+        __atomic_fetch_add(&cb->hold->all.count[bucket], 1, __ATOMIC_RELAXED);
+        if (iface) {
+            __atomic_fetch_add(&iface->count[bucket], 1, __ATOMIC_RELAXED);
+        }
+        return;
+    }
+
+    cb->hold->all.count[bucket]++;
+    if (iface) {
+        iface->count[bucket]++;
+    }
+}
+
+/* clock reading for hold_record, 0 if nothing is recorded */
+#define HOLD_NOW(cb) ((cb)->hold ? NETBUF_TIMESTAMP() : 0)
+#else
+#define hold_record(cb, buffer, now) ((void)sizeof(now))
+#define HOLD_NOW(cb) 0
+#endif
+
+/* event trace, compiled out unless NETBUF_TRACE. see netbuf_trace.c */
+#if NETBUF_TRACE
+struct trace_ring {
+    struct trace_ring* next; /* every ring ever attached */
+    uint8_t owned; /* a live thread writes to it */
+    uint32_t tid;
+    uint64_t head; /* events ever written, only moved by the owner */
+    net_buffer_trace_entry_t entries[NETBUF_TRACE_ENTRIES];
+};
+
+extern __thread struct trace_ring* trace_self;
+
+/* ring of the calling thread, NULL if it couldn't get one */
+struct trace_ring* trace_attach(void);
+
+static inline void trace_record(const net_buffer_cb_t* cb, uint32_t event, uint32_t index, size_t len, void* caller)
+{
+    struct trace_ring* ring = trace_self ? trace_self : trace_attach();
+    if (!ring) {
+        return;
+    }
+
+    /* NetBufferTraceReset may move the head from another thread */
+    const uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    net_buffer_trace_entry_t* e = &ring->entries[head & (NETBUF_TRACE_ENTRIES - 1)];
+    e->timestamp = NETBUF_TIMESTAMP();
+    e->caller = (uint64_t)(uintptr_t)caller;
+    e->pool = (uint64_t)(uintptr_t)cb;
+    e->index = index;
+    e->tid = ring->tid;
+    e->event = event;
+    e->len = (uint32_t)len;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* logs an event on `buffer` (NULL for a failed request) with the caller of
+ * the function it is used in. only use it in the functions of the API, an
+ * inlined helper would log its own caller */
+#define TRACE(cb, event, buffer, len)                                                              \
+    trace_record((cb), (event), (buffer) ? buffer_index((cb), (buffer)) : NETBUF_NO_INDEX, (len), \
+        __builtin_return_address(0))
+#else
+#define TRACE(cb, event, buffer, len) ((void)0)
+#endif
+
+/* USDT probes for perf/bpftrace, built in wherever <sys/sdt.h> is available.
+ * a probe is a nop until something attaches to it. NETBUF_USDT=0 leaves them
+ * out */
+#if !defined(NETBUF_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define NETBUF_USDT 1
+#endif
+#endif
+
+#if NETBUF_USDT
+#include <sys/sdt.h>
+#define PROBE2(name, a, b) STAP_PROBE2(netbuf, name, a, b)
+#else
+#define PROBE2(name, a, b) ((void)0)
+#endif
+
+/* flags that put the slab in an mmap arena, see netbuf_arena.c */
+#define NETBUF_F_ARENA (NETBUF_F_MMAP | NETBUF_F_HUGEPAGES | NETBUF_F_POPULATE | NETBUF_F_MLOCK)
+
+/* maps a slab of `size` bytes as requested by the pool flags, NULL on failure */
+void* arena_map(net_buffer_cb_t* cb, size_t size);
+void arena_unmap(net_buffer_cb_t* cb);
+
+/* spin lock for the rare paths that need to serialize on a plain pool */
+static inline void netbuf_lock(uint8_t* lock)
+{
+    while (__atomic_test_and_set(lock, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(lock, __ATOMIC_RELAXED)) { }
+    }
+}
+
+static inline void netbuf_unlock(uint8_t* lock)
+{
+    __atomic_clear(lock, __ATOMIC_RELEASE);
+}
+
+#endif /* NETBUF_INTERNAL_H_ */
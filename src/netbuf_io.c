@@ -0,0 +1,100 @@
+#define _GNU_SOURCE
+#include "netbuf.h"
+#include "netbuf_internal.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+int NetBufferRecvBatch(net_buffer_cb_t* cb, int fd, net_buffer_t** out, size_t n, int flags)
+{
+    if (!cb || !out) {
+        return -1;
+    }
+
+    if (n > NETBUF_IO_BATCH) {
+        n = NETBUF_IO_BATCH;
+    }
+
+    /* counted once we know how many were filled */
+    const int requested = (int)take_bulk(cb, out, n);
+    if (requested < (int)n) {
+        STATS_ADD(cb, failures, 1);
+        TRACE(cb, NETBUF_TRACE_FAIL, (net_buffer_t*)NULL, 0);
+    }
+    if (requested == 0) {
+        return 0;
+    }
+
+    struct mmsghdr msgs[NETBUF_IO_BATCH];
+    struct iovec iov[NETBUF_IO_BATCH];
+    memset(msgs, 0, (size_t)requested * sizeof(msgs[0]));
+
+    for (int i = 0; i < requested; ++i) {
+        iov[i].iov_base = NetBufferData(cb, out[i]);
+        iov[i].iov_len = NetBufferGetCapacity(cb, out[i]);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    const int received = recvmmsg(fd, msgs, (unsigned int)requested, flags, NULL);
+    if (received < 0) {
+        const int err = errno;
+        untake_bulk(cb, out, (size_t)requested);
+        errno = err;
+        return -1;
+    }
+
+    for (int i = 0; i < received; ++i) {
+        /* the rest of a truncated datagram is lost, as with recv */
+        out[i]->user_data_length = msgs[i].msg_len;
+    }
+
+    /* still the newest of the used list, they come off its tail */
+    untake_bulk(cb, out + received, (size_t)(requested - received));
+
+    stats_request(cb, (size_t)received, (size_t)NetBufferGetUsedCount(cb));
+#if NETBUF_TRACE
+    for (int i = 0; i < received; ++i) {
+        TRACE(cb, NETBUF_TRACE_REQUEST, out[i], 0);
+    }
+#endif
+    return received;
+}
+
+int NetBufferSendBatch(net_buffer_cb_t* cb, int fd, net_buffer_t* const* buffers, size_t n, int flags)
+{
+    if (!cb || !buffers) {
+        return -1;
+    }
+
+    if (n == 0) {
+        return 0;
+    }
+    if (n > NETBUF_IO_BATCH) {
+        n = NETBUF_IO_BATCH;
+    }
+
+    struct mmsghdr msgs[NETBUF_IO_BATCH];
+    struct iovec iov[NETBUF_IO_BATCH][NETBUF_IO_MAX_IOV];
+    memset(msgs, 0, n * sizeof(msgs[0]));
+
+    for (size_t i = 0; i < n; ++i) {
+        /* a chain goes out as a single datagram, gathered from its buffers */
+        const int iovcnt = NetBufferChainToIovec(cb, buffers[i], iov[i], NETBUF_IO_MAX_IOV);
+        if (iovcnt < 0) {
+            if (i == 0) {
+                errno = EMSGSIZE;
+                return -1;
+            }
+            /* send what comes before it */
+            n = i;
+            break;
+        }
+        msgs[i].msg_hdr.msg_iov = iov[i];
+        msgs[i].msg_hdr.msg_iovlen = (size_t)iovcnt;
+    }
+
+    return sendmmsg(fd, msgs, (unsigned int)n, flags);
+}
@@ -0,0 +1,156 @@
+#include "netbuf.h"
+#include "netbuf_internal.h"
+#include "simple_stack.h"
+
+size_t depot_take(net_buffer_cb_t* cb, net_buffer_t** out, size_t n)
+{
+    if (cb->flags & NETBUF_F_CONCURRENT) {
+        size_t count = mt_free_pop_bulk(cb, out, n);
+        count += lazy_take(cb, out + count, n - count);
+        __atomic_fetch_add(&cb->mt.used_count, count, __ATOMIC_RELAXED);
+        return count;
+    }
+
+    netbuf_lock(&cb->depot.lock);
+
+    const size_t avail = stack_count(cb->free_list);
+    size_t count = n < avail ? n : avail;
+    stack_pop_bulk(cb->free_list, (void**)out, count);
+    count += lazy_take(cb, out + count, n - count);
+    cb->depot.held += count;
+
+    netbuf_unlock(&cb->depot.lock);
+    return count;
+}
+
+void depot_put(net_buffer_cb_t* cb, net_buffer_t* const* buffers, size_t n)
+{
+    if (cb->flags & NETBUF_F_CONCURRENT) {
+        mt_free_push_bulk(cb, buffers, n);
+        __atomic_fetch_sub(&cb->mt.used_count, n, __ATOMIC_RELAXED);
+        return;
+    }
+
+    netbuf_lock(&cb->depot.lock);
+
+    stack_push_bulk(cb->free_list, (void* const*)buffers, n);
+    cb->depot.held -= n;
+
+    netbuf_unlock(&cb->depot.lock);
+}
+
+int NetBufferMagazineInit(net_buffer_magazine_t* mag, net_buffer_cb_t* pool, const net_buffer_magazine_config_t* cfg)
+{
+    if (!mag || !pool || !cfg || !cfg->size) {
+        return -1;
+    }
+
+    /* a magazine caches buffers of a single size, and would bypass the
+     * reservations of a partitioned pool */
+    if (pool->classes || pool->ifaces.list) {
+        return -1;
+    }
+
+    memset(mag, 0, sizeof(*mag));
+    mag->pool = pool;
+    mag->cfg = *cfg;
+
+    // clang-format off
+    if (!mag->cfg.refill)     { mag->cfg.refill     = (cfg->size + 1) / 2; }
+    if (!mag->cfg.flush_high) { mag->cfg.flush_high = cfg->size; }
+    if (!mag->cfg.flush_low)  { mag->cfg.flush_low  = cfg->size / 2; }
+    // clang-format on
+
+    if (mag->cfg.refill > mag->cfg.size || mag->cfg.flush_high > mag->cfg.size
+        || mag->cfg.flush_low >= mag->cfg.flush_high) {
+        return -1;
+    }
+
+    mag->entry = NETBUF_MALLOC(mag->cfg.size * sizeof(net_buffer_t*));
+    if (!mag->entry) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int NetBufferMagazineDeinit(net_buffer_magazine_t* mag)
+{
+    if (!mag || !mag->entry) {
+        return -1;
+    }
+
+    (void)NetBufferMagazineFlush(mag);
+    NETBUF_FREE(mag->entry);
+    mag->entry = NULL;
+    return 0;
+}
+
+int NetBufferMagazineFlush(net_buffer_magazine_t* mag)
+{
+    if (!mag) {
+        return -1;
+    }
+
+    depot_put(mag->pool, mag->entry, mag->count);
+    mag->count = 0;
+    return 0;
+}
+
+net_buffer_t* NetBufferMagazineRequest(net_buffer_magazine_t* mag)
+{
+    if (!mag) {
+        return NULL;
+    }
+
+    if (mag->count == 0) {
+        mag->count = depot_take(mag->pool, mag->entry, mag->cfg.refill);
+        if (mag->count == 0) {
+            mag->stats.request_failed++;
+            return NULL;
+        }
+        mag->stats.request_global++;
+    } else {
+        mag->stats.request_local++;
+    }
+
+    net_buffer_t* buffer = mag->entry[--mag->count];
+    buffer->state = NETBUF_STATE_USED;
+    reset_header(mag->pool, buffer);
+    return buffer;
+}
+
+int NetBufferMagazineRelease(net_buffer_magazine_t* mag, net_buffer_t* buffer)
+{
+    if (!mag || !buffer || !is_pool_buffer(mag->pool, buffer)) {
+        return -1;
+    }
+
+    /* requested from the pool itself, it is still in the used list */
+    if (mag->pool->used_map && used_map_test(mag->pool, buffer_index(mag->pool, buffer))) {
+        return -1;
+    }
+
+    /* the chain or the other references would leak */
+    if (buffer->chain_next != NETBUF_NO_INDEX || buffer->refcount > 1 || buffer->payload_owner != NETBUF_NO_INDEX) {
+        return -1;
+    }
+
+    /* the buffer may have been handed to us by another thread, don't let two
+     * racing releases both cache it */
+    if (!mark_free(buffer)) {
+        return -1;
+    }
+
+    if (mag->count >= mag->cfg.flush_high) {
+        const size_t n = mag->count - mag->cfg.flush_low;
+        depot_put(mag->pool, &mag->entry[mag->cfg.flush_low], n);
+        mag->count = mag->cfg.flush_low;
+        mag->stats.release_global++;
+    } else {
+        mag->stats.release_local++;
+    }
+
+    mag->entry[mag->count++] = buffer;
+    return 0;
+}
@@ -0,0 +1,239 @@
+#include "netbuf_simd.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+struct simd_ops {
+    size_t (*find)(void* const* v, size_t n, const void* item);
+    size_t (*compact)(void** v, size_t n);
+    enum netbuf_simd_level level;
+};
+
+static size_t find_scalar(void* const* v, size_t n, const void* item)
+{
+    for (size_t i = 0; i < n; ++i) {
+        if (v[i] == item) {
+            return i;
+        }
+    }
+    return n;
+}
+
+/* compacts v[i..n) onto v[out..), then clears what is left behind */
+static size_t compact_tail(void** v, size_t i, size_t out, size_t n)
+{
+    for (; i < n; ++i) {
+        if (v[i]) {
+            v[out++] = v[i];
+        }
+    }
+    if (out < n) {
+        memset(&v[out], 0, (n - out) * sizeof(void*));
+    }
+    return out;
+}
+
+static size_t compact_scalar(void** v, size_t n)
+{
+    return compact_tail(v, 0, 0, n);
+}
+
+static const struct simd_ops ops_scalar = { find_scalar, compact_scalar, NETBUF_SIMD_SCALAR };
+
+#if defined(__x86_64__)
+
+/* the vector loops of the compaction store whole vectors at the write
+ * position, which never passes the read position, so they only overwrite
+ * entries that were already loaded */
+
+/* lanes of a 2 pointer vector equal to `x` */
+__attribute__((target("sse2"))) static inline int eq_mask_sse2(__m128i a, __m128i x)
+{
+    /* no 64 bit compare in SSE2: both halves have to match */
+    __m128i c = _mm_cmpeq_epi32(a, x);
+    c = _mm_and_si128(c, _mm_shuffle_epi32(c, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_movemask_pd(_mm_castsi128_pd(c));
+}
+
+__attribute__((target("sse2"))) static size_t find_sse2(void* const* v, size_t n, const void* item)
+{
+    const __m128i x = _mm_set1_epi64x((long long)(uintptr_t)item);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const int lo = eq_mask_sse2(_mm_loadu_si128((const __m128i*)&v[i]), x);
+        const int hi = eq_mask_sse2(_mm_loadu_si128((const __m128i*)&v[i + 2]), x);
+        if (lo | hi) {
+            return i + (size_t)__builtin_ctz((unsigned)(lo | hi << 2));
+        }
+    }
+    for (; i < n; ++i) {
+        if (v[i] == item) {
+            return i;
+        }
+    }
+    return n;
+}
+
+/* with 2 lanes the compaction doesn't beat the scalar loop, which compilers
+ * make branchless */
+static const struct simd_ops ops_sse2 = { find_sse2, compact_scalar, NETBUF_SIMD_SSE2 };
+
+__attribute__((target("avx2"))) static inline int eq_mask_avx2(__m256i a, __m256i x)
+{
+    return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(a, x)));
+}
+
+__attribute__((target("avx2"))) static size_t find_avx2(void* const* v, size_t n, const void* item)
+{
+    const __m256i x = _mm256_set1_epi64x((long long)(uintptr_t)item);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const int lo = eq_mask_avx2(_mm256_loadu_si256((const __m256i*)&v[i]), x);
+        const int hi = eq_mask_avx2(_mm256_loadu_si256((const __m256i*)&v[i + 4]), x);
+        if (lo | hi) {
+            return i + (size_t)__builtin_ctz((unsigned)(lo | hi << 4));
+        }
+    }
+    for (; i < n; ++i) {
+        if (v[i] == item) {
+            return i;
+        }
+    }
+    return n;
+}
+
+/* moves the kept pointers of a 4 pointer vector to its front, by keep mask */
+static const int32_t compact_lut_avx2[16][8] = {
+    { 0, 1, 0, 1, 0, 1, 0, 1 },
+    { 0, 1, 0, 1, 0, 1, 0, 1 },
+    { 2, 3, 0, 1, 0, 1, 0, 1 },
+    { 0, 1, 2, 3, 0, 1, 0, 1 },
+    { 4, 5, 0, 1, 0, 1, 0, 1 },
+    { 0, 1, 4, 5, 0, 1, 0, 1 },
+    { 2, 3, 4, 5, 0, 1, 0, 1 },
+    { 0, 1, 2, 3, 4, 5, 0, 1 },
+    { 6, 7, 0, 1, 0, 1, 0, 1 },
+    { 0, 1, 6, 7, 0, 1, 0, 1 },
+    { 2, 3, 6, 7, 0, 1, 0, 1 },
+    { 0, 1, 2, 3, 6, 7, 0, 1 },
+    { 4, 5, 6, 7, 0, 1, 0, 1 },
+    { 0, 1, 4, 5, 6, 7, 0, 1 },
+    { 2, 3, 4, 5, 6, 7, 0, 1 },
+    { 0, 1, 2, 3, 4, 5, 6, 7 },
+};
+
+__attribute__((target("avx2"))) static size_t compact_avx2(void** v, size_t n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0, out = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256i a = _mm256_loadu_si256((const __m256i*)&v[i]);
+        const int keep = ~eq_mask_avx2(a, zero) & 0xF;
+        const __m256i perm = _mm256_loadu_si256((const __m256i*)compact_lut_avx2[keep]);
+        _mm256_storeu_si256((__m256i*)&v[out], _mm256_permutevar8x32_epi32(a, perm));
+        out += (size_t)__builtin_popcount((unsigned)keep);
+    }
+    return compact_tail(v, i, out, n);
+}
+
+static const struct simd_ops ops_avx2 = { find_avx2, compact_avx2, NETBUF_SIMD_AVX2 };
+
+__attribute__((target("avx512f"))) static size_t find_avx512(void* const* v, size_t n, const void* item)
+{
+    const __m512i x = _mm512_set1_epi64((long long)(uintptr_t)item);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __mmask8 lo = _mm512_cmpeq_epi64_mask(_mm512_loadu_si512(&v[i]), x);
+        const __mmask8 hi = _mm512_cmpeq_epi64_mask(_mm512_loadu_si512(&v[i + 8]), x);
+        if (lo | hi) {
+            return i + (size_t)__builtin_ctz((unsigned)lo | (unsigned)hi << 8);
+        }
+    }
+    for (; i < n; ++i) {
+        if (v[i] == item) {
+            return i;
+        }
+    }
+    return n;
+}
+
+__attribute__((target("avx512f"))) static size_t compact_avx512(void** v, size_t n)
+{
+    size_t i = 0, out = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m512i a = _mm512_loadu_si512(&v[i]);
+        const __mmask8 keep = _mm512_test_epi64_mask(a, a);
+        /* a full store beats compressstoreu, which is microcoded on some cores */
+        _mm512_storeu_si512(&v[out], _mm512_maskz_compress_epi64(keep, a));
+        out += (size_t)__builtin_popcount((unsigned)keep);
+    }
+    return compact_tail(v, i, out, n);
+}
+
+static const struct simd_ops ops_avx512 = { find_avx512, compact_avx512, NETBUF_SIMD_AVX512 };
+
+#endif /* __x86_64__ */
+
+static const struct simd_ops* ops_for(enum netbuf_simd_level level)
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    switch (level) {
+    case NETBUF_SIMD_SCALAR:
+        return &ops_scalar;
+    case NETBUF_SIMD_SSE2:
+        return __builtin_cpu_supports("sse2") ? &ops_sse2 : NULL;
+    case NETBUF_SIMD_AVX2:
+        return __builtin_cpu_supports("avx2") ? &ops_avx2 : NULL;
+    case NETBUF_SIMD_AVX512:
+        return __builtin_cpu_supports("avx512f") ? &ops_avx512 : NULL;
+    }
+    return NULL;
+#else
+    return level == NETBUF_SIMD_SCALAR ? &ops_scalar : NULL;
+#endif
+}
+
+/* picked on first use. threads racing on it pick the same */
+static const struct simd_ops* simd_ops;
+
+static const struct simd_ops* ops(void)
+{
+    const struct simd_ops* o = __atomic_load_n(&simd_ops, __ATOMIC_RELAXED);
+    if (__builtin_expect(o == NULL, 0)) {
+        for (int level = NETBUF_SIMD_AVX512; !o; --level) {
+            o = ops_for((enum netbuf_simd_level)level);
+        }
+        __atomic_store_n(&simd_ops, o, __ATOMIC_RELAXED);
+    }
+    return o;
+}
+
+size_t netbuf_ptr_find(void* const* v, size_t n, const void* item)
+{
+    return ops()->find(v, n, item);
+}
+
+size_t netbuf_ptr_compact(void** v, size_t n)
+{
+    return ops()->compact(v, n);
+}
+
+enum netbuf_simd_level netbuf_simd_get_level(void)
+{
+    return ops()->level;
+}
+
+int netbuf_simd_set_level(enum netbuf_simd_level level)
+{
+    const struct simd_ops* o = ops_for(level);
+    if (!o) {
+        return -1;
+    }
+    __atomic_store_n(&simd_ops, o, __ATOMIC_RELAXED);
+    return 0;
+}
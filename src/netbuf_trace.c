@@ -0,0 +1,112 @@
+#include "netbuf.h"
+#include "netbuf_internal.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if NETBUF_TRACE
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+__thread struct trace_ring* trace_self;
+
+/* every ring ever attached, only ever pushed to */
+static struct trace_ring* trace_rings;
+
+static pthread_key_t trace_key;
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+
+/* gives the ring of an exiting thread up for reuse */
+static void trace_detach(void* ring)
+{
+    __atomic_store_n(&((struct trace_ring*)ring)->owned, 0, __ATOMIC_RELEASE);
+}
+
+static void trace_init(void)
+{
+    (void)pthread_key_create(&trace_key, trace_detach);
+}
+
+struct trace_ring* trace_attach(void)
+{
+    pthread_once(&trace_once, trace_init);
+
+    struct trace_ring* ring = __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE);
+    for (; ring; ring = ring->next) {
+        uint8_t owned = 0;
+        if (__atomic_compare_exchange_n(&ring->owned, &owned, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    if (!ring) {
+        ring = NETBUF_MALLOC(sizeof(*ring));
+        if (!ring) {
+            return NULL;
+        }
+        memset(ring, 0, sizeof(*ring));
+        ring->owned = 1;
+        ring->next = __atomic_load_n(&trace_rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&trace_rings, &ring->next, ring, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) { }
+    }
+
+    ring->tid = (uint32_t)syscall(SYS_gettid);
+    (void)pthread_setspecific(trace_key, ring);
+    trace_self = ring;
+    return ring;
+}
+
+int NetBufferTraceDump(const char* path)
+{
+    if (!path) {
+        return -1;
+    }
+
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+
+    /* the count is only known at the end */
+    net_buffer_trace_header_t header = {
+        .magic = NETBUF_TRACE_MAGIC,
+        .version = NETBUF_TRACE_VERSION,
+        .entry_size = sizeof(net_buffer_trace_entry_t),
+        .count = 0,
+    };
+    int ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+    struct trace_ring* ring = __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE);
+    for (; ring && ok; ring = ring->next) {
+        const uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        const uint64_t first = head > NETBUF_TRACE_ENTRIES ? head - NETBUF_TRACE_ENTRIES : 0;
+        for (uint64_t i = first; i < head && ok; ++i) {
+            ok = fwrite(&ring->entries[i & (NETBUF_TRACE_ENTRIES - 1)], sizeof(net_buffer_trace_entry_t), 1, f) == 1;
+            header.count++;
+        }
+    }
+
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, f) == 1;
+    if (fclose(f) != 0 || !ok) {
+        return -1;
+    }
+    return (int)header.count;
+}
+
+void NetBufferTraceReset(void)
+{
+    struct trace_ring* ring = __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE);
+    for (; ring; ring = ring->next) {
+        __atomic_store_n(&ring->head, 0, __ATOMIC_RELAXED);
+    }
+}
+#else
+int NetBufferTraceDump(const char* path)
+{
+    (void)path;
+    return -1;
+}
+
+void NetBufferTraceReset(void) { }
+#endif
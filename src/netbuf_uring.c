@@ -0,0 +1,387 @@
+#include "netbuf.h"
+#include "netbuf_internal.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/* the raw syscalls, so there's no dependency on liburing */
+
+static int uring_setup(unsigned entries, struct io_uring_params* p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/* user_data of a submission: the operation in the upper half, the index of
+ * the buffer written from in the lower half */
+#define URING_USER_DATA(op, idx) (((uint64_t)(op) << 32) | (uint32_t)(idx))
+
+enum { MAP_SQ, MAP_CQ, MAP_SQES, MAP_PBUF };
+
+static void* map_ring(net_buffer_uring_t* ur, int which, size_t size, off_t offset)
+{
+    void* addr = offset < 0
+        ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+        : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ur->fd, offset);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+
+    ur->maps[which].addr = addr;
+    ur->maps[which].size = size;
+    return addr;
+}
+
+/* the region every pool payload lives in */
+static struct iovec payload_region(const net_buffer_cb_t* cb)
+{
+    struct iovec iov;
+    if (cb->payload) {
+        iov.iov_base = cb->payload;
+        iov.iov_len = cb->num_buffers * cb->payload_stride;
+    } else {
+        iov.iov_base = cb->buffers;
+        iov.iov_len = cb->num_buffers * cb->elem_size;
+    }
+    return iov;
+}
+
+/* lends free pool buffers to the kernel until the provided ring is full */
+static void pbuf_refill(net_buffer_uring_t* ur)
+{
+    net_buffer_cb_t* cb = ur->pool;
+    net_buffer_t* buffers[NETBUF_IO_BATCH];
+
+    while (ur->pbuf.lent < ur->pbuf.entries) {
+        size_t want = ur->pbuf.entries - ur->pbuf.lent;
+        if (want > NETBUF_IO_BATCH) {
+            want = NETBUF_IO_BATCH;
+        }
+
+        const size_t count = depot_take(cb, buffers, want);
+        if (count == 0) {
+            break;
+        }
+
+        const unsigned mask = ur->pbuf.entries - 1;
+        for (size_t i = 0; i < count; ++i) {
+            net_buffer_t* buffer = buffers[i];
+            const uint32_t idx = buffer_index(cb, buffer);
+            reset_header(cb, buffer);
+
+            struct io_uring_buf* slot = &ur->pbuf.ring->bufs[ur->pbuf.tail & mask];
+            slot->addr = (uint64_t)(uintptr_t)NetBufferData(cb, buffer);
+            slot->len = (uint32_t)NetBufferGetCapacity(cb, buffer);
+            slot->bid = (uint16_t)idx;
+            ur->pbuf.tail++;
+            ur->lent[idx] = 1;
+        }
+        ur->pbuf.lent += count;
+
+        __atomic_store_n(&ur->pbuf.ring->tail, ur->pbuf.tail, __ATOMIC_RELEASE);
+    }
+}
+
+/* puts a buffer the kernel gave back unused at the end of the provided ring */
+static void pbuf_recycle(net_buffer_uring_t* ur, uint16_t bid)
+{
+    const unsigned mask = ur->pbuf.entries - 1;
+    net_buffer_t* buffer = buffer_at(ur->pool, bid);
+
+    struct io_uring_buf* slot = &ur->pbuf.ring->bufs[ur->pbuf.tail & mask];
+    slot->addr = (uint64_t)(uintptr_t)NetBufferData(ur->pool, buffer);
+    slot->len = (uint32_t)NetBufferGetCapacity(ur->pool, buffer);
+    slot->bid = bid;
+    ur->pbuf.tail++;
+
+    __atomic_store_n(&ur->pbuf.ring->tail, ur->pbuf.tail, __ATOMIC_RELEASE);
+}
+
+static struct io_uring_sqe* sqe_get(net_buffer_uring_t* ur)
+{
+    const unsigned head = __atomic_load_n(ur->sq.head, __ATOMIC_ACQUIRE);
+    const unsigned tail = *ur->sq.tail;
+
+    if (tail - head >= ur->sq.entries) {
+        return NULL;
+    }
+
+    const unsigned slot = tail & ur->sq.mask;
+    struct io_uring_sqe* sqe = &ur->sq.sqes[slot];
+    memset(sqe, 0, sizeof(*sqe));
+    ur->sq.array[slot] = slot;
+    return sqe;
+}
+
+static void sqe_push(net_buffer_uring_t* ur)
+{
+    ur->sq.pending++;
+    __atomic_store_n(ur->sq.tail, *ur->sq.tail + 1, __ATOMIC_RELEASE);
+}
+
+int NetBufferUringInit(net_buffer_uring_t* ur, net_buffer_cb_t* pool, unsigned entries)
+{
+    if (!ur || !pool || !entries || entries > 32768) {
+        return -1;
+    }
+
+    /* buffer ids are 16 bits wide */
+    if (pool->classes || pool->num_buffers > 65536) {
+        return -1;
+    }
+
+    /* the ring is filled from the whole free list, reservations included */
+    if (pool->ifaces.list) {
+        return -1;
+    }
+
+    memset(ur, 0, sizeof(*ur));
+    ur->pool = pool;
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ur->fd = uring_setup(entries, &p);
+    if (ur->fd < 0) {
+        return -1;
+    }
+
+    size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_size = cq_size = sq_size > cq_size ? sq_size : cq_size;
+    }
+
+    uint8_t* sq = map_ring(ur, MAP_SQ, sq_size, IORING_OFF_SQ_RING);
+    uint8_t* cq = (p.features & IORING_FEAT_SINGLE_MMAP) ? sq : map_ring(ur, MAP_CQ, cq_size, IORING_OFF_CQ_RING);
+    ur->sq.sqes = map_ring(ur, MAP_SQES, p.sq_entries * sizeof(struct io_uring_sqe), IORING_OFF_SQES);
+    if (!sq || !cq || !ur->sq.sqes) {
+        goto cleanup;
+    }
+
+    ur->sq.head = (unsigned*)(sq + p.sq_off.head);
+    ur->sq.tail = (unsigned*)(sq + p.sq_off.tail);
+    ur->sq.array = (unsigned*)(sq + p.sq_off.array);
+    ur->sq.mask = *(unsigned*)(sq + p.sq_off.ring_mask);
+    ur->sq.entries = p.sq_entries;
+    ur->cq.head = (unsigned*)(cq + p.cq_off.head);
+    ur->cq.tail = (unsigned*)(cq + p.cq_off.tail);
+    ur->cq.mask = *(unsigned*)(cq + p.cq_off.ring_mask);
+    ur->cq.cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    ur->pbuf.entries = 1;
+    while (ur->pbuf.entries < entries) {
+        ur->pbuf.entries <<= 1;
+    }
+
+    const size_t pbuf_size = ur->pbuf.entries * sizeof(struct io_uring_buf);
+    ur->pbuf.ring = map_ring(ur, MAP_PBUF, pbuf_size, -1);
+    ur->lent = NETBUF_MALLOC(pool->num_buffers);
+    if (!ur->pbuf.ring || !ur->lent) {
+        goto cleanup;
+    }
+    memset(ur->lent, 0, pool->num_buffers);
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ur->pbuf.ring;
+    reg.ring_entries = ur->pbuf.entries;
+    reg.bgid = NETBUF_URING_BGID;
+    if (uring_register(ur->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        goto cleanup;
+    }
+
+    /* pinning the payloads may exceed RLIMIT_MEMLOCK, writes work without it.
+     * it would also commit every page of a lazy pool */
+    if (!(pool->flags & NETBUF_F_LAZY_INIT)) {
+        const struct iovec region = payload_region(pool);
+        ur->fixed = uring_register(ur->fd, IORING_REGISTER_BUFFERS, &region, 1) == 0;
+    }
+
+    pbuf_refill(ur);
+    return 0;
+
+cleanup:;
+    const int err = errno;
+    (void)NetBufferUringDeinit(ur);
+    errno = err;
+    return -1;
+}
+
+int NetBufferUringDeinit(net_buffer_uring_t* ur)
+{
+    if (!ur || !ur->pool) {
+        return -1;
+    }
+
+    /* once the ring is unregistered no read can pick a lent buffer */
+    if (ur->fd >= 0) {
+        struct io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.bgid = NETBUF_URING_BGID;
+        (void)uring_register(ur->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        close(ur->fd);
+    }
+
+    if (ur->lent) {
+        net_buffer_t* buffers[NETBUF_IO_BATCH];
+        size_t count = 0;
+
+        for (size_t i = 0; i < ur->pool->num_buffers; ++i) {
+            if (!ur->lent[i]) {
+                continue;
+            }
+            buffers[count++] = buffer_at(ur->pool, (uint32_t)i);
+            if (count == NETBUF_IO_BATCH) {
+                depot_put(ur->pool, buffers, count);
+                count = 0;
+            }
+        }
+        depot_put(ur->pool, buffers, count);
+
+        NETBUF_FREE(ur->lent);
+    }
+
+    for (size_t i = 0; i < sizeof(ur->maps) / sizeof(ur->maps[0]); ++i) {
+        if (ur->maps[i].addr) {
+            munmap(ur->maps[i].addr, ur->maps[i].size);
+        }
+    }
+
+    memset(ur, 0, sizeof(*ur));
+    ur->fd = -1;
+    return 0;
+}
+
+int NetBufferUringRead(net_buffer_uring_t* ur, int fd)
+{
+    if (!ur || !ur->pool) {
+        return -1;
+    }
+
+    struct io_uring_sqe* sqe = sqe_get(ur);
+    if (!sqe) {
+        return -1;
+    }
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->off = (uint64_t)-1; /* current position, 0 for pipes and sockets */
+    sqe->len = (uint32_t)ur->pool->buffer_capacity;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = NETBUF_URING_BGID;
+    sqe->user_data = URING_USER_DATA(NETBUF_URING_READ, NETBUF_NO_INDEX);
+
+    sqe_push(ur);
+    return 0;
+}
+
+int NetBufferUringWrite(net_buffer_uring_t* ur, int fd, net_buffer_t* buffer)
+{
+    if (!ur || !ur->pool || !buffer || !is_pool_buffer(ur->pool, buffer)) {
+        return -1;
+    }
+
+    if (buffer->chain_next != NETBUF_NO_INDEX) {
+        return -1;
+    }
+
+    struct io_uring_sqe* sqe = sqe_get(ur);
+    if (!sqe) {
+        return -1;
+    }
+
+    sqe->opcode = ur->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->off = (uint64_t)-1;
+    sqe->addr = (uint64_t)(uintptr_t)NetBufferData(ur->pool, buffer);
+    sqe->len = (uint32_t)buffer->user_data_length;
+    sqe->buf_index = 0;
+    sqe->user_data = URING_USER_DATA(NETBUF_URING_WRITE, buffer_index(ur->pool, buffer));
+
+    sqe_push(ur);
+    return 0;
+}
+
+int NetBufferUringSubmit(net_buffer_uring_t* ur, unsigned wait)
+{
+    if (!ur || !ur->pool) {
+        return -1;
+    }
+
+    pbuf_refill(ur);
+
+    const unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+    const int submitted = uring_enter(ur->fd, ur->sq.pending, wait, flags);
+    if (submitted < 0) {
+        return -1;
+    }
+
+    ur->sq.pending -= (unsigned)submitted;
+    return submitted;
+}
+
+int NetBufferUringReap(net_buffer_uring_t* ur, net_buffer_uring_event_t* out, size_t n)
+{
+    if (!ur || !ur->pool || !out) {
+        return -1;
+    }
+
+    net_buffer_cb_t* cb = ur->pool;
+    unsigned head = *ur->cq.head;
+    const unsigned tail = __atomic_load_n(ur->cq.tail, __ATOMIC_ACQUIRE);
+    size_t count = 0;
+
+    for (; head != tail && count < n; ++head) {
+        const struct io_uring_cqe* cqe = &ur->cq.cqes[head & ur->cq.mask];
+        net_buffer_uring_event_t* ev = &out[count++];
+
+        ev->op = (uint8_t)(cqe->user_data >> 32);
+        ev->res = cqe->res;
+        ev->buffer = NULL;
+
+        if (ev->op == NETBUF_URING_WRITE) {
+            ev->buffer = buffer_at(cb, (uint32_t)cqe->user_data);
+            ur->stats.writes++;
+            continue;
+        }
+
+        if (!(cqe->flags & IORING_CQE_F_BUFFER)) {
+            if (cqe->res == -ENOBUFS) {
+                ur->stats.nobufs++;
+            }
+            continue;
+        }
+
+        const uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        if (cqe->res <= 0) {
+            pbuf_recycle(ur, bid);
+            continue;
+        }
+
+        net_buffer_t* buffer = buffer_at(cb, bid);
+        ur->lent[bid] = 0;
+        ur->pbuf.lent--;
+        depot_claim(cb, buffer);
+        buffer->user_data_length = (size_t)cqe->res;
+
+        ev->buffer = buffer;
+        ur->stats.reads++;
+    }
+
+    __atomic_store_n(ur->cq.head, head, __ATOMIC_RELEASE);
+    return (int)count;
+}
@@ -359,4 +359,117 @@ TEST(CircularBuffer, PeekBack)
     cbuf_free(cb);
 }
 
+TEST(CircularBuffer, RandomRemoveWrapping)
+{
+    const size_t num_runs = 1024 * 16;
+
+    for (size_t i = 0; i < num_runs; ++i) {
+        struct circular_buffer* cb;
+        const size_t n = 8;
+        cb = cbuf_alloc(n);
+
+        /* start anywhere, so the items wrap around the end of the storage */
+        const auto offset = (ssize_t)(std::rand() % n);
+        cb->head = cb->tail = offset;
+
+        auto values = std::vector<size_t>(1 + std::rand() % n);
+        std::iota(values.begin(), values.end(), 1);
+        for (auto v : values) {
+            cbuf_push_back(cb, (void*)v);
+        }
+
+        while (!values.empty()) {
+            size_t removal_idx = std::rand() % values.size();
+            ASSERT_EQ(0, cbuf_remove(cb, (void*)values[removal_idx]));
+            values.erase(values.begin() + removal_idx);
+
+            ASSERT_EQ(values.size(), cbuf_count(cb));
+            for (size_t i = 0; i < values.size(); ++i) {
+                auto cb_idx = (cb->head + i) % cb->capacity;
+                ASSERT_EQ((void*)values[i], cb->entry[cb_idx]);
+            }
+        }
+        cbuf_free(cb);
+    }
+}
+
+TEST(CircularBuffer, ContainsOnlyLiveItems)
+{
+    struct circular_buffer* cb;
+    cb = cbuf_alloc(4);
+
+    cbuf_push_back(cb, (void*)1);
+    cbuf_push_back(cb, (void*)2);
+    cbuf_pop_front(cb);
+
+    /* the popped item is still in the storage, but not in the buffer */
+    EXPECT_EQ(-1, cbuf_contains(cb, (void*)1));
+    EXPECT_EQ(-1, cbuf_remove(cb, (void*)1));
+    EXPECT_EQ(1, cbuf_contains(cb, (void*)2));
+    EXPECT_EQ(-1, cbuf_contains(cb, (void*)3));
+
+    cbuf_free(cb);
+}
+
+TEST(CircularBuffer, PeekBackWrapping)
+{
+    struct circular_buffer* cb;
+    cb = cbuf_alloc(4);
+
+    cb->head = cb->tail = 3;
+    cbuf_push_back(cb, (void*)1);
+    EXPECT_EQ(0, cb->tail);
+    EXPECT_EQ((void*)1, cbuf_peek_back(cb));
+
+    cbuf_free(cb);
+}
+
+TEST(CircularBuffer, BulkWrapping)
+{
+    struct circular_buffer* cb;
+    const size_t n = 16;
+    cb = cbuf_alloc(n);
+
+    auto values = std::vector<size_t>(12);
+    std::iota(values.begin(), values.end(), 1);
+
+    /* the copy is split at the end of the storage */
+    cb->head = cb->tail = 10;
+    cbuf_push_back_bulk(cb, (void* const*)values.data(), values.size());
+    EXPECT_EQ(values.size(), cbuf_count(cb));
+    EXPECT_EQ(6, cb->tail);
+
+    EXPECT_EQ(12, cbuf_match_front(cb, (void* const*)values.data(), values.size()));
+    values[5] = 0;
+    EXPECT_EQ(5, cbuf_match_front(cb, (void* const*)values.data(), values.size()));
+
+    auto out = std::vector<void*>(8);
+    cbuf_pop_front_bulk(cb, out.data(), out.size());
+    EXPECT_EQ(4, cbuf_count(cb));
+    EXPECT_EQ(2, cb->head);
+    for (size_t i = 0; i < out.size(); ++i) {
+        EXPECT_EQ((void*)(i + 1), out[i]);
+    }
+
+    cbuf_pop_back_bulk(cb, 3);
+    EXPECT_EQ(1, cbuf_count(cb));
+    EXPECT_EQ(3, cb->tail);
+    EXPECT_EQ((void*)9, cbuf_peek_back(cb));
+
+    cbuf_pop_front_bulk(cb, nullptr, 1);
+    EXPECT_EQ(0, cbuf_count(cb));
+    EXPECT_EQ(cb->tail, cb->head);
+
+    /* back across the start of the storage */
+    cb->head = cb->tail = 14;
+    cbuf_push_back_bulk(cb, (void* const*)values.data(), 4);
+    EXPECT_EQ(2, cb->tail);
+    cbuf_pop_back_bulk(cb, 3);
+    EXPECT_EQ(1, cbuf_count(cb));
+    EXPECT_EQ(15, cb->tail);
+    EXPECT_EQ((void*)1, cbuf_peek_back(cb));
+
+    cbuf_free(cb);
+}
+
 } // namespace
@@ -1,10 +1,15 @@
 #include <gmock/gmock.h>
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <set>
 
 using namespace ::testing;
 
 #define NETBUF_ASSERT(x) EXPECT_TRUE(x)
 
 #include "netbuf.h"
+#include "netbuf_test.h"
 #include "simple_stack.h"
 #include "circular_buffer.h"
 
@@ -109,4 +114,394 @@ TEST(NetBuffer, Repeat)
     free(user_data);
     NetBufferDeinit(cb);
 }
+
+TEST(NetBuffer, LinkedInit)
+{
+    net_buffer_cb_t cb;
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 4;
+    cfg.buffer_size = 16;
+    cfg.flags = NETBUF_F_LINKED_USED_LIST;
+    ASSERT_EQ(0, NetBufferInitEx(&cb, &cfg));
+
+    EXPECT_EQ(nullptr, cb.used_list);
+    EXPECT_EQ(stack_count(cb.free_list), 4);
+    EXPECT_EQ(0, NetBufferGetUsedCount(&cb));
+    EXPECT_EQ(nullptr, NetBufferGetLRU(&cb));
+
+    NetBufferDeinit(&cb);
+}
+
+TEST(NetBuffer, LinkedOutOfOrderRelease)
+{
+    net_buffer_cb_t cb[1];
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 64;
+    cfg.buffer_size = 8;
+    cfg.flags = NETBUF_F_LINKED_USED_LIST;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    /* buffers in request order, the front is the least recently used */
+    std::deque<net_buffer_t*> held;
+    for (size_t i = 0; i < 4096; ++i) {
+        if (held.size() < 64 && (held.empty() || std::rand() % 2)) {
+            auto buffer = NetBufferRequest(cb);
+            ASSERT_NE(nullptr, buffer);
+            held.push_back(buffer);
+        } else {
+            auto it = held.begin() + (std::rand() % held.size());
+            ASSERT_EQ(0, NetBufferRelease(cb, *it));
+            held.erase(it);
+        }
+
+        ASSERT_EQ(held.size(), NetBufferGetUsedCount(cb));
+        ASSERT_EQ(held.empty() ? nullptr : held.front(), NetBufferGetLRU(cb));
+    }
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBuffer, LinkedDoubleRelease)
+{
+    net_buffer_cb_t cb[1];
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 4;
+    cfg.buffer_size = 8;
+    cfg.flags = NETBUF_F_LINKED_USED_LIST;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto a = NetBufferRequest(cb);
+    auto b = NetBufferRequest(cb);
+    ASSERT_EQ(0, NetBufferRelease(cb, a));
+    EXPECT_EQ(-1, NetBufferRelease(cb, a));
+    EXPECT_EQ(1, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(b, NetBufferGetLRU(cb));
+
+    /* not a buffer of this pool */
+    net_buffer_t foreign = {};
+    EXPECT_EQ(-1, NetBufferRelease(cb, &foreign));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBuffer, RequestBulk)
+{
+    net_buffer_cb_t cb[1];
+    NetBufferInit(cb, 16, 8);
+
+    net_buffer_t* out[24];
+    EXPECT_EQ(-1, NetBufferRequestBulk(NULL, out, 4));
+    EXPECT_EQ(10, NetBufferRequestBulk(cb, out, 10));
+    EXPECT_EQ(10, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(out[0], NetBufferGetLRU(cb));
+
+    /* only what's left */
+    EXPECT_EQ(6, NetBufferRequestBulk(cb, out + 10, 14));
+    EXPECT_EQ(0, NetBufferRequestBulk(cb, out + 16, 8));
+    EXPECT_EQ(16, NetBufferGetUsedCount(cb));
+
+    /* all distinct */
+    std::sort(out, out + 16);
+    EXPECT_EQ(out + 16, std::unique(out, out + 16));
+
+    NetBufferDeinit(cb);
+}
+
+void release_bulk_in_mode(uint32_t flags)
+{
+    net_buffer_cb_t cb[1];
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 64;
+    cfg.buffer_size = 8;
+    cfg.flags = flags;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    std::mt19937 rng(flags);
+    for (size_t round = 0; round < 32; ++round) {
+        net_buffer_t* out[64];
+        const size_t n = std::uniform_int_distribution<size_t>(1, 64)(rng);
+        ASSERT_EQ(n, NetBufferRequestBulk(cb, out, n));
+
+        /* release a prefix in LRU order, then the rest shuffled */
+        const size_t in_order = std::uniform_int_distribution<size_t>(0, n)(rng);
+        std::shuffle(out + in_order, out + n, rng);
+        ASSERT_EQ(in_order, NetBufferReleaseBulk(cb, out, in_order));
+        ASSERT_EQ(n - in_order, NetBufferGetUsedCount(cb));
+        if (in_order < n && !(flags & NETBUF_F_CONCURRENT)) {
+            /* the remaining buffers were requested after the released ones */
+            ASSERT_NE(nullptr, NetBufferGetLRU(cb));
+        }
+
+        ASSERT_EQ(n - in_order, NetBufferReleaseBulk(cb, out + in_order, n - in_order));
+        ASSERT_EQ(0, NetBufferGetUsedCount(cb));
+
+        /* everything is back on the free list, and can't be released twice */
+        ASSERT_EQ(0, NetBufferReleaseBulk(cb, out, n));
+    }
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBuffer, ReleaseBulk)
+{
+    release_bulk_in_mode(0);
+}
+
+TEST(NetBuffer, ReleaseBulkLinked)
+{
+    release_bulk_in_mode(NETBUF_F_LINKED_USED_LIST);
+}
+
+TEST(NetBuffer, ReleaseBulkConcurrent)
+{
+    release_bulk_in_mode(NETBUF_F_CONCURRENT);
+}
+
+TEST(NetBuffer, ReleaseBulkKeepsLRU)
+{
+    net_buffer_cb_t cb[1];
+    NetBufferInit(cb, 16, 8);
+
+    net_buffer_t* out[8];
+    ASSERT_EQ(8, NetBufferRequestBulk(cb, out, 8));
+
+    /* [0, 1, 2] collapse into one head advance, 5 is removed from the middle */
+    net_buffer_t* release[] = { out[0], out[1], out[2], out[5] };
+    EXPECT_EQ(4, NetBufferReleaseBulk(cb, release, 4));
+    EXPECT_EQ(4, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(out[3], NetBufferGetLRU(cb));
+
+    NetBufferDeinit(cb);
+}
+const net_buffer_class_config_t can_classes[] = {
+    { .buffer_size = 8, .num_buffers = 4 },
+    { .buffer_size = 64, .num_buffers = 2 },
+    { .buffer_size = 1500, .num_buffers = 1 },
+};
+
+net_buffer_config_t classes_cfg(uint32_t flags)
+{
+    net_buffer_config_t cfg = {};
+    cfg.flags = flags;
+    cfg.classes = can_classes;
+    cfg.num_classes = sizeof(can_classes) / sizeof(can_classes[0]);
+    return cfg;
+}
+
+TEST(NetBuffer, ClassesInit)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = classes_cfg(0);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    EXPECT_EQ(7, cb->num_buffers);
+    EXPECT_EQ(1500, cb->buffer_capacity);
+    EXPECT_EQ(3, cb->num_classes);
+    EXPECT_EQ(4, stack_count(cb->classes[0].free_list));
+    EXPECT_EQ(2, stack_count(cb->classes[1].free_list));
+    EXPECT_EQ(1, stack_count(cb->classes[2].free_list));
+
+    NetBufferDeinit(cb);
+
+    /* classes must be sorted */
+    const net_buffer_class_config_t unsorted[] = {
+        { .buffer_size = 64, .num_buffers = 2 },
+        { .buffer_size = 8, .num_buffers = 4 },
+    };
+    net_buffer_config_t bad = {};
+    bad.classes = unsorted;
+    bad.num_classes = 2;
+    EXPECT_EQ(-1, NetBufferInitEx(cb, &bad));
+
+    /* and can't be used concurrently */
+    bad = classes_cfg(NETBUF_F_CONCURRENT);
+    EXPECT_EQ(-1, NetBufferInitEx(cb, &bad));
+}
+
+TEST(NetBuffer, RequestSized)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = classes_cfg(0);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto can = NetBufferRequestSized(cb, 8);
+    auto canfd = NetBufferRequestSized(cb, 9);
+    auto eth = NetBufferRequestSized(cb, 1500);
+    ASSERT_NE(nullptr, can);
+    ASSERT_NE(nullptr, canfd);
+    ASSERT_NE(nullptr, eth);
+
+    EXPECT_EQ(8, NetBufferGetCapacity(cb, can));
+    EXPECT_EQ(64, NetBufferGetCapacity(cb, canfd));
+    EXPECT_EQ(1500, NetBufferGetCapacity(cb, eth));
+    EXPECT_EQ(nullptr, NetBufferRequestSized(cb, 1501));
+
+    EXPECT_EQ(1, NetBufferGetClassUsedCount(cb, 0));
+    EXPECT_EQ(1, NetBufferGetClassUsedCount(cb, 1));
+    EXPECT_EQ(1, NetBufferGetClassUsedCount(cb, 2));
+    EXPECT_EQ(-1, NetBufferGetClassUsedCount(cb, 3));
+    EXPECT_EQ(3, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(can, NetBufferGetLRU(cb));
+
+    /* writes are checked against the class capacity */
+    uint8_t data[64] = {};
+    EXPECT_EQ(-1, NetBufferWriteChecked(cb, can, data, 9));
+    EXPECT_EQ(64, NetBufferWriteChecked(cb, canfd, data, 64));
+
+    /* no fallback: the 1500 byte class is exhausted */
+    EXPECT_EQ(nullptr, NetBufferRequestSized(cb, 100));
+    EXPECT_EQ(nullptr, NetBufferRequest(cb));
+    EXPECT_EQ(2, cb->classes[2].stats.exhausted);
+
+    EXPECT_EQ(0, NetBufferRelease(cb, eth));
+    EXPECT_EQ(0, NetBufferGetClassUsedCount(cb, 2));
+    EXPECT_EQ(1, cb->classes[2].stats.high_water);
+    EXPECT_EQ(eth, NetBufferRequest(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBuffer, RequestSizedFallback)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = classes_cfg(NETBUF_F_CLASS_FALLBACK);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    /* 4 from the 8 byte class, then 2 + 1 from the larger ones */
+    std::vector<net_buffer_t*> held;
+    for (size_t i = 0; i < 7; ++i) {
+        auto buffer = NetBufferRequestSized(cb, 1);
+        ASSERT_NE(nullptr, buffer);
+        held.push_back(buffer);
+    }
+    EXPECT_EQ(nullptr, NetBufferRequestSized(cb, 1));
+    EXPECT_EQ(1500, NetBufferGetCapacity(cb, held.back()));
+    EXPECT_EQ(4, NetBufferGetClassUsedCount(cb, 0));
+    EXPECT_EQ(2, NetBufferGetClassUsedCount(cb, 1));
+    EXPECT_EQ(1, NetBufferGetClassUsedCount(cb, 2));
+
+    /* every buffer goes back to its own class */
+    for (auto buffer : held) {
+        EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    }
+    EXPECT_EQ(4, stack_count(cb->classes[0].free_list));
+    EXPECT_EQ(2, stack_count(cb->classes[1].free_list));
+    EXPECT_EQ(1, stack_count(cb->classes[2].free_list));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBuffer, ClassesLinked)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = classes_cfg(NETBUF_F_LINKED_USED_LIST | NETBUF_F_CLASS_FALLBACK);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    std::deque<net_buffer_t*> held;
+    for (size_t i = 0; i < 1024; ++i) {
+        if (held.size() < 7 && (held.empty() || std::rand() % 2)) {
+            auto buffer = NetBufferRequestSized(cb, std::rand() % 100);
+            if (buffer) {
+                held.push_back(buffer);
+            }
+        } else {
+            auto it = held.begin() + (std::rand() % held.size());
+            ASSERT_EQ(0, NetBufferRelease(cb, *it));
+            ASSERT_EQ(-1, NetBufferRelease(cb, *it));
+            held.erase(it);
+        }
+
+        ASSERT_EQ(held.size(), NetBufferGetUsedCount(cb));
+        ASSERT_EQ(held.empty() ? nullptr : held.front(), NetBufferGetLRU(cb));
+    }
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBuffer, CacheAligned)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(16, 20, NETBUF_F_CACHE_ALIGNED);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    EXPECT_EQ(0, cb->elem_size % NETBUF_CACHE_LINE_SIZE);
+
+    std::set<uintptr_t> lines;
+    net_buffer_t* out[16];
+    ASSERT_EQ(16, NetBufferRequestBulk(cb, out, 16));
+    for (auto buffer : out) {
+        EXPECT_EQ(buffer->user_data, NetBufferData(cb, buffer));
+        EXPECT_EQ(0, (uintptr_t)NetBufferData(cb, buffer) % NETBUF_CACHE_LINE_SIZE);
+
+        /* no cache line is shared with another buffer */
+        const auto first = (uintptr_t)buffer / NETBUF_CACHE_LINE_SIZE;
+        const auto last = ((uintptr_t)buffer->user_data + cb->buffer_capacity - 1) / NETBUF_CACHE_LINE_SIZE;
+        for (auto line = first; line <= last; ++line) {
+            EXPECT_TRUE(lines.insert(line).second);
+        }
+    }
+
+    EXPECT_EQ(16, NetBufferReleaseBulk(cb, out, 16));
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBuffer, SplitMeta)
+{
+    for (uint32_t flags : { 0u, (uint32_t)NETBUF_F_CACHE_ALIGNED, (uint32_t)NETBUF_F_LINKED_USED_LIST, (uint32_t)NETBUF_F_CONCURRENT }) {
+        net_buffer_cb_t cb[1];
+        const auto cfg = pool_cfg(8, 24, flags | NETBUF_F_SPLIT_META);
+        ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+        /* the headers are packed together */
+        EXPECT_EQ(sizeof(net_buffer_t), cb->elem_size);
+
+        std::vector<net_buffer_t*> held;
+        while (auto buffer = NetBufferRequest(cb)) {
+            held.push_back(buffer);
+        }
+        ASSERT_EQ(8, held.size());
+
+        for (size_t i = 0; i < held.size(); ++i) {
+            auto data = NetBufferData(cb, held[i]);
+            EXPECT_TRUE(data >= cb->payload && data < cb->payload + 8 * cb->payload_stride);
+            if (flags & NETBUF_F_CACHE_ALIGNED) {
+                EXPECT_EQ(0, (uintptr_t)data % NETBUF_CACHE_LINE_SIZE);
+            }
+
+            uint8_t pattern[24];
+            memset(pattern, (int)i, sizeof(pattern));
+            EXPECT_EQ(24, NetBufferWriteChecked(cb, held[i], pattern, sizeof(pattern)));
+        }
+
+        /* payloads don't overlap */
+        for (size_t i = 0; i < held.size(); ++i) {
+            auto data = NetBufferData(cb, held[i]);
+            for (size_t j = 0; j < 24; ++j) {
+                ASSERT_EQ(i, data[j]);
+            }
+        }
+
+        for (auto buffer : held) {
+            EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+        }
+        NetBufferDeinit(cb);
+    }
+}
+
+TEST(NetBuffer, ClassesCacheAligned)
+{
+    net_buffer_cb_t cb[1];
+    auto cfg = classes_cfg(NETBUF_F_CACHE_ALIGNED | NETBUF_F_CLASS_FALLBACK);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    while (auto buffer = NetBufferRequestSized(cb, 1)) {
+        EXPECT_EQ(0, (uintptr_t)NetBufferData(cb, buffer) % NETBUF_CACHE_LINE_SIZE);
+    }
+    EXPECT_EQ(7, NetBufferGetUsedCount(cb));
+    NetBufferDeinit(cb);
+
+    /* size classes keep their payload inline */
+    cfg.flags = NETBUF_F_SPLIT_META;
+    EXPECT_EQ(-1, NetBufferInitEx(cb, &cfg));
+}
 } // namespace
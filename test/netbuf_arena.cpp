@@ -0,0 +1,98 @@
+#include <gmock/gmock.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+#include "netbuf_test.h"
+
+namespace {
+
+/* number of pages of the slab that are resident */
+size_t resident_pages(const net_buffer_cb_t* cb)
+{
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t pages = (cb->arena.size + page - 1) / page;
+    std::vector<unsigned char> vec(pages);
+    if (mincore(cb->slab, cb->arena.size, vec.data()) != 0) {
+        return 0;
+    }
+
+    size_t count = 0;
+    for (auto v : vec) {
+        count += v & 1;
+    }
+    return count;
+}
+
+class NetBufferArenaModes : public TestWithParam<uint32_t> { };
+
+TEST_P(NetBufferArenaModes, RequestRelease)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(64, 256, GetParam());
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    EXPECT_NE(nullptr, cb->slab);
+    EXPECT_LE(64 * sizeof(net_buffer_t), cb->arena.size);
+    EXPECT_EQ(0u, (uintptr_t)cb->slab % (size_t)sysconf(_SC_PAGESIZE));
+
+    std::vector<net_buffer_t*> held;
+    while (auto buffer = NetBufferRequest(cb)) {
+        EXPECT_EQ(8, NetBufferWriteChecked(cb, buffer, "payload", 8));
+        held.push_back(buffer);
+    }
+    EXPECT_EQ(64, held.size());
+    EXPECT_EQ(64, NetBufferReleaseBulk(cb, held.data(), held.size()));
+
+    EXPECT_EQ(0, NetBufferDeinit(cb));
+    EXPECT_EQ(nullptr, cb->slab);
+    EXPECT_EQ(0, cb->arena.size);
+}
+
+INSTANTIATE_TEST_SUITE_P(Flags, NetBufferArenaModes,
+    Values(NETBUF_F_MMAP, NETBUF_F_HUGEPAGES, NETBUF_F_POPULATE, NETBUF_F_HUGEPAGES | NETBUF_F_POPULATE,
+        NETBUF_F_MLOCK, NETBUF_F_MMAP | NETBUF_F_CONCURRENT, NETBUF_F_MMAP | NETBUF_F_SPLIT_META));
+
+TEST(NetBufferArena, Populate)
+{
+    /* split metadata, so init only writes to the header pages */
+    net_buffer_cb_t cb[1];
+    auto cfg = pool_cfg(1024, 4096, NETBUF_F_MMAP | NETBUF_F_SPLIT_META);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+    const size_t lazy = resident_pages(cb);
+    EXPECT_EQ(0, NetBufferDeinit(cb));
+
+    cfg.flags |= NETBUF_F_POPULATE;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+    const size_t populated = resident_pages(cb);
+    EXPECT_EQ(0, NetBufferDeinit(cb));
+
+    EXPECT_LT(lazy, populated);
+    EXPECT_LE(1024u, populated);
+}
+
+TEST(NetBufferArena, Classes)
+{
+    const net_buffer_class_config_t classes[] = { { 64, 8 }, { 1500, 4 } };
+    net_buffer_config_t cfg = {};
+    cfg.classes = classes;
+    cfg.num_classes = 2;
+    cfg.flags = NETBUF_F_MMAP;
+
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto buffer = NetBufferRequestSized(cb, 1000);
+    ASSERT_NE(nullptr, buffer);
+    EXPECT_EQ(1, buffer->size_class);
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+
+    EXPECT_EQ(0, NetBufferDeinit(cb));
+}
+
+} // namespace
@@ -0,0 +1,170 @@
+#include <gmock/gmock.h>
+#include <numeric>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+#include "netbuf_test.h"
+
+namespace {
+
+std::vector<uint8_t> pattern(size_t len)
+{
+    std::vector<uint8_t> data(len);
+    std::iota(data.begin(), data.end(), 0);
+    return data;
+}
+
+class NetBufferChainModes : public TestWithParam<uint32_t> { };
+
+TEST_P(NetBufferChainModes, WriteReadRelease)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(8, 16, GetParam());
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    const auto data = pattern(40);
+    auto head = NetBufferRequest(cb);
+    ASSERT_NE(nullptr, head);
+    EXPECT_EQ(40, NetBufferWriteChain(cb, head, data.data(), data.size()));
+
+    EXPECT_EQ(3, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(40, NetBufferChainLength(cb, head));
+    EXPECT_EQ(16, head->user_data_length);
+
+    auto second = NetBufferChainNext(cb, head);
+    ASSERT_NE(nullptr, second);
+    auto third = NetBufferChainNext(cb, second);
+    ASSERT_NE(nullptr, third);
+    EXPECT_EQ(nullptr, NetBufferChainNext(cb, third));
+    EXPECT_EQ(8, third->user_data_length);
+
+    /* members belong to the head */
+    EXPECT_EQ(-1, NetBufferRelease(cb, second));
+
+    std::vector<uint8_t> out(40);
+    EXPECT_EQ(40, NetBufferReadChain(cb, head, 0, out.data(), out.size()));
+    EXPECT_EQ(data, out);
+
+    /* reads across a buffer boundary */
+    std::vector<uint8_t> mid(10);
+    EXPECT_EQ(10, NetBufferReadChain(cb, head, 12, mid.data(), mid.size()));
+    EXPECT_TRUE(std::equal(mid.begin(), mid.end(), data.begin() + 12));
+    EXPECT_EQ(4, NetBufferReadChain(cb, head, 36, mid.data(), mid.size()));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, head));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST_P(NetBufferChainModes, ReleaseBulk)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(8, 16, GetParam());
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    const auto data = pattern(32);
+    net_buffer_t* heads[3];
+    for (auto& head : heads) {
+        head = NetBufferRequest(cb);
+        ASSERT_NE(nullptr, head);
+    }
+    EXPECT_EQ(32, NetBufferWriteChain(cb, heads[1], data.data(), data.size()));
+    EXPECT_EQ(4, NetBufferGetUsedCount(cb));
+
+    EXPECT_EQ(3, NetBufferReleaseBulk(cb, heads, 3));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST_P(NetBufferChainModes, Exhausted)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(3, 16, GetParam());
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    const auto data = pattern(64);
+    auto head = NetBufferRequest(cb);
+    EXPECT_EQ(-1, NetBufferWriteChain(cb, head, data.data(), data.size()));
+
+    /* the partial chain went back to the pool */
+    EXPECT_EQ(1, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(nullptr, NetBufferChainNext(cb, head));
+
+    /* a shorter rewrite fits */
+    EXPECT_EQ(48, NetBufferWriteChain(cb, head, data.data(), 48));
+    EXPECT_EQ(3, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(8, NetBufferWriteChain(cb, head, data.data(), 8));
+    EXPECT_EQ(1, NetBufferGetUsedCount(cb));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, head));
+    NetBufferDeinit(cb);
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, NetBufferChainModes,
+    Values(0u, NETBUF_F_LINKED_USED_LIST, NETBUF_F_CONCURRENT, NETBUF_F_SPLIT_META));
+
+TEST(NetBufferChain, Writev)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 8, 16));
+
+    const auto data = pattern(100);
+    auto head = NetBufferRequest(cb);
+    ASSERT_EQ(100, NetBufferWriteChain(cb, head, data.data(), data.size()));
+
+    struct iovec iov[8];
+    EXPECT_EQ(-1, NetBufferChainToIovec(cb, head, iov, 6));
+    ASSERT_EQ(7, NetBufferChainToIovec(cb, head, iov, 8));
+
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    EXPECT_EQ(100, writev(fds[0], iov, 7));
+
+    std::vector<uint8_t> out(100);
+    EXPECT_EQ(100, read(fds[1], out.data(), out.size()));
+    EXPECT_EQ(data, out);
+
+    close(fds[0]);
+    close(fds[1]);
+
+    EXPECT_EQ(0, NetBufferRelease(cb, head));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferChain, MagazineRejectsChains)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 8, 16));
+
+    net_buffer_magazine_t mag[1];
+    net_buffer_magazine_config_t mcfg = { 4, 0, 0, 0 };
+    ASSERT_EQ(0, NetBufferMagazineInit(mag, cb, &mcfg));
+
+    const auto data = pattern(20);
+    auto head = NetBufferMagazineRequest(mag);
+    ASSERT_NE(nullptr, head);
+
+    /* neither the magazine nor the pool would take the chain back */
+    EXPECT_EQ(-1, NetBufferWriteChain(cb, head, data.data(), data.size()));
+    EXPECT_EQ(nullptr, NetBufferChainNext(cb, head));
+
+    /* what fits in the head is fine */
+    ASSERT_EQ(16, NetBufferWriteChain(cb, head, data.data(), 16));
+    EXPECT_EQ(0, NetBufferMagazineRelease(mag, head));
+
+    EXPECT_EQ(0, NetBufferMagazineDeinit(mag));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+    NetBufferDeinit(cb);
+}
+
+} // namespace
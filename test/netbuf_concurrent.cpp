@@ -0,0 +1,180 @@
+#include <gmock/gmock.h>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+#include "netbuf_test.h"
+
+namespace {
+
+TEST(NetBufferConcurrent, Init)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 16, NETBUF_F_CONCURRENT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    EXPECT_EQ(nullptr, cb->free_list);
+    EXPECT_EQ(nullptr, cb->used_list);
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferConcurrent, RejectsLinkedUsedList)
+{
+    net_buffer_cb_t cb[1];
+    auto cfg = pool_cfg(4, 16, NETBUF_F_CONCURRENT);
+    cfg.flags |= NETBUF_F_LINKED_USED_LIST;
+    EXPECT_EQ(-1, NetBufferInitEx(cb, &cfg));
+}
+
+TEST(NetBufferConcurrent, RequestAll)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(16, 8, NETBUF_F_CONCURRENT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    std::set<net_buffer_t*> seen;
+    for (size_t i = 0; i < 16; ++i) {
+        auto buffer = NetBufferRequest(cb);
+        ASSERT_NE(nullptr, buffer);
+        EXPECT_TRUE(seen.insert(buffer).second);
+    }
+
+    EXPECT_EQ(nullptr, NetBufferRequest(cb));
+    EXPECT_EQ(16, NetBufferGetUsedCount(cb));
+
+    /* the order is not tracked */
+    EXPECT_EQ(nullptr, NetBufferGetLRU(cb));
+
+    for (auto buffer : seen) {
+        EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    }
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferConcurrent, DoubleRelease)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 8, NETBUF_F_CONCURRENT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto buffer = NetBufferRequest(cb);
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(-1, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    net_buffer_t foreign = {};
+    EXPECT_EQ(-1, NetBufferRelease(cb, &foreign));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferConcurrent, Stress)
+{
+    const size_t num_threads = 8;
+    const size_t num_iterations = 20000;
+    const size_t num_buffers = 32;
+
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(num_buffers, sizeof(size_t), NETBUF_F_CONCURRENT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    std::atomic<size_t> failures = 0;
+
+    auto worker = [&](size_t tid) {
+        std::vector<net_buffer_t*> held;
+        for (size_t i = 0; i < num_iterations; ++i) {
+            /* hold a few buffers at a time so releases happen out of order */
+            if (held.size() < 3) {
+                auto buffer = NetBufferRequest(cb);
+                if (!buffer) {
+                    continue;
+                }
+
+                /* stamp the buffer, if anyone else owns it we'll notice */
+                const size_t stamp = (tid << 32) | i;
+                memcpy(buffer->user_data, &stamp, sizeof(stamp));
+                buffer->id = (uint32_t)i;
+                held.push_back(buffer);
+            } else {
+                auto buffer = held[i % held.size()];
+                held.erase(held.begin() + (i % held.size()));
+
+                size_t stamp;
+                memcpy(&stamp, buffer->user_data, sizeof(stamp));
+                if (stamp != ((tid << 32) | buffer->id)) {
+                    failures++;
+                }
+                if (NetBufferRelease(cb, buffer) != 0) {
+                    failures++;
+                }
+            }
+        }
+
+        for (auto buffer : held) {
+            if (NetBufferRelease(cb, buffer) != 0) {
+                failures++;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back(worker, t);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(0, failures.load());
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    /* every buffer made it back to the free list exactly once */
+    std::set<net_buffer_t*> seen;
+    for (size_t i = 0; i < num_buffers; ++i) {
+        auto buffer = NetBufferRequest(cb);
+        ASSERT_NE(nullptr, buffer);
+        EXPECT_TRUE(seen.insert(buffer).second);
+    }
+    EXPECT_EQ(nullptr, NetBufferRequest(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferConcurrent, RacingDoubleRelease)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 8, NETBUF_F_CONCURRENT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    for (size_t i = 0; i < 1000; ++i) {
+        auto buffer = NetBufferRequest(cb);
+        ASSERT_NE(nullptr, buffer);
+
+        std::atomic<int> wins = 0;
+        auto release = [&] {
+            if (NetBufferRelease(cb, buffer) == 0) {
+                wins++;
+            }
+        };
+        std::thread a(release), b(release);
+        a.join();
+        b.join();
+
+        ASSERT_EQ(1, wins.load());
+        ASSERT_EQ(0, NetBufferGetUsedCount(cb));
+    }
+
+    NetBufferDeinit(cb);
+}
+
+} // namespace
@@ -0,0 +1,201 @@
+#include <gmock/gmock.h>
+#include <cstring>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+#include "netbuf_test.h"
+
+namespace {
+
+net_buffer_config_t headroom_cfg(size_t n, size_t size, size_t headroom, uint32_t flags)
+{
+    auto cfg = pool_cfg(n, size, flags);
+    cfg.headroom = headroom;
+    return cfg;
+}
+
+class NetBufferHeadroomModes : public TestWithParam<uint32_t> { };
+
+TEST_P(NetBufferHeadroomModes, Request)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = headroom_cfg(4, 32, 16, GetParam());
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto buffer = NetBufferRequest(cb);
+    ASSERT_NE(nullptr, buffer);
+    EXPECT_EQ(16, NetBufferHeadroom(buffer));
+    EXPECT_EQ(32, NetBufferTailroom(cb, buffer));
+    EXPECT_EQ(32, NetBufferGetCapacity(cb, buffer));
+    EXPECT_EQ(0, buffer->user_data_length);
+    EXPECT_EQ(NetBufferHead(cb, buffer) + 16, NetBufferData(cb, buffer));
+
+    /* the whole requested size is still writable */
+    char data[32];
+    memset(data, 'x', sizeof(data));
+    EXPECT_EQ(32, NetBufferWriteChecked(cb, buffer, data, sizeof(data)));
+    EXPECT_EQ(-1, NetBufferWriteChecked(cb, buffer, data, sizeof(data) + 1));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    NetBufferDeinit(cb);
+}
+
+TEST_P(NetBufferHeadroomModes, EncapsulateDecapsulate)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = headroom_cfg(4, 16, 8, GetParam());
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto buffer = NetBufferRequest(cb);
+    ASSERT_NE(nullptr, buffer);
+
+    uint8_t* payload = NetBufferPut(cb, buffer, 5);
+    ASSERT_NE(nullptr, payload);
+    memcpy(payload, "frame", 5);
+
+    /* prepend a header in front of the payload, which doesn't move */
+    uint8_t* header = NetBufferPush(cb, buffer, 4);
+    ASSERT_NE(nullptr, header);
+    EXPECT_EQ(payload - 4, header);
+    memcpy(header, "HDR:", 4);
+    EXPECT_EQ(9, buffer->user_data_length);
+    EXPECT_EQ(0, memcmp("HDR:frame", NetBufferData(cb, buffer), 9));
+    EXPECT_EQ(4, NetBufferHeadroom(buffer));
+
+    EXPECT_EQ(nullptr, NetBufferPush(cb, buffer, 5));
+
+    /* and strip it again */
+    EXPECT_EQ(payload, NetBufferPull(cb, buffer, 4));
+    EXPECT_EQ(5, buffer->user_data_length);
+    EXPECT_EQ(nullptr, NetBufferPull(cb, buffer, 6));
+
+    NetBufferTrim(buffer, 3);
+    EXPECT_EQ(3, buffer->user_data_length);
+    NetBufferTrim(buffer, 10);
+    EXPECT_EQ(3, buffer->user_data_length);
+
+    /* the tail ends where the requested size ends */
+    EXPECT_EQ(13, NetBufferTailroom(cb, buffer));
+    EXPECT_EQ(payload + 3, NetBufferPut(cb, buffer, 13));
+    EXPECT_EQ(nullptr, NetBufferPut(cb, buffer, 1));
+
+    /* a new request starts over */
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    net_buffer_t* all[4];
+    ASSERT_EQ(4, NetBufferRequestBulk(cb, all, 4));
+    for (auto b : all) {
+        EXPECT_EQ(8, NetBufferHeadroom(b));
+        EXPECT_EQ(0, b->user_data_length);
+    }
+    EXPECT_EQ(4, NetBufferReleaseBulk(cb, all, 4));
+
+    NetBufferDeinit(cb);
+}
+
+TEST_P(NetBufferHeadroomModes, DataAlignment)
+{
+    for (size_t headroom : { 0, 2, 16, 64 }) {
+        net_buffer_cb_t cb[1];
+        const auto cfg = headroom_cfg(4, 24, headroom, GetParam());
+        ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+        const size_t align = NetBufferGetDataAlignment(cb);
+        EXPECT_EQ(0u, align & (align - 1)) << align;
+        if (headroom == 2) {
+            EXPECT_EQ(2u, align);
+        }
+
+        net_buffer_t* all[4];
+        ASSERT_EQ(4, NetBufferRequestBulk(cb, all, 4));
+        for (auto buffer : all) {
+            EXPECT_EQ(0u, (uintptr_t)NetBufferData(cb, buffer) % align) << "headroom " << headroom;
+        }
+        EXPECT_EQ(4, NetBufferReleaseBulk(cb, all, 4));
+        NetBufferDeinit(cb);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, NetBufferHeadroomModes,
+    Values(0u, NETBUF_F_LINKED_USED_LIST, NETBUF_F_CONCURRENT, NETBUF_F_SPLIT_META, NETBUF_F_CACHE_ALIGNED));
+
+TEST(NetBufferHeadroom, Classes)
+{
+    const net_buffer_class_config_t classes[] = { { 8, 2 }, { 64, 2 } };
+    net_buffer_config_t cfg = {};
+    cfg.classes = classes;
+    cfg.num_classes = 2;
+    cfg.headroom = 4;
+
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto small = NetBufferRequestSized(cb, 8);
+    ASSERT_NE(nullptr, small);
+    EXPECT_EQ(0, small->size_class);
+    EXPECT_EQ(8, NetBufferTailroom(cb, small));
+    EXPECT_NE(nullptr, NetBufferPush(cb, small, 4));
+    EXPECT_EQ(12, NetBufferGetCapacity(cb, small));
+
+    /* both classes keep it */
+    EXPECT_EQ(4u, NetBufferGetDataAlignment(cb));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, small));
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferHeadroom, ClonesHaveTheirOwnWindow)
+{
+    net_buffer_cb_t cb[1];
+    auto cfg = headroom_cfg(4, 16, 4, NETBUF_F_REFCOUNT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto buffer = NetBufferRequest(cb);
+    memcpy(NetBufferPut(cb, buffer, 8), "tunneled", 8);
+    memcpy(NetBufferPush(cb, buffer, 4), "UDP:", 4);
+
+    auto clone = NetBufferClone(cb, buffer);
+    ASSERT_NE(nullptr, clone);
+    EXPECT_EQ(NetBufferData(cb, buffer), NetBufferData(cb, clone));
+
+    /* decapsulating the clone leaves the original alone */
+    EXPECT_NE(nullptr, NetBufferPull(cb, clone, 4));
+    EXPECT_EQ(0, memcmp("tunneled", NetBufferData(cb, clone), 8));
+    EXPECT_EQ(12, buffer->user_data_length);
+    EXPECT_EQ(0, memcmp("UDP:tunneled", NetBufferData(cb, buffer), 12));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(0, NetBufferRelease(cb, clone));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferHeadroom, PulledCloneTailroom)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = headroom_cfg(4, 16, 8, NETBUF_F_REFCOUNT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto buffer = NetBufferRequest(cb);
+    ASSERT_NE(nullptr, NetBufferPut(cb, buffer, 16));
+    auto clone = NetBufferClone(cb, buffer);
+    ASSERT_NE(nullptr, clone);
+
+    /* the shared payload is full, pulling doesn't make room at the end */
+    EXPECT_NE(nullptr, NetBufferPull(cb, clone, 8));
+    EXPECT_EQ(8, NetBufferGetCapacity(cb, clone));
+    EXPECT_EQ(0, NetBufferTailroom(cb, clone));
+    EXPECT_EQ(nullptr, NetBufferPut(cb, clone, 1));
+    EXPECT_EQ(-1, NetBufferWriteChecked(cb, clone, "123456789", 9));
+
+    /* the owner's window is untouched */
+    EXPECT_EQ(16, NetBufferGetCapacity(cb, buffer));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, clone));
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    NetBufferDeinit(cb);
+}
+
+} // namespace
@@ -0,0 +1,232 @@
+#include <gmock/gmock.h>
+#include <thread>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+#include "netbuf_test.h"
+
+namespace {
+
+#if NETBUF_HOLD_HIST
+
+/* hold times are faked by moving the request timestamp back. whole seconds
+ * dwarf the resolution of the coarse clock */
+const uint64_t SECOND = 1000000000;
+
+void hold_for(net_buffer_cb_t* cb, uint64_t d)
+{
+    auto buffer = NetBufferRequest(cb);
+    ASSERT_NE(nullptr, buffer);
+    buffer->timestamp -= d;
+    ASSERT_EQ(0, NetBufferRelease(cb, buffer));
+}
+
+TEST(NetBufferHist, Buckets)
+{
+    net_buffer_hist_t hist = {};
+    EXPECT_EQ(0u, NetBufferHistPercentile(&hist, 0.5));
+
+    /* small values are exact */
+    hist.count[3] = 1;
+    EXPECT_EQ(3u, NetBufferHistPercentile(&hist, 0.5));
+
+    /* 8 and 9 share a bucket */
+    hist.count[3] = 0;
+    hist.count[8] = 2;
+    EXPECT_EQ(9u, NetBufferHistPercentile(&hist, 0.5));
+    EXPECT_EQ(2u, NetBufferHistCount(&hist));
+
+    /* the last bucket reaches the top of the range */
+    hist.count[8] = 0;
+    hist.count[NETBUF_HIST_BUCKETS - 1] = 1;
+    EXPECT_EQ(UINT64_MAX, NetBufferHistPercentile(&hist, 0.5));
+}
+
+TEST(NetBufferHist, OnlyWithTimestamps)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 4, 8));
+    EXPECT_EQ(nullptr, NetBufferGetHoldHist(cb));
+    EXPECT_EQ(nullptr, NetBufferGetIfHoldHist(cb, 0, 0));
+    NetBufferResetHoldHist(cb);
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferHist, Percentiles)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 8, NETBUF_F_TIMESTAMP);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    for (uint64_t i = 1; i <= 1000; ++i) {
+        hold_for(cb, i * SECOND);
+    }
+
+    const auto hist = NetBufferGetHoldHist(cb);
+    ASSERT_NE(nullptr, hist);
+    EXPECT_EQ(1000u, NetBufferHistCount(hist));
+
+    /* within a bucket width, at most 25% above the exact value */
+    const auto p50 = NetBufferHistPercentile(hist, 0.5);
+    const auto p99 = NetBufferHistPercentile(hist, 0.99);
+    const auto p999 = NetBufferHistPercentile(hist, 0.999);
+    EXPECT_GE(p50, 500 * SECOND);
+    EXPECT_LE(p50, 625 * SECOND);
+    EXPECT_GE(p99, 990 * SECOND);
+    EXPECT_LE(p99, 1250 * SECOND);
+    EXPECT_GE(p999, 999 * SECOND);
+    EXPECT_LE(p999, 1250 * SECOND);
+    EXPECT_LE(p50, p99);
+    EXPECT_LE(p99, p999);
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferHist, PerInterface)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 8, NETBUF_F_TIMESTAMP);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto can = NetBufferRequest(cb);
+    can->if_type = 1;
+    can->if_id = 0;
+    can->timestamp -= 2 * SECOND;
+
+    auto eth = NetBufferRequest(cb);
+    eth->if_type = 2;
+    eth->if_id = -1;
+    eth->timestamp -= 100 * SECOND;
+
+    NetBufferRelease(cb, can);
+    NetBufferRelease(cb, eth);
+
+    const auto can_hist = NetBufferGetIfHoldHist(cb, 1, 0);
+    const auto eth_hist = NetBufferGetIfHoldHist(cb, 2, -1);
+    ASSERT_NE(nullptr, can_hist);
+    ASSERT_NE(nullptr, eth_hist);
+    EXPECT_EQ(1u, NetBufferHistCount(can_hist));
+    EXPECT_EQ(1u, NetBufferHistCount(eth_hist));
+    EXPECT_GT(100 * SECOND, NetBufferHistPercentile(can_hist, 0.5));
+    EXPECT_LE(100 * SECOND, NetBufferHistPercentile(eth_hist, 0.5));
+    EXPECT_EQ(2u, NetBufferHistCount(NetBufferGetHoldHist(cb)));
+
+    EXPECT_EQ(nullptr, NetBufferGetIfHoldHist(cb, 1, 1));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferHist, InterfaceSlotsRunOut)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 8, NETBUF_F_TIMESTAMP);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    for (int i = 0; i < NETBUF_HOLD_IFACES + 2; ++i) {
+        auto buffer = NetBufferRequest(cb);
+        buffer->if_type = 0;
+        buffer->if_id = (int8_t)i;
+        NetBufferRelease(cb, buffer);
+    }
+
+    EXPECT_NE(nullptr, NetBufferGetIfHoldHist(cb, 0, NETBUF_HOLD_IFACES - 1));
+    EXPECT_EQ(nullptr, NetBufferGetIfHoldHist(cb, 0, NETBUF_HOLD_IFACES));
+    EXPECT_EQ((uint64_t)NETBUF_HOLD_IFACES + 2, NetBufferHistCount(NetBufferGetHoldHist(cb)));
+
+    /* a reset frees the slots */
+    NetBufferResetHoldHist(cb);
+    EXPECT_EQ(0u, NetBufferHistCount(NetBufferGetHoldHist(cb)));
+    EXPECT_EQ(nullptr, NetBufferGetIfHoldHist(cb, 0, 0));
+
+    auto buffer = NetBufferRequest(cb);
+    buffer->if_type = 0;
+    buffer->if_id = NETBUF_HOLD_IFACES;
+    NetBufferRelease(cb, buffer);
+    EXPECT_NE(nullptr, NetBufferGetIfHoldHist(cb, 0, NETBUF_HOLD_IFACES));
+
+    NetBufferDeinit(cb);
+}
+
+class NetBufferHistModes : public TestWithParam<uint32_t> { };
+
+TEST_P(NetBufferHistModes, BulkRelease)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(8, 8, NETBUF_F_TIMESTAMP | GetParam());
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    net_buffer_t* bufs[8];
+    ASSERT_EQ(8, NetBufferRequestBulk(cb, bufs, 8));
+    for (auto buffer : bufs) {
+        buffer->timestamp -= 10 * SECOND;
+    }
+    EXPECT_EQ(8, NetBufferReleaseBulk(cb, bufs, 8));
+
+    const auto hist = NetBufferGetHoldHist(cb);
+    EXPECT_EQ(8u, NetBufferHistCount(hist));
+    EXPECT_LE(10 * SECOND, NetBufferHistPercentile(hist, 0.5));
+
+    NetBufferDeinit(cb);
+}
+
+INSTANTIATE_TEST_SUITE_P(Pools, NetBufferHistModes,
+    Values(0u, NETBUF_F_LINKED_USED_LIST, NETBUF_F_CONCURRENT, NETBUF_F_REFCOUNT));
+
+TEST(NetBufferHist, ConcurrentReleases)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(16, 8, NETBUF_F_TIMESTAMP | NETBUF_F_CONCURRENT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    const size_t num_threads = 4;
+    const size_t num_iterations = 5000;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> served = 0;
+
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t i = 0; i < num_iterations; ++i) {
+                if (auto buffer = NetBufferRequest(cb)) {
+                    buffer->if_type = 0;
+                    buffer->if_id = (int8_t)t;
+                    served++;
+                    NetBufferRelease(cb, buffer);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(served.load(), NetBufferHistCount(NetBufferGetHoldHist(cb)));
+    uint64_t per_iface = 0;
+    for (size_t t = 0; t < num_threads; ++t) {
+        per_iface += NetBufferHistCount(NetBufferGetIfHoldHist(cb, 0, (int8_t)t));
+    }
+    EXPECT_EQ(served.load(), per_iface);
+
+    NetBufferDeinit(cb);
+}
+
+#else
+
+TEST(NetBufferHist, CompiledOut)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 8, NETBUF_F_TIMESTAMP);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, NetBufferRequest(cb)));
+    EXPECT_EQ(nullptr, NetBufferGetHoldHist(cb));
+
+    NetBufferDeinit(cb);
+}
+
+#endif
+
+} // namespace
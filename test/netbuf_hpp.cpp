@@ -0,0 +1,167 @@
+#include <gmock/gmock.h>
+#include <array>
+#include <type_traits>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.hpp"
+
+namespace {
+
+using SmallPool = netbuf::Pool<4, 16>;
+
+static_assert(!std::is_copy_constructible_v<netbuf::Handle>);
+static_assert(!std::is_copy_assignable_v<netbuf::Handle>);
+static_assert(std::is_nothrow_move_constructible_v<netbuf::Handle>);
+static_assert(std::is_nothrow_move_assignable_v<netbuf::Handle>);
+static_assert(!std::is_polymorphic_v<netbuf::Handle>);
+static_assert(sizeof(netbuf::Handle) == 2 * sizeof(void*));
+
+static_assert(SmallPool::num_buffers == 4);
+static_assert(SmallPool::buffer_size == 16);
+static_assert(!std::is_copy_constructible_v<SmallPool>);
+static_assert(!std::is_move_constructible_v<SmallPool>);
+static_assert(!std::is_polymorphic_v<SmallPool>);
+
+TEST(NetBufferHpp, ReleasedOnScopeExit)
+{
+    SmallPool pool;
+    EXPECT_EQ(4u, pool.available());
+
+    {
+        auto buffer = pool.request();
+        ASSERT_TRUE(buffer);
+        EXPECT_EQ(1u, pool.used());
+        EXPECT_EQ(NETBUF_STATE_USED, buffer->state);
+    }
+    EXPECT_EQ(0u, pool.used());
+}
+
+TEST(NetBufferHpp, EmptyWhenExhausted)
+{
+    SmallPool pool;
+
+    std::vector<netbuf::Handle> held;
+    for (size_t i = 0; i < SmallPool::num_buffers; ++i) {
+        held.push_back(pool.request());
+        ASSERT_TRUE(held.back());
+    }
+
+    auto none = pool.request();
+    EXPECT_FALSE(none);
+    EXPECT_EQ(nullptr, none.get());
+
+    /* dropping one makes room again */
+    held.pop_back();
+    EXPECT_TRUE(pool.request());
+    EXPECT_EQ(3u, pool.used());
+
+    held.clear();
+    EXPECT_EQ(0u, pool.used());
+}
+
+TEST(NetBufferHpp, Move)
+{
+    SmallPool pool;
+
+    auto a = pool.request();
+    auto raw = a.get();
+
+    netbuf::Handle b = std::move(a);
+    EXPECT_FALSE(a);
+    EXPECT_EQ(raw, b.get());
+    EXPECT_EQ(1u, pool.used());
+
+    /* assigning over a handle releases what it held */
+    netbuf::Handle c = pool.request();
+    EXPECT_EQ(2u, pool.used());
+    c = std::move(b);
+    EXPECT_EQ(raw, c.get());
+    EXPECT_EQ(1u, pool.used());
+
+    c = std::move(c);
+    EXPECT_EQ(raw, c.get());
+
+    c.reset();
+    EXPECT_FALSE(c);
+    EXPECT_EQ(0u, pool.used());
+}
+
+TEST(NetBufferHpp, ReleaseOwnership)
+{
+    SmallPool pool;
+
+    net_buffer_t* raw;
+    {
+        auto buffer = pool.request();
+        raw = buffer.release();
+        EXPECT_FALSE(buffer);
+    }
+    EXPECT_EQ(1u, pool.used());
+    EXPECT_EQ(0, NetBufferRelease(pool.native(), raw));
+
+    /* and back */
+    {
+        netbuf::Handle adopted(pool.native(), NetBufferRequest(pool.native()));
+        EXPECT_EQ(pool.native(), adopted.pool());
+        EXPECT_EQ(1u, pool.used());
+    }
+    EXPECT_EQ(0u, pool.used());
+}
+
+TEST(NetBufferHpp, Data)
+{
+    SmallPool pool;
+
+    auto buffer = pool.request();
+    EXPECT_EQ(16u, buffer.capacity());
+    EXPECT_EQ(0u, buffer.size());
+
+    EXPECT_EQ(5, buffer.write("hello", 5));
+    EXPECT_EQ(5u, buffer.size());
+    EXPECT_EQ(0, memcmp(buffer.data(), "hello", 5));
+
+    const std::array<uint8_t, 17> big {};
+    EXPECT_EQ(-1, buffer.write(big.data(), big.size()));
+}
+
+TEST(NetBufferHpp, RequestWith)
+{
+    SmallPool pool;
+
+    struct frame {
+        uint32_t id;
+        uint8_t data[8];
+    };
+    const frame f = { 0x123, { 1, 2, 3, 4, 5, 6, 7, 8 } };
+
+    auto buffer = pool.request_with(f);
+    ASSERT_TRUE(buffer);
+    EXPECT_EQ(sizeof(frame), buffer.size());
+    EXPECT_EQ(0, memcmp(buffer.data(), &f, sizeof(f)));
+
+    const std::array<uint8_t, 16> full {};
+    EXPECT_TRUE(pool.request_with(full));
+}
+
+TEST(NetBufferHpp, SeveralPools)
+{
+    netbuf::Pool<2, 8> a;
+    netbuf::Pool<3, 64> b;
+
+    auto x = a.request();
+    auto y = b.request();
+    EXPECT_EQ(a.native(), x.pool());
+    EXPECT_EQ(b.native(), y.pool());
+    EXPECT_EQ(64u, y.capacity());
+
+    /* a handle moved across pools still releases to its own */
+    x = std::move(y);
+    EXPECT_EQ(0u, a.used());
+    EXPECT_EQ(1u, b.used());
+}
+
+} // namespace
@@ -0,0 +1,294 @@
+#include <gmock/gmock.h>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+#include "netbuf_test.h"
+
+namespace {
+
+enum { CAN = 1, ETH = 2 };
+
+/* 10 buffers: 2 reserved for can0 which may hold 4 at most, 3 for eth0, 5 shared */
+const net_buffer_iface_config_t ifaces[] = {
+    { CAN, 0, 2, 4 },
+    { ETH, 0, 3, 0 },
+};
+
+net_buffer_config_t iface_cfg(uint32_t flags = 0)
+{
+    auto cfg = pool_cfg(10, 16, flags);
+    cfg.ifaces = ifaces;
+    cfg.num_ifaces = 2;
+    return cfg;
+}
+
+std::vector<net_buffer_t*> drain(net_buffer_cb_t* cb, int iface)
+{
+    std::vector<net_buffer_t*> out;
+    while (auto buffer = iface < 0 ? NetBufferRequest(cb) : NetBufferRequestIface(cb, (size_t)iface)) {
+        out.push_back(buffer);
+    }
+    return out;
+}
+
+void release_all(net_buffer_cb_t* cb, const std::vector<net_buffer_t*>& bufs)
+{
+    for (auto buffer : bufs) {
+        EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    }
+}
+
+TEST(NetBufferIface, Init)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = iface_cfg();
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    EXPECT_TRUE(cb->flags & NETBUF_F_LINKED_USED_LIST);
+    EXPECT_EQ(0, NetBufferFindIface(cb, CAN, 0));
+    EXPECT_EQ(1, NetBufferFindIface(cb, ETH, 0));
+    EXPECT_EQ(-1, NetBufferFindIface(cb, CAN, 1));
+    EXPECT_EQ(0, NetBufferGetIfaceUsedCount(cb, 0));
+    EXPECT_EQ(-1, NetBufferGetIfaceUsedCount(cb, 2));
+    EXPECT_EQ(nullptr, NetBufferGetIfaceLRU(cb, 0));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferIface, InvalidConfig)
+{
+    net_buffer_cb_t cb[1];
+
+    /* reservations larger than the pool */
+    auto cfg = iface_cfg();
+    cfg.num_buffers = 4;
+    EXPECT_EQ(-1, NetBufferInitEx(cb, &cfg));
+
+    /* max below min */
+    const net_buffer_iface_config_t low_max[] = { { CAN, 0, 3, 2 } };
+    cfg = iface_cfg();
+    cfg.ifaces = low_max;
+    cfg.num_ifaces = 1;
+    EXPECT_EQ(-1, NetBufferInitEx(cb, &cfg));
+
+    /* the same interface twice */
+    const net_buffer_iface_config_t twice[] = { { CAN, 0, 1, 0 }, { CAN, 0, 1, 0 } };
+    cfg.ifaces = twice;
+    cfg.num_ifaces = 2;
+    EXPECT_EQ(-1, NetBufferInitEx(cb, &cfg));
+
+    cfg = iface_cfg(NETBUF_F_CONCURRENT);
+    EXPECT_EQ(-1, NetBufferInitEx(cb, &cfg));
+    cfg = iface_cfg(NETBUF_F_PRIORITY);
+    EXPECT_EQ(-1, NetBufferInitEx(cb, &cfg));
+    cfg = iface_cfg();
+    cfg.num_ifaces = 0;
+    EXPECT_EQ(-1, NetBufferInitEx(cb, &cfg));
+}
+
+TEST(NetBufferIface, RequestTagsBuffer)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = iface_cfg();
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto buffer = NetBufferRequestIface(cb, 1);
+    ASSERT_NE(nullptr, buffer);
+    EXPECT_EQ(ETH, buffer->if_type);
+    EXPECT_EQ(0, buffer->if_id);
+    EXPECT_EQ(1, buffer->iface);
+    EXPECT_EQ(1, NetBufferGetIfaceUsedCount(cb, 1));
+    EXPECT_EQ(1, NetBufferGetUsedCount(cb));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(NETBUF_NO_IFACE, buffer->iface);
+    EXPECT_EQ(0, NetBufferGetIfaceUsedCount(cb, 1));
+    EXPECT_EQ(nullptr, NetBufferRequestIface(cb, 2));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferIface, ChattyInterfaceCantStarveOthers)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = iface_cfg();
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    /* eth0 has no cap: its 3 reserved and the 5 shared ones */
+    const auto eth = drain(cb, 1);
+    EXPECT_EQ(8u, eth.size());
+    EXPECT_EQ(nullptr, NetBufferRequest(cb));
+
+    /* can0 still gets its reservation */
+    const auto can = drain(cb, 0);
+    EXPECT_EQ(2u, can.size());
+    EXPECT_EQ(10, NetBufferGetUsedCount(cb));
+
+    release_all(cb, eth);
+    release_all(cb, can);
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferIface, MaxCapsSharedUse)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = iface_cfg();
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    const auto can = drain(cb, 0);
+    EXPECT_EQ(4u, can.size());
+
+    /* can0 took 2 of the 5 shared buffers */
+    const auto untagged = drain(cb, -1);
+    EXPECT_EQ(3u, untagged.size());
+    const auto eth = drain(cb, 1);
+    EXPECT_EQ(3u, eth.size());
+
+    /* a buffer past the reservation goes back to the shared ones, for
+     * whoever asks first */
+    EXPECT_EQ(0, NetBufferRelease(cb, can[0]));
+    auto extra = NetBufferRequestIface(cb, 1);
+    EXPECT_NE(nullptr, extra);
+    EXPECT_EQ(nullptr, NetBufferRequestIface(cb, 0));
+    EXPECT_EQ(0, NetBufferRelease(cb, extra));
+    auto again = NetBufferRequestIface(cb, 0);
+    EXPECT_NE(nullptr, again);
+    EXPECT_EQ(nullptr, NetBufferRequestIface(cb, 0));
+
+    release_all(cb, { can.begin() + 1, can.end() });
+    release_all(cb, untagged);
+    release_all(cb, eth);
+    EXPECT_EQ(0, NetBufferRelease(cb, again));
+
+    /* everything is back where it started */
+    EXPECT_EQ(4u, drain(cb, 0).size());
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferIface, UntaggedOnlyGetShared)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = iface_cfg();
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    const auto untagged = drain(cb, -1);
+    EXPECT_EQ(5u, untagged.size());
+
+    net_buffer_t* bufs[4];
+    EXPECT_EQ(0, NetBufferRequestBulk(cb, bufs, 4));
+
+    /* reservations are intact */
+    EXPECT_EQ(2u, drain(cb, 0).size());
+    EXPECT_EQ(3u, drain(cb, 1).size());
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferIface, BulkStopsAtShared)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = iface_cfg();
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    net_buffer_t* bufs[10];
+    EXPECT_EQ(5, NetBufferRequestBulk(cb, bufs, 10));
+    EXPECT_EQ(5, NetBufferReleaseBulk(cb, bufs, 5));
+    EXPECT_EQ(5, NetBufferRequestBulk(cb, bufs, 10));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferIface, LruPerInterface)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = iface_cfg();
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto can_a = NetBufferRequestIface(cb, 0);
+    auto eth_a = NetBufferRequestIface(cb, 1);
+    auto can_b = NetBufferRequestIface(cb, 0);
+    auto eth_b = NetBufferRequestIface(cb, 1);
+
+    EXPECT_EQ(can_a, NetBufferGetIfaceLRU(cb, 0));
+    EXPECT_EQ(eth_a, NetBufferGetIfaceLRU(cb, 1));
+    EXPECT_EQ(can_a, NetBufferGetLRU(cb));
+
+    /* out of order releases stay O(1) */
+    EXPECT_EQ(0, NetBufferRelease(cb, can_b));
+    EXPECT_EQ(0, NetBufferRelease(cb, eth_a));
+    EXPECT_EQ(eth_b, NetBufferGetIfaceLRU(cb, 1));
+    EXPECT_EQ(0, NetBufferRelease(cb, can_a));
+    EXPECT_EQ(nullptr, NetBufferGetIfaceLRU(cb, 0));
+    EXPECT_EQ(eth_b, NetBufferGetLRU(cb));
+
+    /* buffers without an interface come first */
+    auto untagged = NetBufferRequest(cb);
+    EXPECT_EQ(untagged, NetBufferGetLRU(cb));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, eth_b));
+    EXPECT_EQ(0, NetBufferRelease(cb, untagged));
+    EXPECT_EQ(-1, NetBufferRelease(cb, untagged));
+    EXPECT_EQ(nullptr, NetBufferGetLRU(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferIface, ReclaimEveryInterface)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = iface_cfg(NETBUF_F_TIMESTAMP);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto can = NetBufferRequestIface(cb, 0);
+    auto eth = NetBufferRequestIface(cb, 1);
+    auto fresh = NetBufferRequestIface(cb, 1);
+    can->timestamp -= 1000;
+    eth->timestamp -= 1000;
+
+    EXPECT_EQ(2, NetBufferReclaimOlderThan(cb, 500, nullptr, nullptr));
+    EXPECT_EQ(0, NetBufferGetIfaceUsedCount(cb, 0));
+    EXPECT_EQ(1, NetBufferGetIfaceUsedCount(cb, 1));
+    EXPECT_EQ(fresh, NetBufferGetLRU(cb));
+
+    NetBufferRelease(cb, fresh);
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferIface, LazyInit)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = iface_cfg(NETBUF_F_LAZY_INIT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    net_buffer_t* bufs[10];
+    EXPECT_EQ(5, NetBufferRequestBulk(cb, bufs, 10));
+    EXPECT_EQ(2u, drain(cb, 0).size());
+    EXPECT_EQ(3u, drain(cb, 1).size());
+    EXPECT_EQ(10, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferIface, NoMagazines)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = iface_cfg();
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    net_buffer_magazine_config_t mcfg = {};
+    mcfg.size = 4;
+    mcfg.refill = 2;
+    net_buffer_magazine_t mag;
+    EXPECT_EQ(-1, NetBufferMagazineInit(&mag, cb, &mcfg));
+
+    NetBufferDeinit(cb);
+}
+
+} // namespace
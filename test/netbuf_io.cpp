@@ -0,0 +1,237 @@
+#include <gmock/gmock.h>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+
+namespace {
+
+class NetBufferIo : public Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_DGRAM, 0, fds));
+        ASSERT_EQ(0, NetBufferInit(cb, 8, 64));
+    }
+
+    void TearDown() override
+    {
+        close(fds[0]);
+        close(fds[1]);
+        EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+        NetBufferDeinit(cb);
+    }
+
+    int fds[2];
+    net_buffer_cb_t cb[1];
+};
+
+TEST_F(NetBufferIo, RecvBatch)
+{
+    for (std::string msg : { "one", "two!", "three" }) {
+        ASSERT_EQ((ssize_t)msg.size(), send(fds[0], msg.data(), msg.size(), 0));
+    }
+
+    net_buffer_t* bufs[8];
+    ASSERT_EQ(3, NetBufferRecvBatch(cb, fds[1], bufs, 8, MSG_DONTWAIT));
+
+    /* the unused buffers went back */
+    EXPECT_EQ(3, NetBufferGetUsedCount(cb));
+    EXPECT_EQ("one", std::string((char*)NetBufferData(cb, bufs[0]), bufs[0]->user_data_length));
+    EXPECT_EQ("two!", std::string((char*)NetBufferData(cb, bufs[1]), bufs[1]->user_data_length));
+    EXPECT_EQ("three", std::string((char*)NetBufferData(cb, bufs[2]), bufs[2]->user_data_length));
+
+    EXPECT_EQ(3, NetBufferReleaseBulk(cb, bufs, 3));
+
+    /* nothing left to read */
+    EXPECT_EQ(-1, NetBufferRecvBatch(cb, fds[1], bufs, 8, MSG_DONTWAIT));
+    EXPECT_EQ(EAGAIN, errno);
+}
+
+TEST_F(NetBufferIo, RecvBatchPoolLimit)
+{
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_EQ(1, send(fds[0], "x", 1, 0));
+    }
+
+    net_buffer_t* bufs[16];
+    EXPECT_EQ(8, NetBufferRecvBatch(cb, fds[1], bufs, 16, MSG_DONTWAIT));
+    EXPECT_EQ(0, NetBufferRecvBatch(cb, fds[1], bufs + 8, 8, MSG_DONTWAIT));
+    EXPECT_EQ(8, NetBufferReleaseBulk(cb, bufs, 8));
+
+    EXPECT_EQ(2, NetBufferRecvBatch(cb, fds[1], bufs, 16, MSG_DONTWAIT));
+    EXPECT_EQ(2, NetBufferReleaseBulk(cb, bufs, 2));
+}
+
+TEST_F(NetBufferIo, RecvBatchShortReadKeepsUsedList)
+{
+    net_buffer_t* first = NetBufferRequest(cb);
+    ASSERT_NE(nullptr, first);
+    ASSERT_EQ(1, send(fds[0], "x", 1, 0));
+
+    net_buffer_t* bufs[8];
+    ASSERT_EQ(1, NetBufferRecvBatch(cb, fds[1], bufs, 7, MSG_DONTWAIT));
+    EXPECT_EQ(2, NetBufferGetUsedCount(cb));
+
+    /* the unused buffers left from the tail, the order is intact */
+    EXPECT_EQ(first, NetBufferGetLRU(cb));
+    EXPECT_EQ(0, NetBufferRelease(cb, first));
+    EXPECT_EQ(bufs[0], NetBufferGetLRU(cb));
+    EXPECT_EQ(0, NetBufferRelease(cb, bufs[0]));
+
+    /* and all of them can be requested again */
+    ASSERT_EQ(8, NetBufferRequestBulk(cb, bufs, 8));
+    EXPECT_EQ(8, NetBufferReleaseBulk(cb, bufs, 8));
+}
+
+TEST(NetBufferIoLinked, RecvBatchShortRead)
+{
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_DGRAM, 0, fds));
+
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 8;
+    cfg.buffer_size = 64;
+    cfg.flags = NETBUF_F_LINKED_USED_LIST;
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    net_buffer_t* first = NetBufferRequest(cb);
+    ASSERT_NE(nullptr, first);
+    ASSERT_EQ(1, send(fds[0], "x", 1, 0));
+
+    net_buffer_t* bufs[8];
+    ASSERT_EQ(1, NetBufferRecvBatch(cb, fds[1], bufs, 7, MSG_DONTWAIT));
+    EXPECT_EQ(2, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(first, NetBufferGetLRU(cb));
+    EXPECT_EQ(0, NetBufferRelease(cb, first));
+    EXPECT_EQ(bufs[0], NetBufferGetLRU(cb));
+    EXPECT_EQ(0, NetBufferRelease(cb, bufs[0]));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    close(fds[0]);
+    close(fds[1]);
+    NetBufferDeinit(cb);
+}
+
+#if NETBUF_STATS
+TEST_F(NetBufferIo, RecvBatchCountsReceivedOnly)
+{
+    ASSERT_EQ(1, send(fds[0], "x", 1, 0));
+
+    net_buffer_t* bufs[8];
+    ASSERT_EQ(1, NetBufferRecvBatch(cb, fds[1], bufs, 8, MSG_DONTWAIT));
+    EXPECT_EQ(-1, NetBufferRecvBatch(cb, fds[1], bufs + 1, 7, MSG_DONTWAIT));
+
+    net_buffer_stats_t stats;
+    ASSERT_EQ(0, NetBufferGetStats(cb, &stats));
+    EXPECT_EQ(1u, stats.requests);
+    EXPECT_EQ(0u, stats.releases);
+    EXPECT_EQ(0u, stats.failures);
+
+    EXPECT_EQ(0, NetBufferRelease(cb, bufs[0]));
+}
+#endif
+
+TEST_F(NetBufferIo, SendBatch)
+{
+    net_buffer_t* bufs[3];
+    ASSERT_EQ(3, NetBufferRequestBulk(cb, bufs, 3));
+    NetBufferWriteChecked(cb, bufs[0], "alpha", 5);
+    NetBufferWriteChecked(cb, bufs[1], "beta", 4);
+
+    /* a chain goes out as one datagram */
+    const std::string big(150, 'z');
+    ASSERT_EQ(150, NetBufferWriteChain(cb, bufs[2], big.data(), big.size()));
+
+    EXPECT_EQ(3, NetBufferSendBatch(cb, fds[0], bufs, 3, 0));
+    EXPECT_EQ(3, NetBufferReleaseBulk(cb, bufs, 3));
+
+    char out[256];
+    EXPECT_EQ(5, recv(fds[1], out, sizeof(out), MSG_DONTWAIT));
+    EXPECT_EQ(4, recv(fds[1], out, sizeof(out), MSG_DONTWAIT));
+    ASSERT_EQ(150, recv(fds[1], out, sizeof(out), MSG_DONTWAIT));
+    EXPECT_EQ(big, std::string(out, 150));
+}
+
+TEST_F(NetBufferIo, SendBatchChainTooLong)
+{
+    net_buffer_cb_t small[1];
+    ASSERT_EQ(0, NetBufferInit(small, NETBUF_IO_MAX_IOV + 2, 16));
+
+    net_buffer_t* bufs[2];
+    ASSERT_EQ(2, NetBufferRequestBulk(small, bufs, 2));
+    NetBufferWriteChecked(small, bufs[0], "x", 1);
+    const std::string big(16 * (NETBUF_IO_MAX_IOV + 1), 'z');
+    ASSERT_EQ((int)big.size(), NetBufferWriteChain(small, bufs[1], big.data(), big.size()));
+
+    /* only what comes before the long chain is sent */
+    EXPECT_EQ(1, NetBufferSendBatch(small, fds[0], bufs, 2, 0));
+
+    errno = 0;
+    EXPECT_EQ(-1, NetBufferSendBatch(small, fds[0], bufs + 1, 1, 0));
+    EXPECT_EQ(EMSGSIZE, errno);
+
+    /* nothing to send isn't an error */
+    EXPECT_EQ(0, NetBufferSendBatch(small, fds[0], bufs, 0, 0));
+
+    EXPECT_EQ(2, NetBufferReleaseBulk(small, bufs, 2));
+    EXPECT_EQ(0, NetBufferGetUsedCount(small));
+    NetBufferDeinit(small);
+}
+
+TEST(NetBufferIoUdp, Loopback)
+{
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(rx, 0);
+    ASSERT_GE(tx, 0);
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, bind(rx, (sockaddr*)&addr, sizeof(addr)));
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(0, getsockname(rx, (sockaddr*)&addr, &len));
+    ASSERT_EQ(0, connect(tx, (sockaddr*)&addr, sizeof(addr)));
+
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 16, 1500));
+
+    net_buffer_t* out[4];
+    ASSERT_EQ(4, NetBufferRequestBulk(cb, out, 4));
+    for (int i = 0; i < 4; ++i) {
+        const std::string msg = "datagram " + std::to_string(i);
+        NetBufferWriteChecked(cb, out[i], msg.data(), msg.size());
+    }
+    EXPECT_EQ(4, NetBufferSendBatch(cb, tx, out, 4, 0));
+    EXPECT_EQ(4, NetBufferReleaseBulk(cb, out, 4));
+
+    /* block for the first datagram only, then take whatever arrived */
+    net_buffer_t* in[16];
+    int got = 0;
+    while (got < 4) {
+        const int n = NetBufferRecvBatch(cb, rx, in + got, 16 - got, MSG_WAITFORONE);
+        ASSERT_GT(n, 0);
+        got += n;
+    }
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ("datagram " + std::to_string(i), std::string((char*)NetBufferData(cb, in[i]), in[i]->user_data_length));
+    }
+    EXPECT_EQ(4, NetBufferReleaseBulk(cb, in, 4));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+    close(rx);
+    close(tx);
+}
+
+} // namespace
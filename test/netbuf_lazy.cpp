@@ -0,0 +1,171 @@
+#include <gmock/gmock.h>
+#include <cstring>
+#include <set>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+#include "netbuf_test.h"
+
+namespace {
+
+class NetBufferLazyModes : public TestWithParam<uint32_t> { };
+
+TEST_P(NetBufferLazyModes, RequestAll)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(16, 32, GetParam() | NETBUF_F_LAZY_INIT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+    EXPECT_EQ(0, cb->lazy_next);
+
+    std::set<net_buffer_t*> seen;
+    for (size_t i = 0; i < 16; ++i) {
+        auto buffer = NetBufferRequest(cb);
+        ASSERT_NE(nullptr, buffer);
+        EXPECT_TRUE(seen.insert(buffer).second);
+        EXPECT_EQ(NETBUF_NO_INDEX, buffer->chain_next);
+        EXPECT_EQ(0, buffer->user_data_length);
+    }
+    EXPECT_EQ(16, cb->lazy_next);
+    EXPECT_EQ(nullptr, NetBufferRequest(cb));
+    EXPECT_EQ(16, NetBufferGetUsedCount(cb));
+
+    /* released buffers come back through the free list */
+    auto some = *seen.begin();
+    EXPECT_EQ(0, NetBufferRelease(cb, some));
+    EXPECT_EQ(some, NetBufferRequest(cb));
+
+    for (auto buffer : seen) {
+        EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    }
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST_P(NetBufferLazyModes, Bulk)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(16, 32, GetParam() | NETBUF_F_LAZY_INIT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    /* half recycled, half never used */
+    net_buffer_t* first[4];
+    ASSERT_EQ(4, NetBufferRequestBulk(cb, first, 4));
+    ASSERT_EQ(4, NetBufferReleaseBulk(cb, first, 4));
+
+    net_buffer_t* all[20];
+    EXPECT_EQ(16, NetBufferRequestBulk(cb, all, 20));
+    std::set<net_buffer_t*> seen(all, all + 16);
+    EXPECT_EQ(16, seen.size());
+    EXPECT_EQ(16, NetBufferGetUsedCount(cb));
+
+    EXPECT_EQ(16, NetBufferReleaseBulk(cb, all, 16));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST_P(NetBufferLazyModes, Magazine)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(16, 32, GetParam() | NETBUF_F_LAZY_INIT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    net_buffer_magazine_t mag[1];
+    const net_buffer_magazine_config_t mcfg = { 4, 0, 0, 0 };
+    ASSERT_EQ(0, NetBufferMagazineInit(mag, cb, &mcfg));
+
+    std::set<net_buffer_t*> seen;
+    while (auto buffer = NetBufferMagazineRequest(mag)) {
+        EXPECT_TRUE(seen.insert(buffer).second);
+    }
+    EXPECT_EQ(16, seen.size());
+    for (auto buffer : seen) {
+        EXPECT_EQ(0, NetBufferMagazineRelease(mag, buffer));
+    }
+
+    EXPECT_EQ(0, NetBufferMagazineDeinit(mag));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+    NetBufferDeinit(cb);
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, NetBufferLazyModes,
+    Values(0u, NETBUF_F_LINKED_USED_LIST, NETBUF_F_CONCURRENT, NETBUF_F_SPLIT_META));
+
+TEST(NetBufferLazy, RejectsClasses)
+{
+    const net_buffer_class_config_t classes[] = { { 8, 2 }, { 64, 2 } };
+    net_buffer_config_t cfg = {};
+    cfg.classes = classes;
+    cfg.num_classes = 2;
+    cfg.flags = NETBUF_F_LAZY_INIT;
+
+    net_buffer_cb_t cb[1];
+    EXPECT_EQ(-1, NetBufferInitEx(cb, &cfg));
+}
+
+TEST(NetBufferLazy, UsedMapClearedOnTheWay)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(200, 8, NETBUF_F_LAZY_INIT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    /* what malloc may hand out, nothing clears it up front */
+    memset(cb->used_map, 0xFF, NETBUF_USED_MAP_SIZE(200));
+
+    auto first = NetBufferRequest(cb);
+    auto never = (net_buffer_t*)((uint8_t*)first + 150 * cb->elem_size);
+    EXPECT_FALSE(NetBufferIsUsed(cb, never));
+    EXPECT_EQ(-1, NetBufferRelease(cb, never));
+
+    /* across word boundaries of the bitmap */
+    std::vector<net_buffer_t*> bufs(129);
+    ASSERT_EQ(129, NetBufferRequestBulk(cb, bufs.data(), bufs.size()));
+    auto count = [](net_buffer_cb_t*, net_buffer_t*, void* ctx) { return ++*static_cast<int*>(ctx), 0; };
+    int seen = 0;
+    EXPECT_EQ(130, NetBufferForEachUsed(cb, count, &seen));
+    EXPECT_FALSE(NetBufferIsUsed(cb, never));
+
+    EXPECT_EQ(129, NetBufferReleaseBulk(cb, bufs.data(), bufs.size()));
+    EXPECT_EQ(0, NetBufferRelease(cb, first));
+    EXPECT_EQ(0, NetBufferForEachUsed(cb, count, &seen));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferLazy, UntouchedMemoryStaysUncommitted)
+{
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(1024, page - sizeof(net_buffer_t), NETBUF_F_MMAP | NETBUF_F_LAZY_INIT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    const auto resident = [&] {
+        std::vector<unsigned char> vec((cb->arena.size + page - 1) / page);
+        EXPECT_EQ(0, mincore(cb->slab, cb->arena.size, vec.data()));
+        size_t count = 0;
+        for (auto v : vec) {
+            count += v & 1;
+        }
+        return count;
+    };
+
+    EXPECT_EQ(0, resident());
+
+    net_buffer_t* held[10];
+    ASSERT_EQ(10, NetBufferRequestBulk(cb, held, 10));
+    EXPECT_LE(10, resident());
+    EXPECT_GE(11, resident());
+
+    EXPECT_EQ(10, NetBufferReleaseBulk(cb, held, 10));
+    NetBufferDeinit(cb);
+}
+
+} // namespace
@@ -0,0 +1,284 @@
+#include <gmock/gmock.h>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+#include "netbuf_test.h"
+
+namespace {
+
+net_buffer_magazine_config_t magazine_cfg(size_t size, size_t refill = 0, size_t flush_high = 0, size_t flush_low = 0)
+{
+    return net_buffer_magazine_config_t { size, refill, flush_high, flush_low };
+}
+
+TEST(NetBufferMagazine, Defaults)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 16, 8));
+
+    net_buffer_magazine_t mag[1];
+    const auto cfg = magazine_cfg(8);
+    ASSERT_EQ(0, NetBufferMagazineInit(mag, cb, &cfg));
+
+    EXPECT_EQ(4, mag->cfg.refill);
+    EXPECT_EQ(8, mag->cfg.flush_high);
+    EXPECT_EQ(4, mag->cfg.flush_low);
+
+    EXPECT_EQ(0, NetBufferMagazineDeinit(mag));
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferMagazine, InvalidConfig)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 16, 8));
+
+    net_buffer_magazine_t mag[1];
+    auto cfg = magazine_cfg(0);
+    EXPECT_EQ(-1, NetBufferMagazineInit(mag, cb, &cfg));
+
+    cfg = magazine_cfg(4, 5);
+    EXPECT_EQ(-1, NetBufferMagazineInit(mag, cb, &cfg));
+
+    cfg = magazine_cfg(4, 0, 2, 2);
+    EXPECT_EQ(-1, NetBufferMagazineInit(mag, cb, &cfg));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferMagazine, LocalHits)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 16, 8));
+
+    net_buffer_magazine_t mag[1];
+    const auto cfg = magazine_cfg(8, 4);
+    ASSERT_EQ(0, NetBufferMagazineInit(mag, cb, &cfg));
+
+    /* the first request refills, the rest are served locally */
+    for (size_t i = 0; i < 100; ++i) {
+        auto buffer = NetBufferMagazineRequest(mag);
+        ASSERT_NE(nullptr, buffer);
+        ASSERT_EQ(0, NetBufferMagazineRelease(mag, buffer));
+    }
+
+    EXPECT_EQ(1, mag->stats.request_global);
+    EXPECT_EQ(99, mag->stats.request_local);
+    EXPECT_EQ(100, mag->stats.release_local);
+    EXPECT_EQ(0, mag->stats.release_global);
+
+    /* the cached buffers are not available to the rest of the pool */
+    EXPECT_EQ(4, NetBufferGetUsedCount(cb));
+
+    EXPECT_EQ(0, NetBufferMagazineFlush(mag));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferMagazineDeinit(mag);
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferMagazine, RejectsPoolBuffers)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 16, 8));
+
+    net_buffer_magazine_t mag[1];
+    const auto cfg = magazine_cfg(8, 4);
+    ASSERT_EQ(0, NetBufferMagazineInit(mag, cb, &cfg));
+
+    /* requested from the plain pool, it stays in its used list */
+    auto direct = NetBufferRequest(cb);
+    ASSERT_NE(nullptr, direct);
+    EXPECT_EQ(-1, NetBufferMagazineRelease(mag, direct));
+    EXPECT_TRUE(NetBufferIsUsed(cb, direct));
+    EXPECT_EQ(0, NetBufferRelease(cb, direct));
+
+    auto cached = NetBufferMagazineRequest(mag);
+    ASSERT_NE(nullptr, cached);
+    EXPECT_EQ(0, NetBufferMagazineRelease(mag, cached));
+
+    EXPECT_EQ(0, NetBufferMagazineFlush(mag));
+    EXPECT_EQ(0, mag->pool->depot.held);
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferMagazineDeinit(mag);
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferMagazine, ChainsAndClonesDontLeak)
+{
+    const auto pcfg = pool_cfg(8, 8, NETBUF_F_REFCOUNT);
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInitEx(cb, &pcfg));
+
+    net_buffer_magazine_t mag[1];
+    const auto cfg = magazine_cfg(4, 2);
+    ASSERT_EQ(0, NetBufferMagazineInit(mag, cb, &cfg));
+
+    /* a 20 byte write needs a chain of 3 */
+    const std::vector<uint8_t> data(20, 0x5A);
+    auto head = NetBufferMagazineRequest(mag);
+    ASSERT_NE(nullptr, head);
+    EXPECT_EQ(-1, NetBufferWriteChain(cb, head, data.data(), data.size()));
+    EXPECT_EQ(nullptr, NetBufferClone(cb, head));
+    EXPECT_EQ(0, NetBufferMagazineRelease(mag, head));
+
+    /* the pool's own buffers still chain and clone */
+    auto direct = NetBufferRequest(cb);
+    ASSERT_NE(nullptr, direct);
+    ASSERT_EQ(20, NetBufferWriteChain(cb, direct, data.data(), data.size()));
+    EXPECT_EQ(0, NetBufferRelease(cb, direct));
+
+    direct = NetBufferRequest(cb);
+    ASSERT_NE(nullptr, direct);
+    auto clone = NetBufferClone(cb, direct);
+    ASSERT_NE(nullptr, clone);
+    EXPECT_EQ(0, NetBufferRelease(cb, direct));
+    EXPECT_EQ(0, NetBufferRelease(cb, clone));
+
+    EXPECT_EQ(0, NetBufferMagazineDeinit(mag));
+    EXPECT_EQ(0, cb->depot.held);
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    /* every buffer is back */
+    net_buffer_t* all[8];
+    EXPECT_EQ(8, NetBufferRequestBulk(cb, all, 8));
+    EXPECT_EQ(8, NetBufferReleaseBulk(cb, all, 8));
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferMagazine, FlushThresholds)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 16, 8));
+
+    net_buffer_magazine_t mag[1];
+    const auto cfg = magazine_cfg(8, 8, 6, 2);
+    ASSERT_EQ(0, NetBufferMagazineInit(mag, cb, &cfg));
+
+    std::vector<net_buffer_t*> held;
+    for (size_t i = 0; i < 16; ++i) {
+        auto buffer = NetBufferMagazineRequest(mag);
+        ASSERT_NE(nullptr, buffer);
+        held.push_back(buffer);
+    }
+    EXPECT_EQ(nullptr, NetBufferMagazineRequest(mag));
+    EXPECT_EQ(1, mag->stats.request_failed);
+    EXPECT_EQ(2, mag->stats.request_global);
+
+    for (size_t i = 0; i < 6; ++i) {
+        ASSERT_EQ(0, NetBufferMagazineRelease(mag, held[i]));
+    }
+    EXPECT_EQ(6, mag->count);
+    EXPECT_EQ(0, mag->stats.release_global);
+
+    /* the 7th release flushes 4 buffers to the pool */
+    ASSERT_EQ(0, NetBufferMagazineRelease(mag, held[6]));
+    EXPECT_EQ(3, mag->count);
+    EXPECT_EQ(1, mag->stats.release_global);
+    EXPECT_EQ(16 - 4, NetBufferGetUsedCount(cb));
+
+    /* double release */
+    EXPECT_EQ(-1, NetBufferMagazineRelease(mag, held[6]));
+
+    for (size_t i = 7; i < held.size(); ++i) {
+        ASSERT_EQ(0, NetBufferMagazineRelease(mag, held[i]));
+    }
+
+    NetBufferMagazineDeinit(mag);
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+    NetBufferDeinit(cb);
+}
+
+void run_threads(net_buffer_cb_t* cb, size_t num_threads)
+{
+    std::atomic<size_t> failures = 0;
+
+    auto worker = [&](size_t tid) {
+        net_buffer_magazine_t mag[1];
+        const auto cfg = magazine_cfg(8);
+        if (NetBufferMagazineInit(mag, cb, &cfg) != 0) {
+            failures++;
+            return;
+        }
+
+        std::vector<net_buffer_t*> held;
+        for (size_t i = 0; i < 20000; ++i) {
+            if (held.size() < 6) {
+                auto buffer = NetBufferMagazineRequest(mag);
+                if (!buffer) {
+                    continue;
+                }
+                buffer->id = (uint32_t)((tid << 24) | i);
+                memcpy(buffer->user_data, &buffer->id, sizeof(buffer->id));
+                held.push_back(buffer);
+            } else {
+                auto buffer = held[i % held.size()];
+                held.erase(held.begin() + (i % held.size()));
+                if (memcmp(buffer->user_data, &buffer->id, sizeof(buffer->id)) != 0) {
+                    failures++;
+                }
+                if (NetBufferMagazineRelease(mag, buffer) != 0) {
+                    failures++;
+                }
+            }
+        }
+
+        for (auto buffer : held) {
+            NetBufferMagazineRelease(mag, buffer);
+        }
+        NetBufferMagazineDeinit(mag);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back(worker, t);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(0, failures.load());
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+}
+
+TEST(NetBufferMagazine, ThreadsOnConcurrentPool)
+{
+    net_buffer_cb_t cb[1];
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 64;
+    cfg.buffer_size = 8;
+    cfg.flags = NETBUF_F_CONCURRENT;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    run_threads(cb, 4);
+
+    /* everything went back to the free list exactly once */
+    std::set<net_buffer_t*> seen;
+    for (size_t i = 0; i < 64; ++i) {
+        auto buffer = NetBufferRequest(cb);
+        ASSERT_NE(nullptr, buffer);
+        EXPECT_TRUE(seen.insert(buffer).second);
+    }
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferMagazine, ThreadsOnPlainPool)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 64, 8));
+
+    run_threads(cb, 4);
+
+    NetBufferDeinit(cb);
+}
+
+} // namespace
@@ -0,0 +1,216 @@
+#include <gmock/gmock.h>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.hpp"
+
+namespace {
+
+/* counts what reaches the heap */
+class CountingResource : public std::pmr::memory_resource {
+public:
+    std::atomic<size_t> allocs = 0;
+    std::atomic<size_t> frees = 0;
+
+protected:
+    void* do_allocate(size_t bytes, size_t align) override
+    {
+        allocs++;
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t align) override
+    {
+        frees++;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+TEST(NetBufferFromData, Lookup)
+{
+    net_buffer_cb_t cb[1];
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 4;
+    cfg.buffer_size = 32;
+    cfg.headroom = 8;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto buffer = NetBufferRequest(cb);
+    EXPECT_EQ(buffer, NetBufferFromData(cb, NetBufferData(cb, buffer)));
+    EXPECT_EQ(buffer, NetBufferFromData(cb, NetBufferData(cb, buffer) + 31));
+    EXPECT_EQ(buffer, NetBufferFromData(cb, NetBufferHead(cb, buffer)));
+
+    int outside;
+    EXPECT_EQ(nullptr, NetBufferFromData(cb, &outside));
+    EXPECT_EQ(nullptr, NetBufferFromData(cb, nullptr));
+
+    NetBufferRelease(cb, buffer);
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferFromData, SplitMetaAndClasses)
+{
+    net_buffer_cb_t cb[1];
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 4;
+    cfg.buffer_size = 32;
+    cfg.flags = NETBUF_F_SPLIT_META;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto a = NetBufferRequest(cb);
+    auto b = NetBufferRequest(cb);
+    EXPECT_EQ(a, NetBufferFromData(cb, NetBufferData(cb, a)));
+    EXPECT_EQ(b, NetBufferFromData(cb, NetBufferData(cb, b) + 16));
+    NetBufferRelease(cb, a);
+    NetBufferRelease(cb, b);
+    NetBufferDeinit(cb);
+
+    const net_buffer_class_config_t classes[] = { { 16, 2 }, { 64, 2 } };
+    cfg = {};
+    cfg.classes = classes;
+    cfg.num_classes = 2;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto small = NetBufferRequestSized(cb, 8);
+    auto large = NetBufferRequestSized(cb, 40);
+    EXPECT_EQ(small, NetBufferFromData(cb, NetBufferData(cb, small) + 15));
+    EXPECT_EQ(large, NetBufferFromData(cb, NetBufferData(cb, large) + 63));
+    NetBufferRelease(cb, small);
+    NetBufferRelease(cb, large);
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferPmr, SmallBlocksFromPool)
+{
+    netbuf::Pool<8, 64> pool;
+    CountingResource heap;
+    netbuf::PoolResource res(pool.native(), &heap);
+
+    {
+        std::pmr::vector<uint32_t> signals(&res);
+        signals.reserve(16);
+        for (uint32_t i = 0; i < 16; ++i) {
+            signals.push_back(i);
+        }
+        EXPECT_EQ(1u, pool.used());
+        EXPECT_NE(nullptr, NetBufferFromData(pool.native(), signals.data()));
+    }
+
+    EXPECT_EQ(0u, pool.used());
+    EXPECT_EQ(0u, heap.allocs.load());
+    EXPECT_EQ(1u, res.stats().pooled);
+}
+
+TEST(NetBufferPmr, LargeBlocksGoUpstream)
+{
+    netbuf::Pool<8, 64> pool;
+    CountingResource heap;
+    netbuf::PoolResource res(pool.native(), &heap);
+
+    {
+        std::pmr::vector<uint8_t> scratch(65, 0, &res);
+        EXPECT_EQ(0u, pool.used());
+        EXPECT_EQ(1u, heap.allocs.load());
+    }
+    EXPECT_EQ(1u, heap.frees.load());
+
+    /* alignment a buffer can't promise, the pool isn't even asked */
+    void* p = res.allocate(16, 4096);
+    EXPECT_EQ(0u, (uintptr_t)p % 4096);
+    EXPECT_EQ(0u, pool.used());
+    res.deallocate(p, 16, 4096);
+    EXPECT_EQ(2u, heap.frees.load());
+
+    /* the most a buffer can promise */
+    const size_t align = NetBufferGetDataAlignment(pool.native());
+    p = res.allocate(16, align);
+    EXPECT_EQ(0u, (uintptr_t)p % align);
+    EXPECT_EQ(1u, pool.used());
+    res.deallocate(p, 16, align);
+
+    const auto stats = res.stats();
+    EXPECT_EQ(1u, stats.pooled);
+    EXPECT_EQ(1u, stats.oversize);
+    EXPECT_EQ(1u, stats.overaligned);
+    EXPECT_EQ(0u, stats.exhausted);
+}
+
+TEST(NetBufferPmr, ExhaustedPoolFallsBack)
+{
+    netbuf::Pool<2, 64> pool;
+    CountingResource heap;
+    netbuf::PoolResource res(pool.native(), &heap);
+
+    void* blocks[3];
+    for (auto& block : blocks) {
+        block = res.allocate(32, alignof(uint64_t));
+    }
+    EXPECT_EQ(2u, pool.used());
+    EXPECT_EQ(1u, heap.allocs.load());
+    EXPECT_EQ(1u, res.stats().exhausted);
+
+    /* each block goes back where it came from */
+    for (auto block : blocks) {
+        res.deallocate(block, 32, alignof(uint64_t));
+    }
+    EXPECT_EQ(0u, pool.used());
+    EXPECT_EQ(1u, heap.frees.load());
+}
+
+TEST(NetBufferPmr, IsEqual)
+{
+    netbuf::Pool<2, 64> pool;
+    netbuf::PoolResource a(pool.native());
+    netbuf::PoolResource b(pool.native());
+
+    EXPECT_TRUE(a.is_equal(a));
+    EXPECT_FALSE(a.is_equal(b));
+    EXPECT_EQ(std::pmr::get_default_resource(), a.upstream());
+    EXPECT_EQ(pool.native(), a.pool());
+}
+
+TEST(NetBufferPmr, Concurrent)
+{
+    net_buffer_cb_t cb[1];
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 8;
+    cfg.buffer_size = 128;
+    cfg.flags = NETBUF_F_CONCURRENT;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    CountingResource heap;
+    netbuf::PoolResource res(cb, &heap);
+
+    const size_t num_threads = 4;
+    const size_t num_iterations = 2000;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&] {
+            for (size_t i = 0; i < num_iterations; ++i) {
+                std::pmr::vector<uint16_t> frame(&res);
+                frame.reserve(32);
+                frame.assign(32, (uint16_t)i);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    const auto stats = res.stats();
+    EXPECT_EQ(num_threads * num_iterations, stats.pooled + stats.exhausted);
+    EXPECT_EQ(stats.exhausted, heap.allocs.load());
+    EXPECT_EQ(heap.allocs.load(), heap.frees.load());
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+} // namespace
@@ -0,0 +1,228 @@
+#include <gmock/gmock.h>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+#include "netbuf_test.h"
+
+namespace {
+
+TEST(NetBufferPriority, Init)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 16, NETBUF_F_PRIORITY);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    EXPECT_TRUE(cb->flags & NETBUF_F_LINKED_USED_LIST);
+    EXPECT_EQ(nullptr, cb->used_list);
+    EXPECT_EQ(0u, cb->prio.mask);
+    EXPECT_EQ(nullptr, NetBufferGetLRU(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferPriority, RejectsConcurrent)
+{
+    net_buffer_cb_t cb[1];
+    auto cfg = pool_cfg(4, 16, NETBUF_F_PRIORITY);
+    cfg.flags |= NETBUF_F_CONCURRENT;
+    EXPECT_EQ(-1, NetBufferInitEx(cb, &cfg));
+}
+
+TEST(NetBufferPriority, CanPriority)
+{
+    /* standard identifiers */
+    EXPECT_EQ(0, NetBufferCanPriority(0x000));
+    EXPECT_EQ(0, NetBufferCanPriority(0x0FF));
+    EXPECT_EQ(1, NetBufferCanPriority(0x100));
+    EXPECT_EQ(NETBUF_PRIORITY_LANES - 1, NetBufferCanPriority(0x7FF));
+
+    /* extended identifiers */
+    EXPECT_EQ(0, NetBufferCanPriority(0x800));
+    EXPECT_EQ(NETBUF_PRIORITY_LANES - 1, NetBufferCanPriority(0x1FFFFFFF));
+
+    /* lower identifiers never get a lower priority lane */
+    for (uint32_t id = 1; id <= 0x7FF; ++id) {
+        EXPECT_LE(NetBufferCanPriority(id - 1), NetBufferCanPriority(id));
+    }
+}
+
+TEST(NetBufferPriority, DefaultLaneIsFifo)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 16, NETBUF_F_PRIORITY);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto a = NetBufferRequest(cb);
+    auto b = NetBufferRequest(cb);
+    EXPECT_EQ(NETBUF_PRIORITY_LANES - 1, a->priority);
+    EXPECT_EQ(a, NetBufferGetLRU(cb));
+    EXPECT_EQ(2, NetBufferGetUsedCount(cb));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, a));
+    EXPECT_EQ(b, NetBufferGetLRU(cb));
+    EXPECT_EQ(0, NetBufferRelease(cb, b));
+    EXPECT_EQ(nullptr, NetBufferGetLRU(cb));
+    EXPECT_EQ(0u, cb->prio.mask);
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferPriority, HighestPriorityOldestFirst)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(8, 16, NETBUF_F_PRIORITY);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    /* bulk traffic first, then control frames */
+    const uint32_t ids[] = { 0x7F0, 0x6A0, 0x010, 0x7F1, 0x020, 0x300 };
+    std::vector<net_buffer_t*> bufs;
+    for (auto id : ids) {
+        auto buffer = NetBufferRequest(cb);
+        ASSERT_NE(nullptr, buffer);
+        buffer->id = id;
+        ASSERT_EQ(0, NetBufferSetPriority(cb, buffer, NetBufferCanPriority(id)));
+        bufs.push_back(buffer);
+    }
+
+    /* lane 0 first, oldest first within a lane */
+    std::vector<uint32_t> order;
+    while (auto buffer = NetBufferGetLRU(cb)) {
+        order.push_back(buffer->id);
+        ASSERT_EQ(0, NetBufferRelease(cb, buffer));
+    }
+    EXPECT_THAT(order, ElementsAre(0x010, 0x020, 0x300, 0x6A0, 0x7F0, 0x7F1));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferPriority, ReleaseFromAnyLane)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 16, NETBUF_F_PRIORITY);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto low = NetBufferRequest(cb);
+    auto high = NetBufferRequest(cb);
+    ASSERT_EQ(0, NetBufferSetPriority(cb, high, 0));
+    EXPECT_EQ(high, NetBufferGetLRU(cb));
+    EXPECT_EQ(1u | (1u << (NETBUF_PRIORITY_LANES - 1)), cb->prio.mask);
+
+    /* emptying the top lane uncovers the next one */
+    EXPECT_EQ(0, NetBufferRelease(cb, high));
+    EXPECT_EQ(low, NetBufferGetLRU(cb));
+    EXPECT_EQ(-1, NetBufferRelease(cb, high));
+
+    /* a recycled buffer starts over in the lowest lane */
+    auto again = NetBufferRequest(cb);
+    EXPECT_EQ(NETBUF_PRIORITY_LANES - 1, again->priority);
+    EXPECT_EQ(low, NetBufferGetLRU(cb));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, low));
+    EXPECT_EQ(0, NetBufferRelease(cb, again));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferPriority, SetPriorityMovesToBackOfLane)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 16, NETBUF_F_PRIORITY);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto a = NetBufferRequest(cb);
+    auto b = NetBufferRequest(cb);
+    ASSERT_EQ(0, NetBufferSetPriority(cb, b, 2));
+    ASSERT_EQ(0, NetBufferSetPriority(cb, a, 2));
+    EXPECT_EQ(b, NetBufferGetLRU(cb));
+
+    /* same lane again: a goes behind b */
+    ASSERT_EQ(0, NetBufferSetPriority(cb, b, 2));
+    EXPECT_EQ(a, NetBufferGetLRU(cb));
+
+    NetBufferRelease(cb, a);
+    NetBufferRelease(cb, b);
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferPriority, SetPriorityInvalid)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 16, NETBUF_F_PRIORITY);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto buffer = NetBufferRequest(cb);
+    EXPECT_EQ(-1, NetBufferSetPriority(cb, buffer, NETBUF_PRIORITY_LANES));
+    EXPECT_EQ(-1, NetBufferSetPriority(nullptr, buffer, 0));
+
+    net_buffer_t foreign = {};
+    EXPECT_EQ(-1, NetBufferSetPriority(cb, &foreign, 0));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(-1, NetBufferSetPriority(cb, buffer, 0));
+
+    NetBufferDeinit(cb);
+
+    /* plain pools have no lanes */
+    ASSERT_EQ(0, NetBufferInit(cb, 4, 16));
+    buffer = NetBufferRequest(cb);
+    EXPECT_EQ(-1, NetBufferSetPriority(cb, buffer, 0));
+    NetBufferRelease(cb, buffer);
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferPriority, Bulk)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(8, 16, NETBUF_F_PRIORITY);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    net_buffer_t* bufs[6];
+    ASSERT_EQ(6, NetBufferRequestBulk(cb, bufs, 6));
+    for (size_t i = 0; i < 6; ++i) {
+        ASSERT_EQ(0, NetBufferSetPriority(cb, bufs[i], (uint8_t)(i % 3)));
+    }
+    EXPECT_EQ(bufs[0], NetBufferGetLRU(cb));
+    EXPECT_EQ(6, NetBufferGetUsedCount(cb));
+
+    EXPECT_EQ(3, NetBufferReleaseBulk(cb, bufs, 3));
+    EXPECT_EQ(bufs[3], NetBufferGetLRU(cb));
+    EXPECT_EQ(3, NetBufferReleaseBulk(cb, bufs + 3, 3));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(0u, cb->prio.mask);
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferPriority, CloneKeepsLane)
+{
+    net_buffer_cb_t cb[1];
+    auto cfg = pool_cfg(4, 16, NETBUF_F_PRIORITY);
+    cfg.flags |= NETBUF_F_REFCOUNT;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto low = NetBufferRequest(cb);
+    auto buffer = NetBufferRequest(cb);
+    ASSERT_EQ(0, NetBufferSetPriority(cb, buffer, 1));
+
+    auto clone = NetBufferClone(cb, buffer);
+    ASSERT_NE(nullptr, clone);
+    EXPECT_EQ(1, clone->priority);
+
+    EXPECT_EQ(buffer, NetBufferGetLRU(cb));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, clone));
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(low, NetBufferGetLRU(cb));
+    EXPECT_EQ(0, NetBufferRelease(cb, low));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+} // namespace
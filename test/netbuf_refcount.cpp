@@ -0,0 +1,254 @@
+#include <gmock/gmock.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+#include "netbuf_test.h"
+
+namespace {
+
+TEST(NetBufferRefcount, RequiresFlag)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 4, 16));
+
+    auto buffer = NetBufferRequest(cb);
+    EXPECT_EQ(-1, NetBufferRetain(cb, buffer));
+    EXPECT_EQ(nullptr, NetBufferClone(cb, buffer));
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+
+    NetBufferDeinit(cb);
+}
+
+class NetBufferRefcountModes : public TestWithParam<uint32_t> { };
+
+TEST_P(NetBufferRefcountModes, Retain)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 16, GetParam() | NETBUF_F_REFCOUNT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto buffer = NetBufferRequest(cb);
+    ASSERT_NE(nullptr, buffer);
+    EXPECT_EQ(0, NetBufferRetain(cb, buffer));
+    EXPECT_EQ(0, NetBufferRetain(cb, buffer));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(1, NetBufferGetUsedCount(cb));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    /* no references left */
+    EXPECT_EQ(-1, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(-1, NetBufferRetain(cb, buffer));
+
+    NetBufferDeinit(cb);
+}
+
+TEST_P(NetBufferRefcountModes, Clone)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 16, GetParam() | NETBUF_F_REFCOUNT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto original = NetBufferRequest(cb);
+    ASSERT_NE(nullptr, original);
+    original->id = 42;
+    ASSERT_EQ(5, NetBufferWriteChecked(cb, original, "hello", 5));
+
+    auto a = NetBufferClone(cb, original);
+    ASSERT_NE(nullptr, a);
+    auto b = NetBufferClone(cb, a);
+    ASSERT_NE(nullptr, b);
+    EXPECT_EQ(3, NetBufferGetUsedCount(cb));
+
+    /* the payload is shared, the headers are not */
+    EXPECT_EQ(NetBufferData(cb, original), NetBufferData(cb, a));
+    EXPECT_EQ(NetBufferData(cb, original), NetBufferData(cb, b));
+    EXPECT_EQ(42, b->id);
+    EXPECT_EQ(5, b->user_data_length);
+    EXPECT_EQ(16, NetBufferGetCapacity(cb, b));
+    b->id = 7;
+    EXPECT_EQ(42, original->id);
+
+    /* the original payload outlives its first owner */
+    EXPECT_EQ(0, NetBufferRelease(cb, original));
+    EXPECT_EQ(3, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(0, memcmp("hello", NetBufferData(cb, a), 5));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, a));
+    EXPECT_EQ(2, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(0, NetBufferRelease(cb, b));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    /* everything made it back */
+    net_buffer_t* all[4];
+    EXPECT_EQ(4, NetBufferRequestBulk(cb, all, 4));
+    EXPECT_EQ(4, NetBufferReleaseBulk(cb, all, 4));
+
+    NetBufferDeinit(cb);
+}
+
+TEST_P(NetBufferRefcountModes, ReleaseBulk)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(8, 16, GetParam() | NETBUF_F_REFCOUNT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    net_buffer_t* buffers[4];
+    ASSERT_EQ(4, NetBufferRequestBulk(cb, buffers, 4));
+    EXPECT_EQ(0, NetBufferRetain(cb, buffers[1]));
+    auto clone = NetBufferClone(cb, buffers[2]);
+    ASSERT_NE(nullptr, clone);
+
+    /* buffers[1] and buffers[2] are still referenced, as well as the clone */
+    EXPECT_EQ(4, NetBufferReleaseBulk(cb, buffers, 4));
+    EXPECT_EQ(3, NetBufferGetUsedCount(cb));
+
+    net_buffer_t* rest[2] = { buffers[1], clone };
+    EXPECT_EQ(2, NetBufferReleaseBulk(cb, rest, 2));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, NetBufferRefcountModes,
+    Values(0u, NETBUF_F_LINKED_USED_LIST, NETBUF_F_CONCURRENT, NETBUF_F_SPLIT_META));
+
+TEST(NetBufferRefcount, CloneTakesSmallestClass)
+{
+    const net_buffer_class_config_t classes[] = { { 8, 2 }, { 256, 2 } };
+    net_buffer_config_t cfg = {};
+    cfg.flags = NETBUF_F_REFCOUNT;
+    cfg.classes = classes;
+    cfg.num_classes = 2;
+
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto original = NetBufferRequestSized(cb, 200);
+    ASSERT_NE(nullptr, original);
+    auto clone = NetBufferClone(cb, original);
+    ASSERT_NE(nullptr, clone);
+
+    EXPECT_EQ(0, clone->size_class);
+    EXPECT_EQ(256, NetBufferGetCapacity(cb, clone));
+    EXPECT_EQ(1, NetBufferGetClassUsedCount(cb, 0));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, original));
+    EXPECT_EQ(1, NetBufferGetClassUsedCount(cb, 1));
+    EXPECT_EQ(0, NetBufferRelease(cb, clone));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferRefcount, SharedBuffersKeepTheirPayload)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(8, 16, NETBUF_F_REFCOUNT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto buffer = NetBufferRequest(cb);
+    auto clone = NetBufferClone(cb, buffer);
+    ASSERT_NE(nullptr, clone);
+
+    const char data[32] = "a payload spanning two buffers";
+    EXPECT_EQ(-1, NetBufferWriteChain(cb, buffer, data, sizeof(data)));
+    EXPECT_EQ(-1, NetBufferWriteChain(cb, clone, data, sizeof(data)));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, clone));
+    EXPECT_EQ(32, NetBufferWriteChain(cb, buffer, data, sizeof(data)));
+
+    /* a chain head can't be shared by a clone */
+    EXPECT_EQ(nullptr, NetBufferClone(cb, buffer));
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferRefcount, ConcurrentFanOut)
+{
+    const size_t num_threads = 4;
+    const size_t num_rounds = 2000;
+
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(num_threads + 1, 8, NETBUF_F_CONCURRENT | NETBUF_F_REFCOUNT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    for (size_t round = 0; round < num_rounds; ++round) {
+        auto buffer = NetBufferRequest(cb);
+        ASSERT_NE(nullptr, buffer);
+
+        std::vector<net_buffer_t*> clones;
+        for (size_t t = 0; t < num_threads; ++t) {
+            clones.push_back(NetBufferClone(cb, buffer));
+            ASSERT_NE(nullptr, clones.back());
+        }
+        ASSERT_EQ(0, NetBufferRelease(cb, buffer));
+
+        std::atomic<size_t> failures = 0;
+        std::vector<std::thread> threads;
+        for (auto clone : clones) {
+            threads.emplace_back([&, clone] {
+                if (NetBufferRelease(cb, clone) != 0) {
+                    failures++;
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        ASSERT_EQ(0, failures.load());
+        ASSERT_EQ(0, NetBufferGetUsedCount(cb));
+    }
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferRefcount, MagazineBuffers)
+{
+    for (uint32_t flags : { 0u, (uint32_t)NETBUF_F_CONCURRENT }) {
+        net_buffer_cb_t cb[1];
+        const auto cfg = pool_cfg(8, 16, flags | NETBUF_F_REFCOUNT);
+        ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+        net_buffer_magazine_t mag[1];
+        const net_buffer_magazine_config_t mcfg = { 4, 0, 0, 0 };
+        ASSERT_EQ(0, NetBufferMagazineInit(mag, cb, &mcfg));
+
+        auto buffer = NetBufferMagazineRequest(mag);
+        ASSERT_NE(nullptr, buffer);
+
+        if (flags & NETBUF_F_CONCURRENT) {
+            /* NetBufferRelease drops the references */
+            EXPECT_EQ(0, NetBufferRetain(cb, buffer));
+            auto clone = NetBufferClone(cb, buffer);
+            ASSERT_NE(nullptr, clone);
+            EXPECT_EQ(0, NetBufferRelease(cb, clone));
+            EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+            EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+        } else {
+            /* no release would take them back */
+            EXPECT_EQ(-1, NetBufferRetain(cb, buffer));
+            EXPECT_EQ(nullptr, NetBufferClone(cb, buffer));
+            EXPECT_EQ(1, buffer->refcount);
+            EXPECT_EQ(0, NetBufferMagazineRelease(mag, buffer));
+        }
+
+        NetBufferMagazineDeinit(mag);
+        EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+        NetBufferDeinit(cb);
+    }
+}
+
+} // namespace
@@ -0,0 +1,206 @@
+#include <gmock/gmock.h>
+#include <random>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "circular_buffer.h"
+#include "netbuf_simd.h"
+#include "simple_stack.h"
+
+namespace {
+
+/* runs every test on each level the CPU has, against the scalar loops */
+class NetBufferSimd : public TestWithParam<netbuf_simd_level> {
+protected:
+    void SetUp() override
+    {
+        saved_ = netbuf_simd_get_level();
+        if (netbuf_simd_set_level(GetParam()) != 0) {
+            GTEST_SKIP() << "not supported by this CPU";
+        }
+    }
+
+    void TearDown() override { netbuf_simd_set_level(saved_); }
+
+private:
+    netbuf_simd_level saved_ = NETBUF_SIMD_SCALAR;
+};
+
+std::vector<void*> pointers(size_t n)
+{
+    std::vector<void*> v(n);
+    for (size_t i = 0; i < n; ++i) {
+        v[i] = (void*)(uintptr_t)(0x1000 + 8 * i);
+    }
+    return v;
+}
+
+size_t find_ref(const std::vector<void*>& v, const void* item)
+{
+    for (size_t i = 0; i < v.size(); ++i) {
+        if (v[i] == item) {
+            return i;
+        }
+    }
+    return v.size();
+}
+
+std::vector<void*> compact_ref(std::vector<void*> v)
+{
+    std::vector<void*> out;
+    for (auto p : v) {
+        if (p) {
+            out.push_back(p);
+        }
+    }
+    out.resize(v.size(), nullptr);
+    return out;
+}
+
+TEST_P(NetBufferSimd, FindEveryPosition)
+{
+    /* every length around the vector widths and their unrolled loops */
+    for (size_t n = 0; n <= 40; ++n) {
+        auto v = pointers(n);
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_EQ(i, netbuf_ptr_find(v.data(), n, v[i])) << "n=" << n;
+        }
+        EXPECT_EQ(n, netbuf_ptr_find(v.data(), n, (void*)0x1));
+    }
+}
+
+TEST_P(NetBufferSimd, FindFirstMatch)
+{
+    auto v = pointers(37);
+    v[30] = v[5];
+    v[20] = v[19];
+    EXPECT_EQ(5u, netbuf_ptr_find(v.data(), v.size(), v[5]));
+    EXPECT_EQ(19u, netbuf_ptr_find(v.data(), v.size(), v[20]));
+
+    /* only the low half of the pointer matches */
+    v[3] = (void*)(uintptr_t)0x100000abcULL;
+    EXPECT_EQ(v.size(), netbuf_ptr_find(v.data(), v.size(), (void*)(uintptr_t)0x200000abcULL));
+}
+
+TEST_P(NetBufferSimd, FindRandom)
+{
+    std::mt19937 rng(7);
+    for (int round = 0; round < 200; ++round) {
+        const size_t n = std::uniform_int_distribution<size_t>(0, 300)(rng);
+        std::vector<void*> v(n);
+        for (auto& p : v) {
+            p = (void*)(uintptr_t)std::uniform_int_distribution<int>(0, 64)(rng);
+        }
+        const void* item = (void*)(uintptr_t)std::uniform_int_distribution<int>(0, 64)(rng);
+        EXPECT_EQ(find_ref(v, item), netbuf_ptr_find(v.data(), n, item));
+    }
+}
+
+TEST_P(NetBufferSimd, CompactRandom)
+{
+    std::mt19937 rng(11);
+    for (int round = 0; round < 500; ++round) {
+        const size_t n = std::uniform_int_distribution<size_t>(0, 200)(rng);
+        const double holes = std::uniform_real_distribution<double>(0, 1)(rng);
+
+        auto v = pointers(n);
+        for (auto& p : v) {
+            if (std::bernoulli_distribution(holes)(rng)) {
+                p = nullptr;
+            }
+        }
+
+        const auto expected = compact_ref(v);
+        const size_t kept = netbuf_ptr_compact(v.data(), n);
+        EXPECT_EQ(expected, v);
+        EXPECT_EQ(find_ref(expected, nullptr), kept);
+    }
+}
+
+TEST_P(NetBufferSimd, CompactEdges)
+{
+    auto full = pointers(17);
+    const auto copy = full;
+    EXPECT_EQ(17u, netbuf_ptr_compact(full.data(), full.size()));
+    EXPECT_EQ(copy, full);
+
+    std::vector<void*> empty(17, nullptr);
+    EXPECT_EQ(0u, netbuf_ptr_compact(empty.data(), empty.size()));
+    EXPECT_THAT(empty, Each(nullptr));
+
+    EXPECT_EQ(0u, netbuf_ptr_compact(nullptr, 0));
+}
+
+TEST_P(NetBufferSimd, Stack)
+{
+    const size_t n = 100;
+    auto q = stack_alloc(n);
+    for (size_t i = 0; i < n; ++i) {
+        stack_push(q, (void*)(uintptr_t)(i + 1));
+    }
+
+    for (size_t i = 0; i < n; i += 3) {
+        EXPECT_EQ(0, stack_remove(q, (void*)(uintptr_t)(i + 1)));
+        EXPECT_FALSE(stack_contains(q, (void*)(uintptr_t)(i + 1)));
+    }
+    EXPECT_EQ(-1, stack_remove(q, (void*)1));
+    EXPECT_TRUE(stack_contains(q, (void*)(uintptr_t)(n - 1)));
+
+    stack_sort(q);
+    EXPECT_TRUE(q->is_sorted);
+    ASSERT_EQ(66u, stack_count(q));
+    for (size_t i = 0, j = 0; i < n; ++i) {
+        if (i % 3) {
+            EXPECT_EQ((void*)(uintptr_t)(i + 1), q->entry[j++]);
+        }
+    }
+    EXPECT_EQ(nullptr, q->entry[66]);
+
+    stack_free(q);
+}
+
+TEST_P(NetBufferSimd, CircularBufferWraps)
+{
+    const size_t n = 37;
+    auto cb = cbuf_alloc(n);
+
+    /* live items on both ends of the array */
+    for (size_t i = 0; i < 30; ++i) {
+        cbuf_push_back(cb, (void*)(uintptr_t)(i + 1));
+    }
+    for (size_t i = 0; i < 25; ++i) {
+        cbuf_pop_front(cb);
+    }
+    for (size_t i = 30; i < 60; ++i) {
+        cbuf_push_back(cb, (void*)(uintptr_t)(i + 1));
+    }
+
+    for (size_t i = 0; i < 60; ++i) {
+        const int idx = cbuf_contains(cb, (void*)(uintptr_t)(i + 1));
+        if (i < 25) {
+            EXPECT_EQ(-1, idx);
+        } else {
+            EXPECT_EQ((int)(i % n), idx);
+        }
+    }
+
+    cbuf_free(cb);
+}
+
+INSTANTIATE_TEST_SUITE_P(Levels, NetBufferSimd,
+    Values(NETBUF_SIMD_SCALAR, NETBUF_SIMD_SSE2, NETBUF_SIMD_AVX2, NETBUF_SIMD_AVX512));
+
+TEST(NetBufferSimdLevel, BestByDefault)
+{
+    const auto level = netbuf_simd_get_level();
+    for (int l = level + 1; l <= NETBUF_SIMD_AVX512; ++l) {
+        EXPECT_EQ(-1, netbuf_simd_set_level((netbuf_simd_level)l));
+    }
+    EXPECT_EQ(-1, netbuf_simd_set_level((netbuf_simd_level)42));
+    EXPECT_EQ(level, netbuf_simd_get_level());
+}
+
+} // namespace
@@ -0,0 +1,95 @@
+#include <gmock/gmock.h>
+#include <set>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+
+namespace {
+
+NETBUF_POOL_DEFINE(file_pool, 8, 32);
+
+TEST(NetBufferStatic, Init)
+{
+    std::vector<uint8_t> mem(NETBUF_POOL_STORAGE_SIZE(4, 16));
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInitStatic(cb, mem.data(), mem.size(), 4, 16));
+
+    /* everything lives in the caller's memory */
+    const auto in_mem = [&](const void* p) {
+        return p >= (const void*)mem.data() && p < (const void*)(mem.data() + mem.size());
+    };
+    EXPECT_EQ(nullptr, cb->slab);
+    EXPECT_TRUE(in_mem(cb->buffers));
+    EXPECT_TRUE(in_mem(cb->free_list));
+    EXPECT_TRUE(in_mem(cb->used_list));
+
+    std::set<net_buffer_t*> seen;
+    for (size_t i = 0; i < 4; ++i) {
+        auto buffer = NetBufferRequest(cb);
+        ASSERT_NE(nullptr, buffer);
+        EXPECT_TRUE(in_mem(buffer));
+        EXPECT_TRUE(in_mem(buffer->user_data + 15));
+        EXPECT_TRUE(seen.insert(buffer).second);
+    }
+    EXPECT_EQ(nullptr, NetBufferRequest(cb));
+
+    /* works as a regular pool */
+    auto lru = NetBufferGetLRU(cb);
+    EXPECT_EQ(0, NetBufferRelease(cb, lru));
+    EXPECT_EQ(3, NetBufferGetUsedCount(cb));
+    for (auto buffer : seen) {
+        NetBufferRelease(cb, buffer);
+    }
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    EXPECT_EQ(0, NetBufferDeinit(cb));
+    EXPECT_EQ(nullptr, cb->free_list);
+}
+
+TEST(NetBufferStatic, Misaligned)
+{
+    std::vector<uint8_t> mem(NETBUF_POOL_STORAGE_SIZE(5, 7) + 1);
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInitStatic(cb, mem.data() + 1, mem.size() - 1, 5, 7));
+
+    EXPECT_EQ(0u, (uintptr_t)cb->buffers % alignof(net_buffer_t));
+    net_buffer_t* all[5];
+    EXPECT_EQ(5, NetBufferRequestBulk(cb, all, 5));
+    for (auto buffer : all) {
+        EXPECT_EQ(7, NetBufferWriteChecked(cb, buffer, "1234567", 7));
+    }
+    EXPECT_EQ(5, NetBufferReleaseBulk(cb, all, 5));
+
+    EXPECT_EQ(0, NetBufferDeinit(cb));
+}
+
+TEST(NetBufferStatic, TooSmall)
+{
+    std::vector<uint8_t> mem(NETBUF_POOL_STORAGE_SIZE(4, 16));
+    net_buffer_cb_t cb[1];
+    EXPECT_EQ(-1, NetBufferInitStatic(cb, mem.data(), 4 * NETBUF_ELEM_SIZE(16), 4, 16));
+    EXPECT_EQ(-1, NetBufferInitStatic(cb, nullptr, mem.size(), 4, 16));
+    EXPECT_EQ(-1, NetBufferInitStatic(cb, mem.data(), mem.size(), 0, 16));
+}
+
+TEST(NetBufferStatic, FileScope)
+{
+    static_assert(sizeof(file_pool_storage) == NETBUF_POOL_STORAGE_SIZE(8, 32));
+
+    ASSERT_EQ(0, file_pool_init());
+    EXPECT_EQ(8, file_pool->num_buffers);
+    EXPECT_EQ(32, file_pool->buffer_capacity);
+
+    auto buffer = NetBufferRequest(file_pool);
+    ASSERT_NE(nullptr, buffer);
+    EXPECT_EQ(1, NetBufferGetUsedCount(file_pool));
+    EXPECT_EQ(0, NetBufferRelease(file_pool, buffer));
+
+    EXPECT_EQ(0, NetBufferDeinit(file_pool));
+}
+
+} // namespace
@@ -0,0 +1,230 @@
+#include <gmock/gmock.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+
+namespace {
+
+#if NETBUF_STATS
+
+net_buffer_stats_t stats_of(const net_buffer_cb_t* cb)
+{
+    net_buffer_stats_t stats;
+    EXPECT_EQ(0, NetBufferGetStats(cb, &stats));
+    return stats;
+}
+
+TEST(NetBufferStats, HighWaterFullWidth)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 300, 8));
+
+    std::vector<net_buffer_t*> bufs(300);
+    for (auto& buffer : bufs) {
+        buffer = NetBufferRequest(cb);
+        ASSERT_NE(nullptr, buffer);
+    }
+    for (auto buffer : bufs) {
+        NetBufferRelease(cb, buffer);
+    }
+
+    EXPECT_EQ(300u, stats_of(cb).high_water);
+
+    /* the manual update doesn't wrap either */
+    cb->stats.high_water = 0;
+    bufs.resize(260);
+    for (auto& buffer : bufs) {
+        buffer = NetBufferRequest(cb);
+    }
+    NetBufferUpdateCounters(cb);
+    EXPECT_EQ(260u, cb->stats.high_water);
+    for (auto buffer : bufs) {
+        NetBufferRelease(cb, buffer);
+    }
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferStats, Counters)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 3, 8));
+
+    auto a = NetBufferRequest(cb);
+    auto b = NetBufferRequest(cb);
+    auto c = NetBufferRequest(cb);
+    EXPECT_EQ(nullptr, NetBufferRequest(cb));
+
+    /* b is not at the LRU end */
+    EXPECT_EQ(0, NetBufferRelease(cb, b));
+    EXPECT_EQ(0, NetBufferRelease(cb, a));
+    EXPECT_EQ(0, NetBufferRelease(cb, c));
+    EXPECT_EQ(-1, NetBufferRelease(cb, c));
+
+    const auto stats = stats_of(cb);
+    EXPECT_EQ(3u, stats.requests);
+    EXPECT_EQ(3u, stats.releases);
+    EXPECT_EQ(1u, stats.failures);
+    EXPECT_EQ(1u, stats.slow_releases);
+    EXPECT_EQ(3u, stats.high_water);
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferStats, Bulk)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 4, 8));
+
+    net_buffer_t* bufs[6];
+    ASSERT_EQ(4, NetBufferRequestBulk(cb, bufs, 6));
+    EXPECT_EQ(4, NetBufferReleaseBulk(cb, bufs, 4));
+
+    const auto stats = stats_of(cb);
+    EXPECT_EQ(4u, stats.requests);
+    EXPECT_EQ(4u, stats.releases);
+    EXPECT_EQ(1u, stats.failures);
+    EXPECT_EQ(0u, stats.slow_releases);
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferStats, Occupancy)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, NETBUF_STATS_BUCKETS * 2, 8));
+
+    /* one request per occupancy level: two per bucket */
+    std::vector<net_buffer_t*> bufs;
+    for (size_t i = 0; i < NETBUF_STATS_BUCKETS * 2; ++i) {
+        bufs.push_back(NetBufferRequest(cb));
+    }
+
+    auto stats = stats_of(cb);
+    for (size_t b = 0; b < NETBUF_STATS_BUCKETS; ++b) {
+        EXPECT_EQ(2u, stats.occupancy[b]) << "bucket " << b;
+    }
+
+    /* requests into an almost empty pool land in the first bucket */
+    for (auto buffer : bufs) {
+        NetBufferRelease(cb, buffer);
+    }
+    NetBufferRelease(cb, NetBufferRequest(cb));
+    stats = stats_of(cb);
+    EXPECT_EQ(3u, stats.occupancy[0]);
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferStats, SizeClasses)
+{
+    const net_buffer_class_config_t classes[] = { { 16, 1 }, { 64, 1 } };
+    net_buffer_config_t cfg = {};
+    cfg.classes = classes;
+    cfg.num_classes = 2;
+
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto small = NetBufferRequestSized(cb, 8);
+    EXPECT_EQ(nullptr, NetBufferRequestSized(cb, 8));
+    NetBufferRelease(cb, small);
+
+    const auto stats = stats_of(cb);
+    EXPECT_EQ(1u, stats.requests);
+    EXPECT_EQ(1u, stats.releases);
+    EXPECT_EQ(1u, stats.failures);
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferStats, ConcurrentSnapshot)
+{
+    const size_t num_threads = 4;
+    const size_t num_iterations = 20000;
+
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 16;
+    cfg.buffer_size = 8;
+    cfg.flags = NETBUF_F_CONCURRENT;
+
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    std::atomic<bool> done = false;
+    std::atomic<size_t> inconsistent = 0;
+
+    std::thread reader([&] {
+        while (!done) {
+            net_buffer_stats_t stats;
+            NetBufferGetStats(cb, &stats);
+            if (stats.releases > stats.requests || stats.high_water > 16) {
+                inconsistent++;
+            }
+        }
+    });
+
+    std::atomic<size_t> served = 0;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&] {
+            for (size_t i = 0; i < num_iterations; ++i) {
+                if (auto buffer = NetBufferRequest(cb)) {
+                    served++;
+                    NetBufferRelease(cb, buffer);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    done = true;
+    reader.join();
+
+    const auto stats = stats_of(cb);
+    EXPECT_EQ(0u, inconsistent.load());
+    EXPECT_EQ(served.load(), stats.requests);
+    EXPECT_EQ(served.load(), stats.releases);
+    EXPECT_EQ(num_threads * num_iterations, stats.requests + stats.failures);
+    EXPECT_LE(1u, stats.high_water);
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferStats, InvalidArgs)
+{
+    net_buffer_stats_t stats;
+    EXPECT_EQ(-1, NetBufferGetStats(nullptr, &stats));
+}
+
+#else
+
+TEST(NetBufferStats, CompiledOut)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 4, 8));
+
+    auto buffer = NetBufferRequest(cb);
+    EXPECT_EQ(0, NetBufferUpdateCounters(cb));
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+
+    /* only the high water mark, kept by hand */
+    net_buffer_stats_t stats;
+    EXPECT_EQ(0, NetBufferGetStats(cb, &stats));
+    EXPECT_EQ(0, stats.requests);
+    EXPECT_EQ(0, stats.releases);
+    EXPECT_EQ(1, stats.high_water);
+
+    NetBufferDeinit(cb);
+}
+
+#endif
+
+} // namespace
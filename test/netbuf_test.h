@@ -0,0 +1,18 @@
+#ifndef NETBUF_TEST_H_
+#define NETBUF_TEST_H_
+
+/* helpers shared by the tests */
+
+#include "netbuf.h"
+
+/* config of a pool of `n` buffers of `size` bytes, the rest left to the test */
+inline net_buffer_config_t pool_cfg(size_t n, size_t size, uint32_t flags = 0)
+{
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = n;
+    cfg.buffer_size = size;
+    cfg.flags = flags;
+    return cfg;
+}
+
+#endif /* NETBUF_TEST_H_ */
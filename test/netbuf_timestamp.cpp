@@ -0,0 +1,181 @@
+#include <gmock/gmock.h>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+#include "netbuf_test.h"
+
+namespace {
+
+/* ages a buffer by moving its timestamp back */
+void age(net_buffer_t* buffer, uint64_t by)
+{
+    buffer->timestamp -= by;
+}
+
+void collect(net_buffer_cb_t*, net_buffer_t* buffer, void* ctx)
+{
+    static_cast<std::vector<uint32_t>*>(ctx)->push_back(buffer->id);
+}
+
+TEST(NetBufferTimestamp, StampedOnRequest)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 16, NETBUF_F_TIMESTAMP);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    const uint64_t before = NetBufferNow();
+    auto buffer = NetBufferRequest(cb);
+    const uint64_t after = NetBufferNow();
+
+    EXPECT_LE(before, buffer->timestamp);
+    EXPECT_GE(after, buffer->timestamp);
+
+    net_buffer_t* bufs[2];
+    ASSERT_EQ(2, NetBufferRequestBulk(cb, bufs, 2));
+    EXPECT_LE(buffer->timestamp, bufs[0]->timestamp);
+    EXPECT_LE(bufs[0]->timestamp, bufs[1]->timestamp);
+
+    NetBufferRelease(cb, buffer);
+    NetBufferReleaseBulk(cb, bufs, 2);
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferTimestamp, RequiresFlag)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 4, 16));
+    EXPECT_EQ(-1, NetBufferReclaimOlderThan(cb, 0, nullptr, nullptr));
+    NetBufferDeinit(cb);
+
+    const auto cfg = pool_cfg(4, 16, NETBUF_F_TIMESTAMP | NETBUF_F_CONCURRENT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+    EXPECT_EQ(-1, NetBufferReclaimOlderThan(cb, 0, nullptr, nullptr));
+    NetBufferDeinit(cb);
+
+    EXPECT_EQ(-1, NetBufferReclaimOlderThan(nullptr, 0, nullptr, nullptr));
+}
+
+class NetBufferReclaim : public TestWithParam<uint32_t> { };
+
+TEST_P(NetBufferReclaim, StopsAtFirstFresh)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(8, 16, NETBUF_F_TIMESTAMP | GetParam());
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    std::vector<net_buffer_t*> bufs;
+    for (uint32_t i = 0; i < 6; ++i) {
+        bufs.push_back(NetBufferRequest(cb));
+        bufs.back()->id = i;
+    }
+
+    /* the three oldest went stale, and one more further up that the walk
+     * never reaches */
+    for (size_t i = 0; i < 3; ++i) {
+        age(bufs[i], 1000000000);
+    }
+    age(bufs[4], 1000000000);
+
+    std::vector<uint32_t> reclaimed;
+    EXPECT_EQ(3, NetBufferReclaimOlderThan(cb, 500000000, collect, &reclaimed));
+    EXPECT_THAT(reclaimed, ElementsAre(0, 1, 2));
+    EXPECT_EQ(3, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(bufs[3], NetBufferGetLRU(cb));
+
+    /* nothing else is old enough */
+    EXPECT_EQ(0, NetBufferReclaimOlderThan(cb, 500000000, nullptr, nullptr));
+
+    for (size_t i = 3; i < 6; ++i) {
+        EXPECT_EQ(0, NetBufferRelease(cb, bufs[i]));
+    }
+    NetBufferDeinit(cb);
+}
+
+TEST_P(NetBufferReclaim, Everything)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(8, 16, NETBUF_F_TIMESTAMP | GetParam());
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    for (size_t i = 0; i < 8; ++i) {
+        age(NetBufferRequest(cb), 10);
+    }
+    EXPECT_EQ(nullptr, NetBufferRequest(cb));
+
+    EXPECT_EQ(8, NetBufferReclaimOlderThan(cb, 0, nullptr, nullptr));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(nullptr, NetBufferGetLRU(cb));
+
+    NetBufferDeinit(cb);
+}
+
+INSTANTIATE_TEST_SUITE_P(UsedList, NetBufferReclaim,
+    Values(0u, NETBUF_F_LINKED_USED_LIST, NETBUF_F_PRIORITY, NETBUF_F_REFCOUNT));
+
+TEST(NetBufferTimestamp, ReclaimEveryLane)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(8, 16, NETBUF_F_TIMESTAMP | NETBUF_F_PRIORITY);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto high_old = NetBufferRequest(cb);
+    auto high_new = NetBufferRequest(cb);
+    auto low_old = NetBufferRequest(cb);
+    ASSERT_EQ(0, NetBufferSetPriority(cb, high_old, 0));
+    ASSERT_EQ(0, NetBufferSetPriority(cb, high_new, 0));
+    age(high_old, 1000);
+    age(low_old, 1000);
+
+    EXPECT_EQ(2, NetBufferReclaimOlderThan(cb, 500, nullptr, nullptr));
+    EXPECT_EQ(high_new, NetBufferGetLRU(cb));
+    EXPECT_EQ(1, NetBufferGetUsedCount(cb));
+
+    NetBufferRelease(cb, high_new);
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferTimestamp, ReclaimReleasesChains)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 16, NETBUF_F_TIMESTAMP);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto head = NetBufferRequest(cb);
+    const std::vector<uint8_t> payload(40, 0x5A);
+    ASSERT_EQ(40, NetBufferWriteChain(cb, head, payload.data(), payload.size()));
+    EXPECT_EQ(3, NetBufferGetUsedCount(cb));
+    age(head, 1000);
+
+    /* the head takes the chain with it, the chained buffers are fresh anyway */
+    EXPECT_EQ(1, NetBufferReclaimOlderThan(cb, 500, nullptr, nullptr));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferTimestamp, ReclaimSkipsShared)
+{
+    net_buffer_cb_t cb[1];
+    const auto cfg = pool_cfg(4, 16, NETBUF_F_TIMESTAMP | NETBUF_F_REFCOUNT);
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto buffer = NetBufferRequest(cb);
+    ASSERT_EQ(0, NetBufferRetain(cb, buffer));
+    age(buffer, 1000);
+
+    /* someone else still holds it */
+    EXPECT_EQ(0, NetBufferReclaimOlderThan(cb, 500, nullptr, nullptr));
+    EXPECT_EQ(1, NetBufferGetUsedCount(cb));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(1, NetBufferReclaimOlderThan(cb, 500, nullptr, nullptr));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    NetBufferDeinit(cb);
+}
+
+} // namespace
@@ -0,0 +1,275 @@
+#include <gmock/gmock.h>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+
+namespace {
+
+#if NETBUF_TRACE
+
+std::string trace_path()
+{
+    return TempDir() + "netbuf_trace.bin";
+}
+
+/* events of pool `cb` in the dump, in file order */
+std::vector<net_buffer_trace_entry_t> dump(const net_buffer_cb_t* cb, int* total = nullptr)
+{
+    const auto path = trace_path();
+    const int written = NetBufferTraceDump(path.c_str());
+    EXPECT_LE(0, written);
+    if (total) {
+        *total = written;
+    }
+
+    std::vector<net_buffer_trace_entry_t> events;
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        ADD_FAILURE() << "no trace at " << path;
+        return events;
+    }
+
+    net_buffer_trace_header_t header;
+    EXPECT_EQ(1u, fread(&header, sizeof(header), 1, f));
+    EXPECT_EQ(NETBUF_TRACE_MAGIC, header.magic);
+    EXPECT_EQ((uint32_t)NETBUF_TRACE_VERSION, header.version);
+    EXPECT_EQ(sizeof(net_buffer_trace_entry_t), header.entry_size);
+    EXPECT_EQ((uint32_t)written, header.count);
+
+    net_buffer_trace_entry_t e;
+    while (fread(&e, sizeof(e), 1, f) == 1) {
+        if (e.pool == (uint64_t)(uintptr_t)cb) {
+            events.push_back(e);
+        }
+    }
+    fclose(f);
+    remove(path.c_str());
+    return events;
+}
+
+std::vector<uint32_t> kinds(const std::vector<net_buffer_trace_entry_t>& events)
+{
+    std::vector<uint32_t> out;
+    for (const auto& e : events) {
+        out.push_back(e.event);
+    }
+    return out;
+}
+
+__attribute__((noinline)) net_buffer_t* request_here(net_buffer_cb_t* cb)
+{
+    return NetBufferRequest(cb);
+}
+
+TEST(NetBufferTrace, Events)
+{
+    NetBufferTraceReset();
+
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 1, 16));
+
+    auto buffer = NetBufferRequest(cb);
+    EXPECT_EQ(nullptr, NetBufferRequest(cb));
+    EXPECT_EQ(5, NetBufferWriteChecked(cb, buffer, "hello", 5));
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(-1, NetBufferRelease(cb, buffer));
+
+    const auto events = dump(cb);
+    EXPECT_THAT(kinds(events),
+        ElementsAre(NETBUF_TRACE_REQUEST, NETBUF_TRACE_FAIL, NETBUF_TRACE_WRITE, NETBUF_TRACE_RELEASE));
+    ASSERT_EQ(4u, events.size());
+
+    EXPECT_EQ(0u, events[0].index);
+    EXPECT_EQ(NETBUF_NO_INDEX, events[1].index);
+    EXPECT_EQ(5u, events[2].len);
+    EXPECT_EQ(0u, events[3].index);
+    for (size_t i = 1; i < events.size(); ++i) {
+        EXPECT_LE(events[i - 1].timestamp, events[i].timestamp);
+        EXPECT_EQ(events[0].tid, events[i].tid);
+    }
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferTrace, Caller)
+{
+    NetBufferTraceReset();
+
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 2, 16));
+
+    auto buffer = request_here(cb);
+    ASSERT_NE(nullptr, buffer);
+
+    const auto events = dump(cb);
+    ASSERT_EQ(1u, events.size());
+    const auto fn = (uint64_t)(uintptr_t)&request_here;
+    EXPECT_LT(fn, events[0].caller);
+    EXPECT_GT(fn + 4096, events[0].caller);
+
+    NetBufferRelease(cb, buffer);
+    NetBufferDeinit(cb);
+}
+
+class NetBufferTraceModes : public TestWithParam<uint32_t> { };
+
+/* every buffer is logged once, whichever path serves it */
+TEST_P(NetBufferTraceModes, BulkLoggedOnce)
+{
+    NetBufferTraceReset();
+
+    net_buffer_cb_t cb[1];
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 4;
+    cfg.buffer_size = 16;
+    cfg.flags = GetParam();
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    net_buffer_t* bufs[5];
+    ASSERT_EQ(4, NetBufferRequestBulk(cb, bufs, 5));
+    EXPECT_EQ(4, NetBufferReleaseBulk(cb, bufs, 4));
+
+    const auto events = dump(cb);
+    EXPECT_THAT(kinds(events),
+        ElementsAre(NETBUF_TRACE_REQUEST, NETBUF_TRACE_REQUEST, NETBUF_TRACE_REQUEST, NETBUF_TRACE_REQUEST,
+            NETBUF_TRACE_FAIL, NETBUF_TRACE_RELEASE, NETBUF_TRACE_RELEASE, NETBUF_TRACE_RELEASE,
+            NETBUF_TRACE_RELEASE));
+
+    std::multiset<uint32_t> requested, released;
+    for (const auto& e : events) {
+        if (e.event == NETBUF_TRACE_REQUEST) {
+            requested.insert(e.index);
+        } else if (e.event == NETBUF_TRACE_RELEASE) {
+            released.insert(e.index);
+        }
+    }
+    EXPECT_THAT(requested, ElementsAre(0, 1, 2, 3));
+    EXPECT_EQ(requested, released);
+
+    NetBufferDeinit(cb);
+}
+
+INSTANTIATE_TEST_SUITE_P(Pools, NetBufferTraceModes,
+    Values(0u, NETBUF_F_LINKED_USED_LIST, NETBUF_F_CONCURRENT, NETBUF_F_REFCOUNT));
+
+TEST(NetBufferTrace, ChainLoggedThroughHead)
+{
+    NetBufferTraceReset();
+
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 4, 16));
+
+    auto head = NetBufferRequest(cb);
+    const std::vector<uint8_t> payload(40, 0x5A);
+    ASSERT_EQ(40, NetBufferWriteChain(cb, head, payload.data(), payload.size()));
+    EXPECT_EQ(0, NetBufferRelease(cb, head));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    /* the chained buffers are requested by the chain code, and go back with
+     * the head */
+    const auto events = dump(cb);
+    EXPECT_THAT(kinds(events),
+        ElementsAre(NETBUF_TRACE_REQUEST, NETBUF_TRACE_REQUEST, NETBUF_TRACE_REQUEST, NETBUF_TRACE_RELEASE));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferTrace, RingPerThread)
+{
+    NetBufferTraceReset();
+
+    net_buffer_cb_t cb[1];
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 16;
+    cfg.buffer_size = 8;
+    cfg.flags = NETBUF_F_CONCURRENT;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    const size_t num_threads = 4;
+    const size_t num_iterations = 100;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&] {
+            for (size_t i = 0; i < num_iterations; ++i) {
+                NetBufferRelease(cb, NetBufferRequest(cb));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    /* the rings of the threads outlive them */
+    const auto events = dump(cb);
+    EXPECT_EQ(2 * num_threads * num_iterations, events.size());
+
+    std::set<uint32_t> tids;
+    for (const auto& e : events) {
+        tids.insert(e.tid);
+    }
+    EXPECT_EQ(num_threads, tids.size());
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferTrace, RingWraps)
+{
+    NetBufferTraceReset();
+
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 1, 8));
+
+    auto buffer = NetBufferRequest(cb);
+    for (size_t i = 0; i < NETBUF_TRACE_ENTRIES + 10; ++i) {
+        NetBufferWriteChecked(cb, buffer, &i, sizeof(uint8_t));
+    }
+
+    /* only the newest events are kept, oldest first */
+    const auto events = dump(cb);
+    ASSERT_EQ((size_t)NETBUF_TRACE_ENTRIES, events.size());
+    EXPECT_EQ((uint32_t)NETBUF_TRACE_WRITE, events.front().event);
+    EXPECT_EQ((uint32_t)NETBUF_TRACE_WRITE, events.back().event);
+
+    NetBufferRelease(cb, buffer);
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferTrace, Reset)
+{
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInit(cb, 1, 8));
+    NetBufferRelease(cb, NetBufferRequest(cb));
+
+    NetBufferTraceReset();
+    int total = -1;
+    EXPECT_TRUE(dump(cb, &total).empty());
+    EXPECT_EQ(0, total);
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferTrace, InvalidPath)
+{
+    EXPECT_EQ(-1, NetBufferTraceDump(nullptr));
+    EXPECT_EQ(-1, NetBufferTraceDump("/nonexistent/dir/trace.bin"));
+}
+
+#else
+
+TEST(NetBufferTrace, CompiledOut)
+{
+    EXPECT_EQ(-1, NetBufferTraceDump((TempDir() + "netbuf_trace.bin").c_str()));
+    NetBufferTraceReset();
+}
+
+#endif
+
+} // namespace
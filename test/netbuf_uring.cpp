@@ -0,0 +1,286 @@
+#include <gmock/gmock.h>
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+#include "netbuf_test.h"
+
+namespace {
+
+class NetBufferUring : public Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_DGRAM, 0, fds));
+    }
+
+    void TearDown() override
+    {
+        close(fds[0]);
+        close(fds[1]);
+        if (ready) {
+            NetBufferUringDeinit(ur);
+        }
+        EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+        NetBufferDeinit(cb);
+    }
+
+    /* io_uring may be disabled (seccomp, sysctl), there's nothing to test then */
+    bool start(unsigned entries)
+    {
+        ready = NetBufferUringInit(ur, cb, entries) == 0;
+        return ready;
+    }
+
+    /* submits and collects completions until `n` were reaped */
+    std::vector<net_buffer_uring_event_t> reap(size_t n)
+    {
+        std::vector<net_buffer_uring_event_t> events;
+        net_buffer_uring_event_t ev[8];
+
+        while (events.size() < n) {
+            EXPECT_LE(0, NetBufferUringSubmit(ur, 1));
+            const int count = NetBufferUringReap(ur, ev, 8);
+            events.insert(events.end(), ev, ev + count);
+        }
+        return events;
+    }
+
+    int fds[2];
+    net_buffer_cb_t cb[1];
+    net_buffer_uring_t ur[1];
+    bool ready = false;
+};
+
+std::string data_of(net_buffer_cb_t* cb, net_buffer_t* buffer)
+{
+    return std::string((char*)NetBufferData(cb, buffer), buffer->user_data_length);
+}
+
+TEST_F(NetBufferUring, ReadPicksPoolBuffer)
+{
+    ASSERT_EQ(0, NetBufferInit(cb, 8, 64));
+    if (!start(4)) {
+        GTEST_SKIP() << "io_uring not available";
+    }
+
+    /* the ring holds 4 buffers lent to the kernel */
+    EXPECT_EQ(4, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(nullptr, NetBufferGetLRU(cb));
+
+    for (std::string msg : { "one", "two!" }) {
+        ASSERT_EQ((ssize_t)msg.size(), send(fds[0], msg.data(), msg.size(), 0));
+    }
+    ASSERT_EQ(0, NetBufferUringRead(ur, fds[1]));
+    ASSERT_EQ(0, NetBufferUringRead(ur, fds[1]));
+
+    const auto events = reap(2);
+    ASSERT_EQ(2u, events.size());
+    for (const auto& ev : events) {
+        EXPECT_EQ(NETBUF_URING_READ, ev.op);
+        ASSERT_NE(nullptr, ev.buffer);
+        EXPECT_EQ(NETBUF_STATE_USED, ev.buffer->state);
+        EXPECT_EQ((size_t)ev.res, ev.buffer->user_data_length);
+    }
+    EXPECT_EQ("one", data_of(cb, events[0].buffer));
+    EXPECT_EQ("two!", data_of(cb, events[1].buffer));
+    EXPECT_EQ(2u, ur->stats.reads);
+
+    /* completed reads are in the used list, in completion order */
+    EXPECT_EQ(events[0].buffer, NetBufferGetLRU(cb));
+
+    EXPECT_EQ(4, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(0, NetBufferRelease(cb, events[0].buffer));
+    EXPECT_EQ(0, NetBufferRelease(cb, events[1].buffer));
+    EXPECT_EQ(2, NetBufferGetUsedCount(cb));
+
+    /* the next submit tops the ring up again */
+    EXPECT_EQ(0, NetBufferUringSubmit(ur, 0));
+    EXPECT_EQ(4, NetBufferGetUsedCount(cb));
+}
+
+TEST_F(NetBufferUring, WriteThenReadPipe)
+{
+    ASSERT_EQ(0, NetBufferInit(cb, 8, 64));
+    if (!start(4)) {
+        GTEST_SKIP() << "io_uring not available";
+    }
+
+    int pipefd[2];
+    ASSERT_EQ(0, pipe(pipefd));
+
+    auto out = NetBufferRequest(cb);
+    ASSERT_NE(nullptr, out);
+    ASSERT_EQ(5, NetBufferWriteChecked(cb, out, "hello", 5));
+
+    ASSERT_EQ(0, NetBufferUringWrite(ur, pipefd[1], out));
+    ASSERT_EQ(0, NetBufferUringRead(ur, pipefd[0]));
+
+    net_buffer_t* in = nullptr;
+    for (const auto& ev : reap(2)) {
+        if (ev.op == NETBUF_URING_WRITE) {
+            EXPECT_EQ(out, ev.buffer);
+            EXPECT_EQ(5, ev.res);
+        } else {
+            in = ev.buffer;
+            EXPECT_EQ(5, ev.res);
+        }
+    }
+
+    ASSERT_NE(nullptr, in);
+    EXPECT_NE(out, in);
+    EXPECT_EQ("hello", data_of(cb, in));
+    EXPECT_EQ(1u, ur->stats.writes);
+
+    EXPECT_EQ(0, NetBufferRelease(cb, out));
+    EXPECT_EQ(0, NetBufferRelease(cb, in));
+    close(pipefd[0]);
+    close(pipefd[1]);
+}
+
+TEST_F(NetBufferUring, ReadFile)
+{
+    ASSERT_EQ(0, NetBufferInit(cb, 4, 16));
+    if (!start(2)) {
+        GTEST_SKIP() << "io_uring not available";
+    }
+
+    FILE* f = tmpfile();
+    ASSERT_NE(nullptr, f);
+    const std::string content = "0123456789abcdefXYZ";
+    ASSERT_EQ(content.size(), fwrite(content.data(), 1, content.size(), f));
+    fflush(f);
+    rewind(f);
+
+    /* reads advance the file position, and stop at the buffer capacity */
+    ASSERT_EQ(0, NetBufferUringRead(ur, fileno(f)));
+    auto first = reap(1);
+    ASSERT_NE(nullptr, first[0].buffer);
+    EXPECT_EQ("0123456789abcdef", data_of(cb, first[0].buffer));
+
+    ASSERT_EQ(0, NetBufferUringRead(ur, fileno(f)));
+    auto second = reap(1);
+    ASSERT_NE(nullptr, second[0].buffer);
+    EXPECT_EQ("XYZ", data_of(cb, second[0].buffer));
+
+    /* end of file: the buffer stays in the ring */
+    ASSERT_EQ(0, NetBufferUringRead(ur, fileno(f)));
+    auto eof = reap(1);
+    EXPECT_EQ(nullptr, eof[0].buffer);
+    EXPECT_EQ(0, eof[0].res);
+
+    EXPECT_EQ(0, NetBufferRelease(cb, first[0].buffer));
+    EXPECT_EQ(0, NetBufferRelease(cb, second[0].buffer));
+    fclose(f);
+}
+
+TEST_F(NetBufferUring, RingEmpty)
+{
+    ASSERT_EQ(0, NetBufferInit(cb, 2, 16));
+    if (!start(4)) {
+        GTEST_SKIP() << "io_uring not available";
+    }
+
+    for (std::string msg : { "a", "b", "c" }) {
+        ASSERT_EQ((ssize_t)msg.size(), send(fds[0], msg.data(), msg.size(), 0));
+    }
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(0, NetBufferUringRead(ur, fds[1]));
+    }
+
+    std::vector<net_buffer_t*> got;
+    for (const auto& ev : reap(3)) {
+        if (ev.buffer) {
+            got.push_back(ev.buffer);
+        } else {
+            EXPECT_EQ(-ENOBUFS, ev.res);
+        }
+    }
+
+    /* the pool only had two buffers to give */
+    ASSERT_EQ(2u, got.size());
+    EXPECT_EQ(1u, ur->stats.nobufs);
+    EXPECT_EQ(2, NetBufferGetUsedCount(cb));
+
+    for (auto buffer : got) {
+        EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    }
+}
+
+TEST_F(NetBufferUring, HeadroomKept)
+{
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 4;
+    cfg.buffer_size = 32;
+    cfg.headroom = 8;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+    if (!start(2)) {
+        GTEST_SKIP() << "io_uring not available";
+    }
+
+    ASSERT_EQ(3, send(fds[0], "abc", 3, 0));
+    ASSERT_EQ(0, NetBufferUringRead(ur, fds[1]));
+
+    auto events = reap(1);
+    ASSERT_NE(nullptr, events[0].buffer);
+    EXPECT_EQ(8u, NetBufferHeadroom(events[0].buffer));
+    EXPECT_EQ("abc", data_of(cb, events[0].buffer));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, events[0].buffer));
+}
+
+TEST_F(NetBufferUring, ConcurrentPool)
+{
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 8;
+    cfg.buffer_size = 32;
+    cfg.flags = NETBUF_F_CONCURRENT;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+    if (!start(4)) {
+        GTEST_SKIP() << "io_uring not available";
+    }
+
+    EXPECT_EQ(4, NetBufferGetUsedCount(cb));
+
+    ASSERT_EQ(4, send(fds[0], "ping", 4, 0));
+    ASSERT_EQ(0, NetBufferUringRead(ur, fds[1]));
+
+    auto events = reap(1);
+    ASSERT_NE(nullptr, events[0].buffer);
+    EXPECT_EQ("ping", data_of(cb, events[0].buffer));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, events[0].buffer));
+}
+
+TEST_F(NetBufferUring, RejectsClasses)
+{
+    const net_buffer_class_config_t classes[] = { { 16, 2 }, { 64, 2 } };
+    net_buffer_config_t cfg = {};
+    cfg.classes = classes;
+    cfg.num_classes = 2;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    EXPECT_EQ(-1, NetBufferUringInit(ur, cb, 4));
+}
+
+TEST_F(NetBufferUring, RejectsPartitioned)
+{
+    /* every buffer reserved for one interface */
+    const net_buffer_iface_config_t ifaces[] = { { 1, 0, 4, 0 } };
+    auto cfg = pool_cfg(4, 16);
+    cfg.ifaces = ifaces;
+    cfg.num_ifaces = 1;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    EXPECT_EQ(-1, NetBufferUringInit(ur, cb, 4));
+}
+
+} // namespace
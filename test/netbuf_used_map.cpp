@@ -0,0 +1,228 @@
+#include <gmock/gmock.h>
+#include <algorithm>
+#include <vector>
+
+using namespace ::testing;
+
+#define NETBUF_ASSERT(x) EXPECT_TRUE(x)
+
+#include "netbuf.h"
+
+namespace {
+
+int collect(net_buffer_cb_t*, net_buffer_t* buffer, void* ctx)
+{
+    static_cast<std::vector<net_buffer_t*>*>(ctx)->push_back(buffer);
+    return 0;
+}
+
+std::vector<net_buffer_t*> used(net_buffer_cb_t* cb)
+{
+    std::vector<net_buffer_t*> out;
+    EXPECT_LE(0, NetBufferForEachUsed(cb, collect, &out));
+    return out;
+}
+
+class NetBufferUsedMap : public TestWithParam<uint32_t> {
+protected:
+    void SetUp() override
+    {
+        net_buffer_config_t cfg = {};
+        cfg.num_buffers = 130;
+        cfg.buffer_size = 16;
+        cfg.flags = GetParam();
+        ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+    }
+
+    void TearDown() override { NetBufferDeinit(cb); }
+
+    net_buffer_cb_t cb[1];
+};
+
+TEST_P(NetBufferUsedMap, DoubleRelease)
+{
+    auto a = NetBufferRequest(cb);
+    auto b = NetBufferRequest(cb);
+    auto c = NetBufferRequest(cb);
+
+    /* out of order, off the front of the used list */
+    EXPECT_EQ(0, NetBufferRelease(cb, b));
+    EXPECT_EQ(-1, NetBufferRelease(cb, b));
+    EXPECT_EQ(2, NetBufferGetUsedCount(cb));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, a));
+    EXPECT_EQ(-1, NetBufferRelease(cb, a));
+    EXPECT_EQ(0, NetBufferRelease(cb, c));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+
+    /* never requested */
+    auto d = NetBufferRequest(cb);
+    EXPECT_EQ(0, NetBufferRelease(cb, d));
+    EXPECT_EQ(-1, NetBufferRelease(cb, d));
+}
+
+TEST_P(NetBufferUsedMap, ForeignPointer)
+{
+    auto buffer = NetBufferRequest(cb);
+
+    net_buffer_t outside = *buffer;
+    EXPECT_EQ(-1, NetBufferRelease(cb, &outside));
+    EXPECT_EQ(-1, NetBufferRelease(cb, (net_buffer_t*)((uint8_t*)buffer + 8)));
+
+    /* never read, ASan would catch it */
+    net_buffer_t* volatile stale = (net_buffer_t*)malloc(sizeof(net_buffer_t));
+    free(stale);
+    EXPECT_EQ(-1, NetBufferRelease(cb, stale));
+
+    net_buffer_cb_t other[1];
+    ASSERT_EQ(0, NetBufferInit(other, 2, 16));
+    auto theirs = NetBufferRequest(other);
+    EXPECT_EQ(-1, NetBufferRelease(cb, theirs));
+    EXPECT_FALSE(NetBufferIsUsed(cb, theirs));
+    EXPECT_EQ(0, NetBufferRelease(other, theirs));
+    NetBufferDeinit(other);
+
+    EXPECT_EQ(1, NetBufferGetUsedCount(cb));
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+}
+
+TEST_P(NetBufferUsedMap, IsUsed)
+{
+    EXPECT_FALSE(NetBufferIsUsed(cb, nullptr));
+    EXPECT_FALSE(NetBufferIsUsed(nullptr, nullptr));
+
+    auto buffer = NetBufferRequest(cb);
+    EXPECT_TRUE(NetBufferIsUsed(cb, buffer));
+    EXPECT_FALSE(NetBufferIsUsed(cb, (net_buffer_t*)((uint8_t*)buffer + 1)));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_FALSE(NetBufferIsUsed(cb, buffer));
+}
+
+TEST_P(NetBufferUsedMap, ForEachInIndexOrder)
+{
+    /* across the word boundaries of the bitmap */
+    std::vector<net_buffer_t*> all(130);
+    ASSERT_EQ(130, NetBufferRequestBulk(cb, all.data(), all.size()));
+    EXPECT_EQ(all.size(), used(cb).size());
+
+    std::vector<net_buffer_t*> kept;
+    for (size_t i = 0; i < all.size(); ++i) {
+        if (i == 0 || i == 63 || i == 64 || i == 129) {
+            kept.push_back(all[i]);
+        } else {
+            EXPECT_EQ(0, NetBufferRelease(cb, all[i]));
+        }
+    }
+
+    /* index order is address order in a single slab */
+    std::sort(kept.begin(), kept.end());
+    EXPECT_EQ(kept, used(cb));
+
+    EXPECT_EQ((int)kept.size(), NetBufferReleaseBulk(cb, kept.data(), kept.size()));
+    EXPECT_TRUE(used(cb).empty());
+}
+
+TEST_P(NetBufferUsedMap, ForEachStops)
+{
+    net_buffer_t* bufs[5];
+    ASSERT_EQ(5, NetBufferRequestBulk(cb, bufs, 5));
+
+    int seen = 0;
+    auto third = [](net_buffer_cb_t*, net_buffer_t*, void* ctx) { return ++*static_cast<int*>(ctx) == 3 ? 1 : 0; };
+    EXPECT_EQ(3, NetBufferForEachUsed(cb, third, &seen));
+    EXPECT_EQ(-1, NetBufferForEachUsed(cb, nullptr, nullptr));
+    EXPECT_EQ(-1, NetBufferForEachUsed(nullptr, collect, nullptr));
+
+    /* releasing the visited buffer is fine */
+    auto release = [](net_buffer_cb_t* pool, net_buffer_t* buffer, void*) { return NetBufferRelease(pool, buffer); };
+    EXPECT_EQ(5, NetBufferForEachUsed(cb, release, nullptr));
+    EXPECT_EQ(0, NetBufferGetUsedCount(cb));
+}
+
+INSTANTIATE_TEST_SUITE_P(Pools, NetBufferUsedMap,
+    Values(0u, NETBUF_F_LINKED_USED_LIST, NETBUF_F_PRIORITY, NETBUF_F_REFCOUNT, NETBUF_F_LAZY_INIT, NETBUF_F_SPLIT_META));
+
+TEST(NetBufferUsedMapClasses, GlobalIndex)
+{
+    net_buffer_cb_t cb[1];
+    const net_buffer_class_config_t classes[] = { { 16, 70 }, { 64, 70 } };
+    net_buffer_config_t cfg = {};
+    cfg.classes = classes;
+    cfg.num_classes = 2;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto small = NetBufferRequestSized(cb, 8);
+    auto large = NetBufferRequestSized(cb, 40);
+    EXPECT_TRUE(NetBufferIsUsed(cb, small));
+    EXPECT_TRUE(NetBufferIsUsed(cb, large));
+    EXPECT_THAT(used(cb), ElementsAre(small, large));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, small));
+    EXPECT_EQ(-1, NetBufferRelease(cb, small));
+    EXPECT_THAT(used(cb), ElementsAre(large));
+
+    NetBufferRelease(cb, large);
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferUsedMapStatic, Works)
+{
+    std::vector<uint8_t> mem(NETBUF_POOL_STORAGE_SIZE(70, 16));
+    net_buffer_cb_t cb[1];
+    ASSERT_EQ(0, NetBufferInitStatic(cb, mem.data(), mem.size(), 70, 16));
+
+    /* the bitmap is cleared even if the storage wasn't */
+    NetBufferDeinit(cb);
+    std::fill(mem.begin(), mem.end(), 0xFF);
+    ASSERT_EQ(0, NetBufferInitStatic(cb, mem.data(), mem.size(), 70, 16));
+    EXPECT_TRUE(used(cb).empty());
+
+    auto buffer = NetBufferRequest(cb);
+    EXPECT_THAT(used(cb), ElementsAre(buffer));
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(-1, NetBufferRelease(cb, buffer));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferUsedMapConcurrent, StateInstead)
+{
+    net_buffer_cb_t cb[1];
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 4;
+    cfg.buffer_size = 16;
+    cfg.flags = NETBUF_F_CONCURRENT | NETBUF_F_LAZY_INIT;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+    EXPECT_EQ(nullptr, cb->used_map);
+
+    auto buffer = NetBufferRequest(cb);
+    EXPECT_TRUE(NetBufferIsUsed(cb, buffer));
+    /* never handed out, the header isn't even written */
+    EXPECT_FALSE(NetBufferIsUsed(cb, (net_buffer_t*)((uint8_t*)buffer + cb->elem_size)));
+    EXPECT_EQ(-1, NetBufferForEachUsed(cb, collect, nullptr));
+
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_FALSE(NetBufferIsUsed(cb, buffer));
+
+    NetBufferDeinit(cb);
+}
+
+TEST(NetBufferUsedMapPriority, SetPriorityOfFreeBuffer)
+{
+    net_buffer_cb_t cb[1];
+    net_buffer_config_t cfg = {};
+    cfg.num_buffers = 4;
+    cfg.buffer_size = 16;
+    cfg.flags = NETBUF_F_PRIORITY;
+    ASSERT_EQ(0, NetBufferInitEx(cb, &cfg));
+
+    auto buffer = NetBufferRequest(cb);
+    EXPECT_EQ(0, NetBufferSetPriority(cb, buffer, 0));
+    EXPECT_EQ(0, NetBufferRelease(cb, buffer));
+    EXPECT_EQ(-1, NetBufferSetPriority(cb, buffer, 1));
+
+    NetBufferDeinit(cb);
+}
+
+} // namespace
@@ -116,4 +116,32 @@ TEST(SimpleStack, StableSort)
     stack_free(q);
 }
 
+TEST(SimpleStack, Bulk)
+{
+    struct simple_stack* q = stack_alloc(16);
+
+    void* input[] = {
+        (void*)1, (void*)2, (void*)3, (void*)4, (void*)5
+    };
+    const size_t n = sizeof(input) / sizeof(input[0]);
+
+    stack_push(q, (void*)0x10);
+    stack_push_bulk(q, input, n);
+    EXPECT_EQ(stack_count(q), n + 1);
+    EXPECT_EQ(stack_pop(q), (void*)5);
+
+    void* output[4] = {};
+    stack_pop_bulk(q, output, 4);
+    EXPECT_EQ(stack_count(q), 1);
+    for (size_t i = 0; i < 4; ++i) {
+        EXPECT_EQ(output[i], input[i]);
+    }
+
+    /* popped entries are cleared like stack_pop does */
+    EXPECT_EQ(q->entry[1], nullptr);
+    EXPECT_EQ(q->entry[4], nullptr);
+
+    stack_free(q);
+}
+
 } // namespace
@@ -0,0 +1,143 @@
+/* decodes a trace written by NetBufferTraceDump:
+ *
+ *     netbuf_trace trace.bin
+ *
+ * prints every event in timestamp order, then the buffers that were still
+ * requested at the end of the trace with the caller that requested them.
+ * resolve the caller addresses with addr2line -e <binary> */
+
+#include "netbuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* an event and its position in the file, which keeps each thread's events in
+ * order when timestamps tie */
+struct event {
+    net_buffer_trace_entry_t e;
+    size_t pos;
+};
+
+static int by_time(const void* a, const void* b)
+{
+    const struct event* x = a;
+    const struct event* y = b;
+    if (x->e.timestamp != y->e.timestamp) {
+        return x->e.timestamp < y->e.timestamp ? -1 : 1;
+    }
+    return x->pos < y->pos ? -1 : x->pos > y->pos;
+}
+
+/* by buffer, then by time */
+static int by_buffer(const void* a, const void* b)
+{
+    const struct event* x = a;
+    const struct event* y = b;
+    if (x->e.pool != y->e.pool) {
+        return x->e.pool < y->e.pool ? -1 : 1;
+    }
+    if (x->e.index != y->e.index) {
+        return x->e.index < y->e.index ? -1 : 1;
+    }
+    return by_time(a, b);
+}
+
+static const char* event_name(uint32_t event)
+{
+    switch (event) {
+    case NETBUF_TRACE_REQUEST:
+        return "request";
+    case NETBUF_TRACE_RELEASE:
+        return "release";
+    case NETBUF_TRACE_WRITE:
+        return "write";
+    case NETBUF_TRACE_FAIL:
+        return "fail";
+    default:
+        return "?";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <trace>\n", argv[0]);
+        return 2;
+    }
+
+    FILE* f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    net_buffer_trace_header_t header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != NETBUF_TRACE_MAGIC
+        || header.version != NETBUF_TRACE_VERSION || header.entry_size != sizeof(net_buffer_trace_entry_t)) {
+        fprintf(stderr, "%s: not a netbuf trace, or a different version\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+
+    struct event* events = calloc(header.count ? header.count : 1, sizeof(*events));
+    if (!events) {
+        fclose(f);
+        return 1;
+    }
+
+    size_t n = 0;
+    while (n < header.count && fread(&events[n].e, sizeof(events[n].e), 1, f) == 1) {
+        events[n].pos = n;
+        n++;
+    }
+    fclose(f);
+    if (n < header.count) {
+        fprintf(stderr, "%s: truncated, %zu of %u events\n", argv[1], n, header.count);
+    }
+
+    qsort(events, n, sizeof(*events), by_time);
+    const uint64_t start = n ? events[0].e.timestamp : 0;
+
+    printf("%14s %8s %-8s %18s %10s %18s %s\n", "time", "tid", "event", "pool", "index", "caller", "len");
+    for (size_t i = 0; i < n; ++i) {
+        const net_buffer_trace_entry_t* e = &events[i].e;
+        printf("%14llu %8u %-8s %#18llx ", (unsigned long long)(e->timestamp - start), e->tid, event_name(e->event),
+            (unsigned long long)e->pool);
+        if (e->index == NETBUF_NO_INDEX) {
+            printf("%10s", "-");
+        } else {
+            printf("%10u", e->index);
+        }
+        printf(" %#18llx", (unsigned long long)e->caller);
+        if (e->event == NETBUF_TRACE_WRITE) {
+            printf(" %u", e->len);
+        }
+        printf("\n");
+    }
+
+    /* a buffer is held if its last request or release in the trace is a
+     * request. a ring that wrapped may have lost the release of an older
+     * request, never the other way around */
+    qsort(events, n, sizeof(*events), by_buffer);
+    size_t held = 0;
+    const net_buffer_trace_entry_t* last = NULL;
+    for (size_t i = 0; i <= n; ++i) {
+        const net_buffer_trace_entry_t* e = i < n ? &events[i].e : NULL;
+        if (last && (!e || e->pool != last->pool || e->index != last->index)) {
+            if (last->event == NETBUF_TRACE_REQUEST) {
+                if (!held++) {
+                    printf("\nheld at the end of the trace:\n");
+                }
+                printf("%#18llx %10u requested by %#llx on tid %u\n", (unsigned long long)last->pool, last->index,
+                    (unsigned long long)last->caller, last->tid);
+            }
+            last = NULL;
+        }
+        if (e && (e->event == NETBUF_TRACE_REQUEST || e->event == NETBUF_TRACE_RELEASE)) {
+            last = e;
+        }
+    }
+
+    free(events);
+    return 0;
+}